@@ -1,47 +1,46 @@
+#include <algorithm>
+#include <chrono>
 #include <cstdlib>
+#include <ctime>
 #include <iostream>
+#include <sstream>
+#include <stdexcept>
 
+#include "mygl/dynamicresolution.h"
+#include "mygl/framebuffer.h"
 #include "mygl/shader.h"
+#include "mygl/shadercache.h"
+#include "mygl/shadervariants.h"
 #include "mygl/mesh.h"
 #include "mygl/geometry.h"
 #include "mygl/camera.h"
+#include "mygl/glstate.h"
+#include "mygl/pacing.h"
+#include "mygl/profiler.h"
+#include "mygl/recorder.h"
+#include "mygl/screenshot.h"
+#include "mygl/renderqueue.h"
+#include "mygl/texturestream.h"
+#include "mygl/uniformbuffer.h"
+#include "core/bvh.h"
+#include "core/entities.h"
+#include "core/picking.h"
+#include "core/jobs.h"
+#include "core/transform.h"
+#include "benchmark.h"
+#include "fleet.h"
+#include "options.h"
+#include "pipeline.h"
+#include "scenefile.h"
 #include "water.h"
 
 /* translation and color for the water plane */
 namespace waterPlane
-{const Vector4D color = {0.0f, 0.0f, 0.35f, 1.0f};
+{
 const Matrix4D scale = Matrix4D::scale(50.0f, 0.0f, 50.0f);
 const Matrix4D trans = Matrix4D::identity();
 }
 
-/* translation and scale for the scaled cube */
-namespace boat {
-
-    //scaling and transformation to get one boat
-    const Matrix4D bodyScale = Matrix4D::scale(3.5f, 0.9f, 1.25f);
-    const Matrix4D bodyTrans = Matrix4D::translation({0.0f, 0.0f, 0.0f});
-
-    const Matrix4D mastScale = Matrix4D::scale(0.15f, 1.5f, 0.15f);
-    const Matrix4D mastTrans = Matrix4D::translation({-1.0f, 2.4f, 0.0f});
-
-    const Matrix4D bridgeScale = Matrix4D::scale(0.65f, 0.75f, 0.75f);
-    const Matrix4D bridgeTrans = Matrix4D::translation({1.5f, 1.65f, 0});
-
-    const Matrix4D bulwarkLeftScale = Matrix4D::scale(3.2f, 0.3f, 0.15f);
-    const Matrix4D bulwarkLeftTrans = Matrix4D::translation({0, 1.2f, -1.1f});
-
-    const Matrix4D bulwarkRightScale = Matrix4D::scale(3.2f, 0.3f, 0.15f);
-    const Matrix4D bulwarkRightTrans = Matrix4D::translation({0, 1.2f, 1.1f});
-
-    const Matrix4D bulwarkFrontScale = Matrix4D::scale(0.15f, 0.3f, 1.25f);
-    const Matrix4D bulwarkFrontTrans = Matrix4D::translation({3.35f, 1.2f, 0});
-
-    const Matrix4D bulwarkBackScale = Matrix4D::scale(0.15f, 0.3f, 1.25f);
-    const Matrix4D bulwarkBackTrans = Matrix4D::translation({-3.35f, 1.2f, 0});
-}
-
-
-
 // Position of the central point of each cube before any transformation (with homogenuous
     // coordinates):
     const Vector4D centralPointBeforeTransformation = { 0.0, 0.0, 0.0, 1.0 };
@@ -62,59 +61,74 @@ struct
     short currentCamera;
     float zoomSpeedMultiplier;
 
+    /* per-frame constants shared by all shader programs */
+    UniformBuffer frameUniformBuffer;
+    float elapsedTime;
+    float frameDelta;
+
     /* water */
     WaterSim waterSim;
     Water water;
     Matrix4D waterModelMatrix;
 
-    /* cube meshes and transformations */
-    Mesh cubeMesh;
-    Matrix4D cubeScalingMatrix;
-    Matrix4D cubeTranslationMatrix;
-    Matrix4D cubeTransformationMatrix;
+    /* mesh table in the order of the scene file, entities refer to meshes by index */
+    std::vector<Mesh> meshes;
     float cubeSpinRadPerSecond;
-    /* boat mesh and transformations */
-    Mesh bodyMesh;
-    Mesh mastMesh;
-    Mesh bridgeMesh;
-    Mesh bulwarkLeftMesh;
-    Mesh bulwarkRightMesh;
-    Mesh bulwarkFrontMesh;
-    Mesh bulwarkBackMesh;
-
-    Matrix4D bodyTransformationMatrix;
 
-    Matrix4D bodyScalingMatrix;
-    Matrix4D bodyTranslationMatrix;
+    /* transform hierarchy: one root node per boat, one child node per part */
+    TransformGraph transforms;
+    int boatNode;
 
-    Matrix4D mastScalingMatrix;
-    Matrix4D mastTranslationMatrix;
-    Matrix4D mastTransformationMatrix;
-
-    Matrix4D bridgeScalingMatrix;
-    Matrix4D bridgeTranslationMatrix;
-    Matrix4D bridgeTransformationMatrix;
-
-    Matrix4D bulwarkLeftScalingMatrix;
-    Matrix4D bulwarkLeftTranslationMatrix;
-    Matrix4D bulwarkLeftTransformationMatrix;
-
-    Matrix4D bulwarkRightScalingMatrix;
-    Matrix4D bulwarkRightTranslationMatrix;
-    Matrix4D bulwarkRightTransformationMatrix;
-
-    Matrix4D bulwarkFrontScalingMatrix;
-    Matrix4D bulwarkFrontTranslationMatrix;
-    Matrix4D bulwarkFrontTransformationMatrix;
-
-    Matrix4D bulwarkBackScalingMatrix;
-    Matrix4D bulwarkBackTranslationMatrix;
-    Matrix4D bulwarkBackTransformationMatrix;
+    /* all drawable objects except the water */
+    EntityStore entities;
 
+    /* world space boxes of the entities and the hierarchy over them, refitted for the entities that moved */
+    std::vector<Bounds> entityBounds;
+    Bvh entityBvh;
+    std::vector<uint32_t> nodeEntityStart;      // entities of node n are nodeEntities[start[n]] to [start[n + 1]]
+    std::vector<uint32_t> nodeEntities;
+    std::vector<uint32_t> movedEntities;
+    std::vector<uint32_t> visibleEntities;
 
+    /* CPU copies of the meshes for ray picking, same indices as the mesh table */
+    std::vector<PickMesh> pickMeshes;
+    int selectedNode;           // root node of the boat selected by a click, -1 for none
 
     /* shader */
-    ShaderProgram shaderColor;
+    ShaderCache shaderCache;
+    ShaderLibrary shaders;
+    ShaderProgram* shaderColor;
+    ShaderProgram* shaderInstanced;
+    ShaderProgram* shaderTextured;
+    ShaderProgram* shaderInstancedTextured;
+
+    /* textures of the scene streamed on first use into the layers of one texture array, entities refer to them by
+     * index into textureHandles, boats of the fleet pick one of them as livery */
+    TextureStream textures;
+    std::vector<int> textureHandles;
+
+    /* thousands of instanced boats without entities, empty unless --fleet is given */
+    Fleet fleet;
+    int fleetMeshIdx;
+    std::vector<FleetPart> fleetParts;      // the boat prefab of the scene
+
+    /* snapshots handed from the simulation to the renderer */
+    FramePipeline pipeline;
+    bool waterStill;
+
+    /* screenshots read back and encoded without stalling the frame loop */
+    ScreenshotQueue screenshots;
+
+    /* frame pacing, changed at runtime by the key callback */
+    bool windowed;
+    PresentMode presentMode;
+    FrameLimiter limiter;
+    FramePacing pacing;
+
+    /* on-demand rendering: the loop sleeps until input, an animation or the water timer needs a new frame */
+    bool onDemand;
+    std::chrono::steady_clock::duration waterTick;      // zero if the water is frozen
+    std::chrono::steady_clock::time_point nextWaterTick;
 } sScene;
 
 /* struct holding all state variables for input */
@@ -122,10 +136,37 @@ struct
 {
     bool mouseLeftButtonPressed = false;
     Vector2D mousePressStart;
+    Vector2D clickStart;        // a press and release without dragging in between is a click, which picks a boat
+    bool clickMoved = false;
+
+    /* written by the callbacks on the main thread and consumed by sceneUpdate, which may run on the simulation
+     * thread, so everything below is guarded by the mutex */
+    std::mutex mutex;
     //added two more states for the camera mode switching
     bool buttonPressed[6] = {false, false, false, false, false, false};
+    Vector2D orbitDelta;
+    float zoomDelta = 0.0f;
+    int resizeWidth = 0;
+    int resizeHeight = 0;
+    bool dirty = true;          // an event changed the scene or the window since the last frame
+    bool pickRequested = false;
+    Vector2D pickPosition;      // cursor of the click in [0, 1]^2 of the window, y pointing down
 } sInput;
 
+/* intended frame interval, the limiter or the refresh of the display when waiting for vsync, 0 if unknown */
+double pacingTargetMs()
+{
+    if(sScene.limiter.fps > 0.0)
+        return 1000.0 / sScene.limiter.fps;
+    if(sScene.windowed && sScene.presentMode != PresentMode::Uncapped)
+    {
+        const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+        if(mode && mode->refreshRate > 0)
+            return 1000.0 / mode->refreshRate;
+    }
+    return 0.0;
+}
+
 /* GLFW callback function for keyboard events */
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
@@ -140,10 +181,34 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
     /* make screenshot and save in work directory */
     if(key == GLFW_KEY_P && action == GLFW_PRESS)
     {
-        screenshotToPNG("screenshot.png");
+        screenshotRequest(sScene.screenshots, "screenshot.png");
+    }
+
+    /* frame pacing: cycle present modes and frame limits, print the frame interval histogram */
+    if(key == GLFW_KEY_V && action == GLFW_PRESS)
+    {
+        PresentMode next = PresentMode((int(sScene.presentMode) + 1) % 3);
+        sScene.presentMode = presentModeSet(next);
+        std::cout << "[Pacing] Present mode " << presentModeName(sScene.presentMode) << std::endl;
+    }
+    if(key == GLFW_KEY_F && action == GLFW_PRESS)
+    {
+        double next = 0.0;
+        for(double limit : {30.0, 60.0, 120.0, 144.0})
+        {
+            if(limit > sScene.limiter.fps) { next = limit; break; }
+        }
+        frameLimiterSetFps(sScene.limiter, next);
+        std::cout << "[Pacing] Frame limit " << (next > 0.0 ? std::to_string(int(next)) + " fps" : "off") << std::endl;
+    }
+    if(key == GLFW_KEY_H && action == GLFW_PRESS)
+    {
+        pacingReport(sScene.pacing, pacingTargetMs());
     }
 
     /* input for cube control */
+    std::lock_guard<std::mutex> lock(sInput.mutex);
+    sInput.dirty = true;
     if(key == GLFW_KEY_W)
     {
         sInput.buttonPressed[0] = (action == GLFW_PRESS || action == GLFW_REPEAT);
@@ -175,9 +240,13 @@ void mousePosCallback(GLFWwindow* window, double x, double y)
     /* called on cursor position change */
     if(sInput.mouseLeftButtonPressed)
     {
-        Vector2D diff = sInput.mousePressStart - Vector2D(x, y);
-        cameraUpdateOrbit(sScene.cameras[sScene.currentCamera], diff, 0.0f);
+        std::lock_guard<std::mutex> lock(sInput.mutex);
+        sInput.dirty = true;
+        sInput.orbitDelta += sInput.mousePressStart - Vector2D(x, y);
         sInput.mousePressStart = Vector2D(x, y);
+
+        Vector2D moved = Vector2D(x, y) - sInput.clickStart;
+        sInput.clickMoved |= moved.x * moved.x + moved.y * moved.y > 9.0f;
     }
 }
 
@@ -190,82 +259,255 @@ void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
         double x, y;
         glfwGetCursorPos(window, &x, &y);
         sInput.mousePressStart = Vector2D(x, y);
+
+        if (action == GLFW_PRESS) {
+            sInput.clickStart = Vector2D(x, y);
+            sInput.clickMoved = false;
+        } else if (action == GLFW_RELEASE && !sInput.clickMoved) {
+            int width, height;
+            glfwGetWindowSize(window, &width, &height);
+            std::lock_guard<std::mutex> lock(sInput.mutex);
+            sInput.dirty = true;
+            sInput.pickRequested = true;
+            sInput.pickPosition = Vector2D(x / std::max(width, 1), y / std::max(height, 1));
+        }
     }
 }
 
 /* GLFW callback function for mouse scroll events */
 void mouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset)
 {
-    cameraUpdateOrbit(sScene.cameras[sScene.currentCamera], {0, 0}, sScene.zoomSpeedMultiplier * yoffset);
+    std::lock_guard<std::mutex> lock(sInput.mutex);
+    sInput.dirty = true;
+    sInput.zoomDelta += sScene.zoomSpeedMultiplier * yoffset;
 }
 
 /* GLFW callback function for window resize event */
 void windowResizeCallback(GLFWwindow* window, int width, int height)
 {
-    glViewport(0, 0, width, height);
-    sScene.cameras[sScene.currentCamera].width = width;
-    sScene.cameras[sScene.currentCamera].height = height;
+    glStateViewport(0, 0, width, height);
+
+    std::lock_guard<std::mutex> lock(sInput.mutex);
+    sInput.dirty = true;
+    sInput.resizeWidth = width;
+    sInput.resizeHeight = height;
+}
+
+/* GLFW callback function for window refresh events, the window content was damaged (uncovered, restored) */
+void windowRefreshCallback(GLFWwindow* window)
+{
+    std::lock_guard<std::mutex> lock(sInput.mutex);
+    sInput.dirty = true;
+}
+/* parts of a prefab relative to its root as parts of the fleet, the fleet draws all of them with one mesh */
+std::vector<FleetPart> fleetPartsFromPrefab(const SceneDescription& scene, const ScenePrefab& prefab) {
+    std::vector<FleetPart> parts;
+    for (uint32_t i = prefab.firstPart; i < prefab.firstPart + prefab.partCount; i++) {
+        const ScenePart& part = scene.parts[i];
+        if (part.mesh != scene.parts[prefab.firstPart].mesh) {
+            std::cerr << "[Fleet] Prefab " << prefab.name << " uses more than one mesh, drawn with the first" << std::endl;
+        }
+        parts.push_back({Matrix4D::translation(part.translation) * Matrix4D(part.rotation)
+                             * Matrix4D::scale(part.scale.x, part.scale.y, part.scale.z),
+                         part.color, part.texture >= 0});
+    }
+    return parts;
+}
+
+/* world space boxes of the entities on the nodes recomputed by the last transform update and the hierarchy over them,
+ * everything is rebuilt when entities were added or removed */
+void entitiesUpdateBounds()
+{
+    const EntityStore& entities = sScene.entities;
+    const TransformGraph& transforms = sScene.transforms;
+    uint32_t count = uint32_t(entityCount(entities));
+    bool rebuild = sScene.entityBounds.size() != count || sScene.nodeEntityStart.size() != transforms.parent.size() + 1;
+    if (!rebuild && transforms.updatedNodes == 0) {
+        return;
+    }
+    PROFILE_CPU("bvh refit");
+
+    if (rebuild) {
+        /* entities per node, counted and then filled in slot order */
+        std::vector<uint32_t>& start = sScene.nodeEntityStart;
+        start.assign(transforms.parent.size() + 1, 0);
+        for (uint32_t i = 0; i < count; i++) {
+            start[entities.transform[i] + 1]++;
+        }
+        for (size_t n = 1; n < start.size(); n++) {
+            start[n] += start[n - 1];
+        }
+        sScene.nodeEntities.resize(count);
+        std::vector<uint32_t> next(start.begin(), start.end() - 1);
+        for (uint32_t i = 0; i < count; i++) {
+            sScene.nodeEntities[next[entities.transform[i]]++] = i;
+        }
+
+        sScene.entityBounds.resize(count);
+        parallelFor(0, count, 4096, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) {
+                sScene.entityBounds[i] = boundsTransform(entities.bounds[i], transforms.world[entities.transform[i]]);
+            }
+        });
+        bvhRefit(sScene.entityBvh, sScene.entityBounds);
+        return;
+    }
+
+    std::vector<uint32_t>& moved = sScene.movedEntities;
+    moved.clear();
+    for (int node : transforms.updated) {
+        moved.insert(moved.end(), sScene.nodeEntities.begin() + sScene.nodeEntityStart[node],
+                     sScene.nodeEntities.begin() + sScene.nodeEntityStart[node + 1]);
+    }
+    parallelFor(0, uint32_t(moved.size()), 4096, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t m = begin; m < end; m++) {
+            uint32_t i = moved[m];
+            sScene.entityBounds[i] = boundsTransform(entities.bounds[i], transforms.world[entities.transform[i]]);
+        }
+    });
+    bvhRefit(sScene.entityBvh, sScene.entityBounds, moved);
 }
-void setupBoat() {
-    sScene.bodyScalingMatrix = boat::bodyScale;
-    sScene.bodyTranslationMatrix = boat::bodyTrans;
-    sScene.bodyTransformationMatrix = Matrix4D::identity();
-
-    sScene.mastScalingMatrix = boat::mastScale;
-    sScene.mastTranslationMatrix = boat::mastTrans;
-    sScene.mastTransformationMatrix = Matrix4D::identity();
-
-    sScene.bridgeScalingMatrix = boat::bridgeScale;
-    sScene.bridgeTranslationMatrix = boat::bridgeTrans;
-    sScene.bridgeTransformationMatrix = Matrix4D::identity();
-
-    sScene.bulwarkLeftScalingMatrix = boat::bulwarkLeftScale;
-    sScene.bulwarkLeftTranslationMatrix = boat::bulwarkLeftTrans;
-    sScene.bulwarkLeftTransformationMatrix = Matrix4D::identity();
-
-    sScene.bulwarkRightScalingMatrix = boat::bulwarkRightScale;
-    sScene.bulwarkRightTranslationMatrix = boat::bulwarkRightTrans;
-    sScene.bulwarkRightTransformationMatrix = Matrix4D::identity();
-
-    sScene.bulwarkFrontScalingMatrix = boat::bulwarkFrontScale;
-    sScene.bulwarkFrontTranslationMatrix = boat::bulwarkFrontTrans;
-    sScene.bulwarkFrontTransformationMatrix = Matrix4D::identity();
-
-    sScene.bulwarkBackScalingMatrix = boat::bulwarkBackScale;
-    sScene.bulwarkBackTranslationMatrix = boat::bulwarkBackTrans;
-    sScene.bulwarkBackTransformationMatrix = Matrix4D::identity();
+
+/* closest entity under a point of the window: the hierarchy finds the entities whose box is hit, their triangles are
+ * tested in the local space of the entity; returns its slot or UINT32_MAX and the distance in world units */
+uint32_t scenePick(float x, float y, float& distance)
+{
+    PROFILE_CPU("picking");
+    const Camera& camera = sScene.cameras[sScene.currentCamera];
+    PickRay ray = pickRayFromCursor(cameraMatrices(camera).inverseViewProjection, x, y);
+
+    const EntityStore& entities = sScene.entities;
+    float hitDistance = 1.0f;           // the ray spans the frustum from the near to the far plane
+    uint32_t entity = bvhRaycast(sScene.entityBvh, ray.origin, ray.direction, hitDistance, [&](uint32_t i, float maxDistance) {
+        const PickMesh& mesh = sScene.pickMeshes[entities.mesh[i]];
+        PickRay local = pickRayTransform(ray, inverse(sScene.transforms.world[entities.transform[i]]));
+        return pickMeshIntersect(mesh, local, maxDistance);
+    });
+    distance = hitDistance * length(ray.direction);
+    return entity;
 }
+
 /* function to setup and initialize the whole scene */
-void sceneInit(float width, float height)
+void sceneInit(float width, float height, const Options& options)
 {
+    /* kick off shader compilation first, the driver compiles in the background while the rest is set up */
+    sScene.shaderCache = shaderCacheCreate("shader_cache");
+    sScene.shaders = shaderLibraryCreate(&sScene.shaderCache);
+    std::string shaderColorKey = shaderVariantRequest(sScene.shaders, "shader/default.vert", "shader/default.frag");
+    std::string shaderInstancedKey;
+    if (options.fleet > 0) {
+        shaderInstancedKey = shaderVariantRequest(sScene.shaders, "shader/default.vert", "shader/default.frag", {"INSTANCED"});
+    }
+
+    /* the scene file describes the camera, the water and the hierarchy of nodes and entities */
+    SceneDescription scene = sceneLoad(options.scene, options.boats);
+    std::string shaderTexturedKey;
+    std::string shaderInstancedTexturedKey;
+    if (!scene.textures.empty()) {
+        shaderTexturedKey = shaderVariantRequest(sScene.shaders, "shader/default.vert", "shader/default.frag", {"TEXTURED"});
+        if (options.fleet > 0) {
+            shaderInstancedTexturedKey = shaderVariantRequest(sScene.shaders, "shader/default.vert", "shader/default.frag",
+                                                              {"INSTANCED", "TEXTURED"});
+        }
+    }
+
+    /* textures are only registered here, they are decoded and uploaded in the background once they are drawn */
+    TextureStreamSettings textureSettings;
+    textureSettings.budgetBytes = size_t(options.textureBudget) << 20;
+    textureSettings.uploadBytesPerFrame = size_t(options.uploadBudget) << 10;
+    textureSettings.layerSize = options.textureSize;
+    textureStreamCreate(sScene.textures, textureSettings);
+    std::string sceneDirectory = options.scene.substr(0, options.scene.find_last_of("/\\") + 1);
+    for (const std::string& file : scene.textures) {
+        bool absolute = !file.empty() && (file[0] == '/' || file[0] == '\\' || file.find(':') != std::string::npos);
+        sScene.textureHandles.push_back(textureStreamAdd(sScene.textures, absolute ? file : sceneDirectory + file));
+    }
+
     /* initialize camera[0] */
-    sScene.cameras[0] = cameraCreate(width, height, to_radians(45.0f), 0.01f, 500.0f, {10.0f, 14.0f, 10.0f}, {0.0f, 4.0f, 0.0f});
+    const SceneCamera& sceneCamera = scene.camera;
+    sScene.cameras[0] = cameraCreate(width, height, to_radians(sceneCamera.fov), sceneCamera.nearPlane,
+                                     sceneCamera.farPlane, sceneCamera.position, sceneCamera.lookAt);
     sScene.zoomSpeedMultiplier = 0.05f;
 
     /* setup objects in scene and create opengl buffers for meshes */
-    sScene.cubeMesh = meshCreate(cube::vertices, cube::indices, GL_STATIC_DRAW, GL_STATIC_DRAW);
-    sScene.water = waterCreate(waterPlane::color);
-
+    int gridResolution = options.gridResolution > 0 ? options.gridResolution : scene.water.gridResolution;
+    sScene.water = waterCreate(scene.water.color, gridResolution);
 
     /* setup transformation matrices for objects */
     sScene.waterModelMatrix = waterPlane::trans;
 
-    //creation of the meshes for the boat
-    sScene.bodyMesh = meshCreate(cube::vertexPos, cube::indices, {0.5f, 0.102f, 0, 1.0f}, GL_STATIC_DRAW, GL_STATIC_DRAW);
-    sScene.mastMesh = meshCreate(cube::vertexPos, cube::indices, {0.3f, 0.102f, 0, 1.0f}, GL_STATIC_DRAW, GL_STATIC_DRAW);
-    sScene.bulwarkBackMesh = meshCreate(cube::vertexPos, cube::indices, {0.75f, 0.4f, 0, 1.0f}, GL_STATIC_DRAW, GL_STATIC_DRAW);
-    sScene.bulwarkLeftMesh = meshCreate(cube::vertexPos, cube::indices, {0.75f, 0.4f, 0, 1.0f}, GL_STATIC_DRAW, GL_STATIC_DRAW);
-    sScene.bulwarkFrontMesh = meshCreate(cube::vertexPos, cube::indices, {0.75f, 0.4f, 0, 1.0f}, GL_STATIC_DRAW, GL_STATIC_DRAW);
-    sScene.bulwarkRightMesh = meshCreate(cube::vertexPos, cube::indices, {0.75f, 0.4f, 0, 1.0f}, GL_STATIC_DRAW, GL_STATIC_DRAW);
-    sScene.bridgeMesh = meshCreate(cube::vertexPos, cube::indices, {1.0f, 1.0f, 1.0f, 1.0f}, GL_STATIC_DRAW, GL_STATIC_DRAW);
+    //built-in meshes are white, the entities are tinted with their entity color
+    for (const std::string& name : scene.meshes) {
+        if (name == "cube") {
+            sScene.meshes.push_back(meshCreate(cube::vertexPos, cube::indices, {1.0f, 1.0f, 1.0f, 1.0f}, GL_STATIC_DRAW, GL_STATIC_DRAW));
+            sScene.pickMeshes.push_back(pickMeshCreate(cube::vertexPos, cube::indices));
+        } else {
+            std::cerr << "[Scene] Unknown built-in mesh '" << name << "'" << std::endl;
+            throw std::runtime_error("[Scene] Unknown built-in mesh '" + name + "'");
+        }
+    }
+    sScene.selectedNode = -1;
+
+    /* the graph is empty, so the node indices of the scene are the indices in the graph */
+    transformAppend(sScene.transforms, scene.nodeParent.size(), scene.nodeParent.data(), scene.nodeTranslation.data(),
+                    scene.nodeRotation.data(), scene.nodeScale.data());
+    entityAppend(sScene.entities, scene.entityNode.size(), scene.entityNode.data(), scene.entityMesh.data(),
+                 scene.entityColor.data(), scene.entityBounds.data(), scene.entityTexture.data());
+    sScene.boatNode = scene.controlledNode;
+    if (sScene.boatNode < 0) {
+        /* nothing to steer, the keys move a node without entities */
+        sScene.boatNode = transformCreate(sScene.transforms);
+    }
 
-    setupBoat();
-    sScene.cubeTransformationMatrix = Matrix4D::identity();
+    if (options.fleet > 0 && !scene.prefabs.empty()) {
+        int prefab = std::max(scenePrefabFind(scene, "boat"), 0);
+        sScene.fleetParts = fleetPartsFromPrefab(scene, scene.prefabs[prefab]);
+        sScene.fleetMeshIdx = scene.parts[scene.prefabs[prefab].firstPart].mesh;
+    }
+    if (!sScene.fleetParts.empty() && !options.benchFleet) {
+        sScene.fleet = fleetCreate(sScene.meshes[sScene.fleetMeshIdx], sScene.fleetParts, options.fleet, 12.0f,
+                                   int(sScene.textureHandles.size()));
+    }
+    sScene.waterStill = options.stillWater || (options.onDemand && options.waterRate == 0);
+    sScene.onDemand = options.onDemand;
+    sScene.waterTick = std::chrono::steady_clock::duration::zero();
+    if(options.onDemand && options.waterRate > 0)
+    {
+        sScene.waterTick = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(1.0 / options.waterRate));
+    }
+    sScene.nextWaterTick = std::chrono::steady_clock::now();
+    transformUpdate(sScene.transforms);
+    entitiesUpdateBounds();
 
     sScene.cubeSpinRadPerSecond = M_PI / 2.0f;
 
-    /* load shader from file */
-    sScene.shaderColor = shaderLoad("shader/default.vert", "shader/default.frag");
+    /* wait for the shaders requested above */
+    shaderLibraryWait(sScene.shaders);
+    shaderLibraryReport(sScene.shaders);
+    shaderCacheReport(sScene.shaderCache);
+    sScene.shaderColor = &shaderVariantGet(sScene.shaders, shaderColorKey);
+    sScene.shaderInstanced = options.fleet > 0 ? &shaderVariantGet(sScene.shaders, shaderInstancedKey) : nullptr;
+    sScene.shaderTextured = !scene.textures.empty() ? &shaderVariantGet(sScene.shaders, shaderTexturedKey) : nullptr;
+    sScene.shaderInstancedTextured = !shaderInstancedTexturedKey.empty()
+                                         ? &shaderVariantGet(sScene.shaders, shaderInstancedTexturedKey) : nullptr;
+
+    sScene.frameUniformBuffer = uniformBufferCreate(eUniformBlockIdx::FrameData, sizeof(FrameUniforms));
+    sScene.elapsedTime = 0.0f;
+    sScene.frameDelta = 0.0f;
+}
+
+/* delete opengl shader and buffers of the scene */
+void sceneDelete()
+{
+    shaderLibraryDelete(sScene.shaders);
+    uniformBufferDelete(sScene.frameUniformBuffer);
+    waterDelete(sScene.water);
+    fleetDelete(sScene.fleet);
+    textureStreamDelete(sScene.textures);
+    for (const Mesh& mesh : sScene.meshes) {
+        meshDelete(mesh);
+    }
 }
 
 // Helper function for the camera task:
@@ -274,72 +516,102 @@ Vector3D vector4dToVector3d(Vector4D vec4d) {
 }
 /* function to move and update objects in scene (e.g., rotate cube according to user input) */
 void sceneUpdate(float dt) {
+    sScene.elapsedTime += dt;
+    sScene.frameDelta = dt;
+
+    /* take the input gathered by the callbacks since the last update */
+    bool buttonPressed[6];
+    Vector2D orbitDelta;
+    float zoomDelta;
+    int resizeWidth, resizeHeight;
+    bool pickRequested;
+    Vector2D pickPosition;
+    {
+        std::lock_guard<std::mutex> lock(sInput.mutex);
+        std::copy(sInput.buttonPressed, sInput.buttonPressed + 6, buttonPressed);
+        orbitDelta = sInput.orbitDelta;
+        zoomDelta = sInput.zoomDelta;
+        resizeWidth = sInput.resizeWidth;
+        resizeHeight = sInput.resizeHeight;
+        sInput.orbitDelta = {0.0f, 0.0f};
+        sInput.zoomDelta = 0.0f;
+        sInput.resizeWidth = sInput.resizeHeight = 0;
+        pickRequested = sInput.pickRequested;
+        pickPosition = sInput.pickPosition;
+        sInput.pickRequested = false;
+    }
+    if (resizeWidth > 0 && resizeHeight > 0) {
+        cameraResize(sScene.cameras[sScene.currentCamera], resizeWidth, resizeHeight);
+    }
+    if (orbitDelta.x != 0.0f || orbitDelta.y != 0.0f || zoomDelta != 0.0f) {
+        cameraUpdateOrbit(sScene.cameras[sScene.currentCamera], orbitDelta, zoomDelta);
+    }
+
     /* if 'w' or 's' pressed, cube should rotate around x axis */
     int rotationDirX = 0;
-    if (sInput.buttonPressed[0]) {
+    if (buttonPressed[0]) {
         rotationDirX = -1;
-    } else if (sInput.buttonPressed[1]) {
+    } else if (buttonPressed[1]) {
         rotationDirX = 1;
     }
 
     /* if 'a' or 'd' pressed, cube should rotate around y axis */
     int rotationDirY = 0;
-    if (sInput.buttonPressed[2]) {
+    if (buttonPressed[2]) {
         rotationDirY = -1;
-    } else if (sInput.buttonPressed[3]) {
+    } else if (buttonPressed[3]) {
         rotationDirY = 1;
     }
     //camera task
     bool cameraChange = false;
     int newCamera = 0;
-    if (sInput.buttonPressed[4] && sScene.currentCamera == 1) {
+    if (buttonPressed[4] && sScene.currentCamera == 1) {
         // Change to camera mode 1.
         cameraChange = true;
         newCamera = 0;
-    } else if (sInput.buttonPressed[5] && sScene.currentCamera == 0) {
+    } else if (buttonPressed[5] && sScene.currentCamera == 0) {
         // Change to camera mode 2.
         cameraChange = true;
         newCamera = 1;
     }
 
-    /* udpate the cube transformation matrixes to include new rotation if one of the keys was pressed */
+    /* rotate the boat root node, all parts follow through the hierarchy */
     if (rotationDirX != 0 || rotationDirY != 0) {
-        sScene.bodyTransformationMatrix = Matrix4D::rotationY(rotationDirY * sScene.cubeSpinRadPerSecond * dt)
-                * Matrix4D::rotationX(rotationDirX * sScene.cubeSpinRadPerSecond * dt) * sScene.bodyTransformationMatrix;
+        transformRotate(sScene.transforms, sScene.boatNode,
+                        Matrix3D::rotationY(rotationDirY * sScene.cubeSpinRadPerSecond * dt)
+                        * Matrix3D::rotationX(rotationDirX * sScene.cubeSpinRadPerSecond * dt));
     }
-    /* udpate cube transformation matrix to include new rotation if one of the keys was pressed */
-    if (rotationDirX != 0 || rotationDirY != 0) {
-        sScene.mastTransformationMatrix = Matrix4D::rotationY(rotationDirY * sScene.cubeSpinRadPerSecond * dt)
-                                          * Matrix4D::rotationX(rotationDirX * sScene.cubeSpinRadPerSecond * dt) * sScene.mastTransformationMatrix;
-    }
-    /* udpate cube transformation matrix to include new rotation if one of the keys was pressed */
-    if (rotationDirX != 0 || rotationDirY != 0) {
-        sScene.bridgeTransformationMatrix = Matrix4D::rotationY(rotationDirY * sScene.cubeSpinRadPerSecond * dt)
-                                          * Matrix4D::rotationX(rotationDirX * sScene.cubeSpinRadPerSecond * dt) * sScene.bridgeTransformationMatrix;
-    }
-    /* udpate cube transformation matrix to include new rotation if one of the keys was pressed */
-    if (rotationDirX != 0 || rotationDirY != 0) {
-        sScene.bulwarkFrontTransformationMatrix = Matrix4D::rotationY(rotationDirY * sScene.cubeSpinRadPerSecond * dt)
-                                          * Matrix4D::rotationX(rotationDirX * sScene.cubeSpinRadPerSecond * dt) * sScene.bulwarkFrontTransformationMatrix;
-    }
-    /* udpate cube transformation matrix to include new rotation if one of the keys was pressed */
-    if (rotationDirX != 0 || rotationDirY != 0) {
-        sScene.bulwarkBackTransformationMatrix = Matrix4D::rotationY(rotationDirY * sScene.cubeSpinRadPerSecond * dt)
-                                                  * Matrix4D::rotationX(rotationDirX * sScene.cubeSpinRadPerSecond * dt) * sScene.bulwarkBackTransformationMatrix;
-    }
-    /* udpate cube transformation matrix to include new rotation if one of the keys was pressed */
-    if (rotationDirX != 0 || rotationDirY != 0) {
-        sScene.bulwarkLeftTransformationMatrix = Matrix4D::rotationY(rotationDirY * sScene.cubeSpinRadPerSecond * dt)
-                                                  * Matrix4D::rotationX(rotationDirX * sScene.cubeSpinRadPerSecond * dt) * sScene.bulwarkLeftTransformationMatrix;
+    entityIntegrate(sScene.entities, sScene.transforms, dt);
+    transformUpdate(sScene.transforms);
+    entitiesUpdateBounds();
+    fleetUpdate(sScene.fleet, dt);
+
+    /* select the boat under the cursor of a click, a click on the water clears the selection */
+    if (pickRequested) {
+        auto start = std::chrono::steady_clock::now();
+        float distance = 0.0f;
+        uint32_t entity = scenePick(pickPosition.x, pickPosition.y, distance);
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        sScene.selectedNode = entity == UINT32_MAX ? -1 : sScene.transforms.parent[sScene.entities.transform[entity]];
+        if (entity == UINT32_MAX) {
+            std::cout << "[Picking] Nothing hit (" << us << " us)" << std::endl;
+        } else if (sScene.selectedNode < 0) {
+            /* an entity on a root node, not a part of a boat */
+            std::cout << "[Picking] Hit entity " << entity << " at distance " << distance << ", not a boat (" << us
+                      << " us)" << std::endl;
+        } else {
+            std::cout << "[Picking] Selected boat " << sScene.selectedNode << " at distance " << distance << " ("
+                      << us << " us)" << std::endl;
+        }
     }
-    /* udpate cube transformation matrix to include new rotation if one of the keys was pressed */
-    if (rotationDirX != 0 || rotationDirY != 0) {
-        sScene.bulwarkRightTransformationMatrix = Matrix4D::rotationY(rotationDirY * sScene.cubeSpinRadPerSecond * dt)
-                                                  * Matrix4D::rotationX(rotationDirX * sScene.cubeSpinRadPerSecond * dt) * sScene.bulwarkLeftTransformationMatrix;
+
+    if (!sScene.waterStill) {
+        waterSimulate(sScene.water, sScene.waterSim, dt);
     }
+
         // Update camera:
         Vector3D centralPointOfBoat =
-                vector4dToVector3d((sScene.bodyTransformationMatrix) * centralPointBeforeTransformation);
+                vector4dToVector3d(transformWorld(sScene.transforms, sScene.boatNode) * centralPointBeforeTransformation);
         if (cameraChange) {
             Camera oldCamera = sScene.cameras[sScene.currentCamera];
             if (newCamera == 0) {
@@ -356,131 +628,593 @@ void sceneUpdate(float dt) {
         }
 
         if (sScene.currentCamera == 1) {
-            sScene.cameras[sScene.currentCamera].lookAt = centralPointOfBoat;
+            cameraSetLookAt(sScene.cameras[sScene.currentCamera], centralPointOfBoat);
         }
     }
 
-void boatDraw()
+/* view space distance of the origin of a model matrix, used to sort draw packets */
+float viewDepth(const Matrix4D& view, const Matrix4D& model)
 {
-    shaderUniform(sScene.shaderColor, "uModel", sScene.bodyTranslationMatrix * sScene.bodyTransformationMatrix * sScene.bodyScalingMatrix);
-    glBindVertexArray(sScene.bodyMesh.vao);
-    glDrawElements(GL_TRIANGLES, sScene.bodyMesh.size_ibo, GL_UNSIGNED_INT, nullptr);
+    return -(view * model[3]).z;
+}
 
-    shaderUniform(sScene.shaderColor, "uModel", sScene.bodyTransformationMatrix * sScene.mastTranslationMatrix * sScene.mastScalingMatrix);
-    glBindVertexArray(sScene.mastMesh.vao);
-    glDrawElements(GL_TRIANGLES, sScene.mastMesh.size_ibo, GL_UNSIGNED_INT, nullptr);
+/* queues the entities inside the view frustum, in the order of the component arrays */
+void entitiesEnqueue(RenderQueue& queue, const Matrix4D& view, const Vector4D frustum[6])
+{
+    const EntityStore& entities = sScene.entities;
+    std::vector<uint32_t>& visible = sScene.visibleEntities;
+    visible.clear();
+    bvhQueryFrustum(sScene.entityBvh, frustum, visible);
+    std::sort(visible.begin(), visible.end());
+    for (uint32_t i : visible) {
+        const Mesh& mesh = sScene.meshes[entities.mesh[i]];
+        const Matrix4D& model = sScene.transforms.world[entities.transform[i]];
+        DrawPacket packet;
+        packet.program = sScene.shaderColor;
+        if (entities.texture[i] >= 0) {
+            packet.program = sScene.shaderTextured;
+            packet.texture = sScene.textures.array;
+            packet.layer = float(textureStreamUse(sScene.textures, sScene.textureHandles[entities.texture[i]]));
+        }
+        packet.vao = mesh.vao;
+        packet.indexCount = mesh.size_ibo;
+        packet.model = model;
+        packet.color = sScene.transforms.parent[entities.transform[i]] == sScene.selectedNode && sScene.selectedNode >= 0
+                           ? colorLightYellow : entities.color[i];
+        packet.depth = viewDepth(view, model);
+        packet.transparent = entities.color[i].w < 1.0f;
+        renderQueuePush(queue, packet);
+    }
+}
 
-    shaderUniform(sScene.shaderColor, "uModel",sScene.bodyTransformationMatrix * sScene.bridgeTranslationMatrix * sScene.bridgeScalingMatrix);
-    glBindVertexArray(sScene.bridgeMesh.vao);
-    glDrawElements(GL_TRIANGLES, sScene.bridgeMesh.size_ibo, GL_UNSIGNED_INT, nullptr);
+/* function to capture everything the renderer needs from the simulated scene, no OpenGL calls here */
+void sceneSnapshot(RenderSnapshot& snapshot)
+{
+    const Camera& camera = sScene.cameras[sScene.currentCamera];
+    const CameraMatrices& matrices = cameraMatrices(camera);
+    snapshot.frame++;
+    snapshot.view = matrices.view;
+    snapshot.projection = matrices.projection;
+    snapshot.viewProjection = matrices.viewProjection;
+    snapshot.cameraPos = Vector4D(camera.position, 1.0f);
+    snapshot.elapsedTime = sScene.elapsedTime;
+    snapshot.frameDelta = sScene.frameDelta;
+
+    /* collect draw packets, the renderer sorts them and sets the uniforms (names match the ones in the shader) */
+    {
+        PROFILE_CPU("culling");
+        renderQueueBegin(snapshot.queue, camera.farPlane);
+
+        /* water plane, it carries its colors per vertex */
+        DrawPacket water;
+        water.program = sScene.shaderColor;
+        water.vao = sScene.water.mesh.vao;
+        water.indexCount = sScene.water.mesh.size_ibo;
+        water.model = sScene.waterModelMatrix;
+        water.color = Vector4D(1.0f, 1.0f, 1.0f, 1.0f);
+        water.depth = viewDepth(matrices.view, sScene.waterModelMatrix);
+        renderQueuePush(snapshot.queue, water);
+
+        /* boats */
+        entitiesEnqueue(snapshot.queue, matrices.view, matrices.frustum);
+        for (size_t livery = 0; livery < sScene.fleet.liveryLayers.size(); livery++) {
+            sScene.fleet.liveryLayers[livery] = float(textureStreamUse(sScene.textures, sScene.textureHandles[livery]));
+        }
+        snapshot.fleetVisible = fleetCull(sScene.fleet, matrices.frustum, snapshot.fleetInstances, snapshot.fleetLayers);
+        fleetEnqueue(sScene.fleet, snapshot.queue, sScene.shaderInstanced, snapshot.fleetVisible, matrices.view,
+                     sScene.shaderInstancedTextured, sScene.textures.array);
+    }
 
-    shaderUniform(sScene.shaderColor, "uModel", sScene.bodyTransformationMatrix * sScene.bulwarkLeftTranslationMatrix * sScene.bulwarkLeftScalingMatrix);
-    glBindVertexArray(sScene.bulwarkLeftMesh.vao);
-    glDrawElements(GL_TRIANGLES, sScene.bulwarkLeftMesh.size_ibo, GL_UNSIGNED_INT, nullptr);
+    snapshot.waterChanged = !sScene.waterStill;
+    if (snapshot.waterChanged) {
+        snapshot.waterVertices = sScene.water.vertices;
+    }
+}
 
-    shaderUniform(sScene.shaderColor, "uModel",  sScene.bodyTransformationMatrix * sScene.bulwarkBackTranslationMatrix * sScene.bulwarkBackScalingMatrix);
-    glBindVertexArray(sScene.bulwarkBackMesh.vao);
-    glDrawElements(GL_TRIANGLES, sScene.bulwarkBackMesh.size_ibo, GL_UNSIGNED_INT, nullptr);
+/* function to draw all objects of a snapshot */
+void sceneDraw(RenderSnapshot& snapshot)
+{
+    glStateNewFrame();
 
-    shaderUniform(sScene.shaderColor, "uModel",  sScene.bodyTransformationMatrix * sScene.bulwarkRightTranslationMatrix * sScene.bulwarkRightScalingMatrix);
-    glBindVertexArray(sScene.bulwarkRightMesh.vao);
-    glDrawElements(GL_TRIANGLES, sScene.bulwarkRightMesh.size_ibo, GL_UNSIGNED_INT, nullptr);
+    /* clear framebuffer color */
+    {
+        PROFILE_GPU("clear");
+        glClearColor(135.0 / 255, 206.0 / 255, 235.0 / 255, 1.0);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
 
-    shaderUniform(sScene.shaderColor, "uModel",  sScene.bodyTransformationMatrix * sScene.bulwarkFrontTranslationMatrix * sScene.bulwarkFrontScalingMatrix);
-    glBindVertexArray(sScene.bulwarkFrontMesh.vao);
-    glDrawElements(GL_TRIANGLES, sScene.bulwarkFrontMesh.size_ibo, GL_UNSIGNED_INT, nullptr);
+    /* upload per-frame constants once, they are visible to every program through the FrameData block */
+    {
+        PROFILE_CPU("upload");
+        FrameUniforms frame;
+        frame.view = snapshot.view;
+        frame.proj = snapshot.projection;
+        frame.viewProj = snapshot.viewProjection;
+        frame.cameraPos = snapshot.cameraPos;
+        frame.time = Vector4D(snapshot.elapsedTime, snapshot.frameDelta, 0.0f, 0.0f);
+        uniformBufferUpdate(sScene.frameUniformBuffer, &frame, sizeof(FrameUniforms));
+
+        if (snapshot.waterChanged) {
+            meshUpdateVertices(sScene.water.mesh, snapshot.waterVertices);
+        }
+        if (sScene.fleet.vao != 0) {
+            fleetUpload(sScene.fleet, snapshot.fleetInstances, snapshot.fleetLayers, snapshot.fleetVisible);
+        }
+        textureStreamUpdate(sScene.textures);
+    }
+
+    /*------------ render scene -------------*/
+    {
+        PROFILE_CPU("submit");
+        PROFILE_GPU("draw");
+        renderQueueSubmit(snapshot.queue);
+    }
+    glCheckError();
+
+    /* no cleanup of bindings here, they are shadowed by the state cache and reused by the next frame */
+}
+
+/* true while the scene changes without further events: held keys turn the boat, entities with a velocity move;
+ * streamed textures and screenshot readbacks also need further frames to complete */
+bool sceneAnimating()
+{
+    {
+        std::lock_guard<std::mutex> lock(sInput.mutex);
+        if(std::any_of(sInput.buttonPressed, sInput.buttonPressed + 4, [](bool pressed) { return pressed; }))
+            return true;
+    }
+    if(!sScene.fleet.x.empty() || textureStreamPending(sScene.textures) || screenshotPending(sScene.screenshots))
+        return true;
+    return std::any_of(sScene.entities.velocity.begin(), sScene.entities.velocity.end(),
+                       [](const Vector3D& v) { return v.x != 0.0f || v.y != 0.0f || v.z != 0.0f; });
 }
 
+/* on-demand rendering: sleep in glfwWaitEvents until a frame is needed, returns false for events without effect */
+bool onDemandWait()
+{
+    using clock = std::chrono::steady_clock;
+    bool timer = sScene.waterTick.count() > 0;
+    auto dirty = [] {
+        std::lock_guard<std::mutex> lock(sInput.mutex);
+        return sInput.dirty;
+    };
+
+    bool animating = sceneAnimating();
+    if(!animating && !dirty() && !(timer && clock::now() >= sScene.nextWaterTick))
+    {
+        PROFILE_CPU("idle");
+        if(timer)
+            glfwWaitEventsTimeout(std::max(std::chrono::duration<double>(sScene.nextWaterTick - clock::now()).count(), 0.0));
+        else
+            glfwWaitEvents();
+        animating = sceneAnimating();
+    }
+
+    /* the water advances by whole ticks, after a long frame the next tick is one period from now */
+    bool tick = timer && clock::now() >= sScene.nextWaterTick;
+    if(tick)
+    {
+        sScene.nextWaterTick += sScene.waterTick;
+        if(sScene.nextWaterTick < clock::now())
+            sScene.nextWaterTick = clock::now() + sScene.waterTick;
+    }
 
+    std::lock_guard<std::mutex> lock(sInput.mutex);
+    bool redraw = sInput.dirty || tick || animating;
+    sInput.dirty = false;
+    return redraw;
+}
 
-/* function to draw all objects in the scene */
-void sceneDraw()
+/* casts rays through random points of the window and prints the time per pick */
+void benchmarkPicking(int rays)
 {
-    /* clear framebuffer color */
-    glClearColor(135.0 / 255, 206.0 / 255, 235.0 / 255, 1.0);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    std::vector<double> us;
+    int hits = 0;
+    uint32_t state = 12345u;
+    auto random = [&state] {
+        state = state * 1664525u + 1013904223u;
+        return float(state >> 8) / float(1 << 24);
+    };
+    for (int i = 0; i < rays; i++) {
+        float x = random();
+        float y = random();
+        float distance = 0.0f;
+        auto start = std::chrono::steady_clock::now();
+        hits += scenePick(x, y, distance) != UINT32_MAX ? 1 : 0;
+        us.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::sort(us.begin(), us.end());
+    double sum = 0.0;
+    for (double value : us) {
+        sum += value;
+    }
+    std::cout << "[Picking] " << entityCount(sScene.entities) << " entities, " << rays << " rays, " << hits
+              << " hits: avg " << sum / rays << " us, p50 " << us[rays / 2] << " us, p99 " << us[rays * 99 / 100]
+              << " us, max " << us.back() << " us" << std::endl;
+}
 
-    /*------------ render scene -------------*/
-    /* use shader and set the uniforms (names match the ones in the shader) */
-    {
-        glUseProgram(sScene.shaderColor.id);
-        shaderUniform(sScene.shaderColor, "uProj",  cameraProjection(sScene.cameras[sScene.currentCamera]));
-        shaderUniform(sScene.shaderColor, "uView",  cameraView(sScene.cameras[sScene.currentCamera]));
-
-        /* draw water plane */
-        shaderUniform(sScene.shaderColor, "uModel", sScene.waterModelMatrix);
-        glBindVertexArray(sScene.water.mesh.vao);
-        glDrawElements(GL_TRIANGLES, sScene.water.mesh.size_ibo, GL_UNSIGNED_INT, nullptr);
-
-        /* draw cube, requires to calculate the final model matrix from all transformations */
-        for (int i = 0; i < 7; i++){
-        shaderUniform(sScene.shaderColor, "uModel", sScene.cubeTranslationMatrix * sScene.cubeTransformationMatrix * sScene.cubeScalingMatrix);
-        glBindVertexArray(sScene.cubeMesh.vao);
-        glDrawElements(GL_TRIANGLES, sScene.cubeMesh.size_ibo, GL_UNSIGNED_INT, nullptr);
-        }
-        boatDraw();
+/* set input and camera from a keyframe of the benchmark path */
+void benchmarkApply(const BenchmarkKeyframe& key)
+{
+    const char buttons[] = {'w', 's', 'a', 'd', '1', '2'};
+    std::lock_guard<std::mutex> lock(sInput.mutex);
+    for (int i = 0; i < 6; i++) {
+        sInput.buttonPressed[i] = key.keys.find(buttons[i]) != std::string::npos;
     }
-    glCheckError();
 
-    /* cleanup opengl state */
-    glBindVertexArray(0);
-    glUseProgram(0);
+    Camera& camera = sScene.cameras[sScene.currentCamera];
+    cameraSetPosition(camera, key.position);
+    cameraSetLookAt(camera, key.lookAt);
 }
 
 int main(int argc, char** argv)
 {
-    /* create window/context */
-    int width = 1280;
-    int height = 720;
-    GLFWwindow* window = windowCreate("Assignment 1 - Transformations, User Input and Camera", width, height);
-    if(!window) { return EXIT_FAILURE; }
+    Options options;
+    if(!optionsParse(argc, argv, options)) { return EXIT_FAILURE; }
+    if(options.record == "-")
+    {
+        /* stdout carries the video stream, log to stderr */
+        std::cout.rdbuf(std::cerr.rdbuf());
+    }
+    if(options.benchJobs)
+    {
+        benchmarkJobs(options.jobs);
+        return EXIT_SUCCESS;
+    }
+    if(options.benchBvh)
+    {
+        benchmarkBvh();
+        return EXIT_SUCCESS;
+    }
+    if(!options.compileScene.empty())
+    {
+        SceneDescription scene = sceneLoad(options.scene, options.boats);
+        return sceneWriteBinary(scene, options.compileScene) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    jobsInit(options.jobs);
+
+    /* create window/context, headless runs render into an offscreen framebuffer instead of a window */
+    const std::string windowTitle = "Assignment 1 - Transformations, User Input and Camera";
+    int width = options.width;
+    int height = options.height;
+    GLFWwindow* window = nullptr;
+    HeadlessContext headless;
+    Framebuffer offscreen;
+    if(options.headless)
+    {
+        headless = headlessCreate(width, height);
+        if(!headless.window && !headless.eglContext) { return EXIT_FAILURE; }
 
-    /* set window callbacks */
-    glfwSetKeyCallback(window, keyCallback);
-    glfwSetCursorPosCallback(window, mousePosCallback);
-    glfwSetMouseButtonCallback(window, mouseButtonCallback);
-    glfwSetScrollCallback(window, mouseScrollCallback);
-    glfwSetFramebufferSizeCallback(window, windowResizeCallback);
+        offscreen = framebufferCreate(width, height);
+        glStateBindFramebuffer(GL_FRAMEBUFFER, offscreen.id);
+        glStateViewport(0, 0, width, height);
+    }
+    else
+    {
+        window = windowCreate(windowTitle, width, height);
+        if(!window) { return EXIT_FAILURE; }
+
+        /* set window callbacks */
+        glfwSetKeyCallback(window, keyCallback);
+        glfwSetCursorPosCallback(window, mousePosCallback);
+        glfwSetMouseButtonCallback(window, mouseButtonCallback);
+        glfwSetScrollCallback(window, mouseScrollCallback);
+        glfwSetFramebufferSizeCallback(window, windowResizeCallback);
+        glfwSetWindowRefreshCallback(window, windowRefreshCallback);
+    }
 
 
     /*---------- init opengl stuff ------------*/
-    glEnable(GL_DEPTH_TEST);
+    glStateEnable(GL_DEPTH_TEST, true);
 
-    /* setup scene */
-    sceneInit(width, height);
+    if(!options.profile.empty())
+    {
+        profilerSetEnabled(true);
+        profilerSetThreadName("main");
+    }
 
-    /*-------------- main loop ----------------*/
-    double timeStamp = glfwGetTime();
-    double timeStampNew = 0.0;
+    /* benchmarks run unthrottled with a scripted path, GPU times come from the profiler */
+    Benchmark bench;
+    if(options.benchmark)
+    {
+        bench.path = options.benchmarkPath.empty() ? benchmarkPathDefault() : benchmarkPathLoad(options.benchmarkPath);
+        profilerSetEnabled(true);
+    }
+
+    /* present mode and frame limiter, headless runs have nothing to present */
+    sScene.windowed = window != nullptr;
+    sScene.presentMode = options.benchmark ? PresentMode::Uncapped : PresentMode::Vsync;
+    presentModeParse(options.present, sScene.presentMode);
+    if(window) { sScene.presentMode = presentModeSet(sScene.presentMode); }
+    frameLimiterSetFps(sScene.limiter, options.fps);
 
-    /* loop until user closes window */
-    while(!glfwWindowShouldClose(window))
+    /* setup scene */
+    sceneInit(width, height, options);
+    if(options.benchPick)
     {
-        /* poll and process input and window events */
-        glfwPollEvents();
+        benchmarkPicking(1000);
+    }
+    if(options.benchFleet && sScene.fleetParts.empty())
+    {
+        std::cerr << "[Fleet] The scene has no prefab to build the fleet from" << std::endl;
+    }
+    else if(options.benchFleet)
+    {
+        /* the camera of the scene looks at the center of the fleets */
+        const CameraMatrices& matrices = cameraMatrices(sScene.cameras[0]);
+        FrameUniforms frameUniforms;
+        frameUniforms.view = matrices.view;
+        frameUniforms.proj = matrices.projection;
+        frameUniforms.viewProj = matrices.viewProjection;
+        frameUniforms.cameraPos = Vector4D(sScene.cameras[0].position, 1.0f);
+        uniformBufferUpdate(sScene.frameUniformBuffer, &frameUniforms, sizeof(FrameUniforms));
+        benchmarkFleet(sScene.meshes[sScene.fleetMeshIdx], sScene.fleetParts, sScene.shaderInstanced, matrices.view,
+                       matrices.frustum, options.fleet, 100);
+    }
+    /* record at the size of the framebuffer, which differs from the window size on high dpi screens */
+    Recorder recorder;
+    bool recording = false;
+    bool recordFailed = false;
+    if(!options.record.empty() && !options.benchFleet && !options.benchPick)
+    {
+        int recordWidth = width;
+        int recordHeight = height;
+        if(window) { glfwGetFramebufferSize(window, &recordWidth, &recordHeight); }
+        RecordFormat format = options.recordFormat == "yuv420" ? RecordFormat::YUV420 : RecordFormat::RGBA;
+        recording = recorderStart(recorder, options.record, format, options.recordMmap, options.recordBuffers,
+                                  recordWidth, recordHeight);
+        recordFailed = !recording;
+    }
+    if(options.benchFleet || options.benchPick || recordFailed)
+    {
+        /* benchmarks without a main loop, or nothing to run; no threads of the frame loop are started yet */
+        sceneDelete();
+        jobsShutdown();
+        if(options.headless)
+        {
+            framebufferDelete(offscreen);
+            headlessDelete(headless);
+        }
+        else
+        {
+            windowDelete(window);
+        }
+        return recordFailed ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+    screenshotQueueStart(sScene.screenshots);
+
+    /* render at a reduced resolution when the GPU can't keep up with the budget */
+    DynamicResolution resolution;
+    if(options.dynamicResolution)
+    {
+        DynamicResolutionSettings settings;
+        settings.targetMs = options.dynresTargetMs;
+        settings.minScale = float(options.dynresMin);
+        settings.maxScale = float(options.dynresMax);
+        settings.hysteresis = float(options.dynresHysteresis);
+        settings.interval = options.dynresInterval;
+        resolution = dynamicResolutionCreate(settings);
+    }
+
+    /*-------------- main loop ----------------*/
+    /* headless runs and benchmarks advance with a fixed time step so their output is reproducible */
+    const float fixedDt = 1.0f / 60.0f;
+    const bool useFixedDt = options.headless || options.benchmark;
+    const int warmup = options.benchmark ? options.warmup : 0;
+    auto clock = std::chrono::steady_clock::now;
+    auto runStart = clock();
+    int frame = 0;
+
+    /* simulation step producing the snapshot of the next frame, runs on its own thread with --pipelined */
+    auto simulationStamp = runStart;
+    int simulationFrame = 0;
+    pipelineStart(sScene.pipeline, [&](RenderSnapshot& snapshot) {
+        /* the benchmark path overrides the input and the camera */
+        if(options.benchmark)
+        {
+            benchmarkApply(benchmarkPathSample(bench.path, simulationFrame * fixedDt));
+        }
 
         /* update model matrix of cube */
-        timeStampNew = glfwGetTime();
-        sceneUpdate(timeStampNew - timeStamp);
-        timeStamp = timeStampNew;
+        PROFILE_CPU("update");
+        auto now = clock();
+        float dt = std::chrono::duration<float>(now - simulationStamp).count();
+        simulationStamp = now;
+        if(sScene.onDemand)
+        {
+            /* the first frame after idling must not advance the animations by the whole idle time */
+            dt = std::min(dt, 0.1f);
+        }
+        sceneUpdate(useFixedDt ? fixedDt : dt);
+        sceneSnapshot(snapshot);
+        simulationFrame++;
+    }, options.pipelined);
+
+    /* statistics of the on-demand mode */
+    std::clock_t cpuStart = std::clock();
+    double idleMs = 0.0;
+    uint64_t wakeups = 0;
+
+    /* loop until user closes window or the requested number of frames is rendered */
+    while(window == nullptr || !glfwWindowShouldClose(window))
+    {
+        if(options.frames > 0 && frame >= warmup + options.frames) { break; }
+
+        /* on-demand mode sleeps until something changed, events without a visible effect don't draw a frame */
+        if(sScene.onDemand)
+        {
+            auto waitStart = clock();
+            bool redraw = onDemandWait();
+            idleMs += std::chrono::duration<double, std::milli>(clock() - waitStart).count();
+            if(!redraw)
+            {
+                wakeups++;
+                continue;
+            }
+        }
+        auto frameStart = clock();
+        profilerBeginFrame();
+        PROFILE_CPU("frame");
 
-        /* draw all objects in the scene */
-        sceneDraw();
+        /* poll and process input and window events */
+        if(window)
+        {
+            PROFILE_CPU("events");
+            glfwPollEvents();
+        }
 
+        /* draw all objects of the latest simulated frame */
+        RenderStats renderStats;
+        {
+            PROFILE_CPU("draw");
+            RenderSnapshot& snapshot = pipelineAcquire(sScene.pipeline);
+            if(options.dynamicResolution)
+            {
+                int outputWidth = width;
+                int outputHeight = height;
+                if(window) { glfwGetFramebufferSize(window, &outputWidth, &outputHeight); }
+                dynamicResolutionBegin(resolution, offscreen.id, outputWidth, outputHeight);
+            }
+            sceneDraw(snapshot);
+            if(options.dynamicResolution && dynamicResolutionEnd(resolution) && window)
+            {
+                /* show the scale in the title, the window has no text overlay */
+                std::ostringstream title;
+                title << windowTitle << " | " << int(std::round(resolution.scale * 100.0f)) << "% (" << resolution.width
+                      << "x" << resolution.height << "), GPU " << resolution.gpuMs << " ms";
+                glfwSetWindowTitle(window, title.str().c_str());
+            }
+            renderStats = snapshot.queue.stats;
+            pipelineRelease(sScene.pipeline);
+        }
+        if(recording && window)
+        {
+            /* the frame size of the recording is fixed */
+            int framebufferWidth = 0;
+            int framebufferHeight = 0;
+            glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+            if(framebufferWidth != recorder.width || framebufferHeight != recorder.height)
+            {
+                std::cerr << "[Recorder] Framebuffer resized to " << framebufferWidth << "x" << framebufferHeight
+                          << ", recording stopped at " << recorder.width << "x" << recorder.height << std::endl;
+                recorderStop(recorder);
+                recording = false;
+            }
+        }
+        if(recording)
+        {
+            recorderCapture(recorder);
+        }
+        profilerEndFrame();
+        auto cpuEnd = clock();
 
         /* swap front and back buffer */
-        glfwSwapBuffers(window);
+        if(window)
+        {
+            PROFILE_CPU("swap");
+            glfwSwapBuffers(window);
+        }
+        else if(options.benchmark)
+        {
+            /* nothing throttles a headless benchmark, wait for the GPU so the frame time includes the rendering */
+            glFinish();
+        }
+        screenshotUpdate(sScene.screenshots);
+        if(recording)
+        {
+            recorderUpdate(recorder);
+        }
+        {
+            PROFILE_CPU("limiter");
+            frameLimiterWait(sScene.limiter);
+        }
+        pacingRecord(sScene.pacing);
+
+        if(options.benchmark && frame >= warmup)
+        {
+            auto frameEnd = clock();
+            benchmarkRecord(bench, std::chrono::duration<double, std::milli>(frameEnd - frameStart).count(),
+                            std::chrono::duration<double, std::milli>(cpuEnd - frameStart).count(),
+                            renderStats, glStateFrameStats());
+            if(options.dynamicResolution)
+            {
+                bench.resolutionScale.push_back(resolution.scale);
+            }
+        }
+        frame++;
+    }
+    pipelineStop(sScene.pipeline);
+    if(recording)
+    {
+        recorderStop(recorder);
+    }
+    if(options.pipelined || options.benchmark)
+    {
+        pipelineReport(sScene.pipeline, std::chrono::duration<double, std::milli>(clock() - runStart).count());
+    }
+
+    if(options.benchmark)
+    {
+        /* the last GPU frames belong to the measured ones, earlier ones to the warmup */
+        const std::vector<double>& gpuMs = profilerGpuFrameTimes();
+        size_t measured = std::min(gpuMs.size(), bench.frameMs.size());
+        bench.gpuMs.assign(gpuMs.end() - measured, gpuMs.end());
+        benchmarkWriteReport(bench, options, options.report);
+    }
+    if(!options.output.empty())
+    {
+        /* reads the front buffer of the window or the still bound offscreen framebuffer */
+        screenshotRequest(sScene.screenshots, options.output);
+    }
+    screenshotQueueStop(sScene.screenshots);
+    if(options.headless)
+    {
+        glFinish();
+        double ms = std::chrono::duration<double, std::milli>(clock() - runStart).count();
+        std::cout << "[Headless] Rendered " << frame << " frames at " << width << "x" << height << " in " << ms
+                  << " ms (" << ms / std::max(frame, 1) << " ms/frame)" << std::endl;
+    }
+    if(options.pacing)
+    {
+        pacingReport(sScene.pacing, pacingTargetMs());
+    }
+    fleetReport(sScene.fleet);
+    textureStreamReport(sScene.textures);
+    if(options.dynamicResolution)
+    {
+        dynamicResolutionReport(resolution);
+        dynamicResolutionDelete(resolution);
+    }
+    if(sScene.onDemand)
+    {
+        double wallMs = std::chrono::duration<double, std::milli>(clock() - runStart).count();
+        double cpuMs = 1000.0 * double(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+        std::cout << "[OnDemand] Drew " << frame << " frames in " << wallMs / 1000.0 << " s, idle "
+                  << 100.0 * idleMs / wallMs << "% of the time, " << wakeups << " wakeups without redraw, CPU "
+                  << 100.0 * cpuMs / wallMs << "% of one core" << std::endl;
+    }
+    if(!options.profile.empty())
+    {
+        profilerReport();
+        profilerExportChromeTrace(options.profile);
     }
 
 
     /*-------- cleanup --------*/
-    /* delete opengl shader and buffers */
-    shaderDelete(sScene.shaderColor);
-    waterDelete(sScene.water);
-    meshDelete(sScene.cubeMesh);
+    sceneDelete();
+
+    jobsShutdown();
 
     /* cleanup glfw/glcontext */
-    windowDelete(window);
+    if(options.headless)
+    {
+        framebufferDelete(offscreen);
+        headlessDelete(headless);
+    }
+    else
+    {
+        windowDelete(window);
+    }
 
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,462 @@
+#include "benchmark.h"
+#include "core/jobs.h"
+#include "mygl/camera.h"
+#include "mygl/profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace detail
+{
+Vector3D lerp(const Vector3D& a, const Vector3D& b, float t)
+{
+    return a + (b - a) * t;
+}
+
+/* nearest rank percentile of sorted values */
+double percentile(const std::vector<double>& sorted, double p)
+{
+    size_t rank = size_t(p / 100.0 * sorted.size() + 0.5);
+    return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+}
+
+double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void emptyTask(void*) {}
+
+void writeStats(std::ostream& out, const char* name, const std::vector<double>& values)
+{
+    out << "  \"" << name << "\": ";
+    if(values.empty())
+    {
+        out << "null";
+        return;
+    }
+
+    std::vector<double> sorted = values;
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0.0;
+    for(double value : sorted)
+        sum += value;
+
+    out << "{\"avg\": " << sum / sorted.size() << ", \"p50\": " << percentile(sorted, 50.0)
+        << ", \"p95\": " << percentile(sorted, 95.0) << ", \"p99\": " << percentile(sorted, 99.0)
+        << ", \"max\": " << sorted.back() << "}";
+}
+}
+
+std::vector<BenchmarkKeyframe> benchmarkPathDefault()
+{
+    /* orbit of radius 16 around the boat at the height of the default camera */
+    const int steps = 8;
+    const float duration = 12.0f;
+    const Vector3D lookAt = {0.0f, 4.0f, 0.0f};
+
+    std::vector<BenchmarkKeyframe> path;
+    for(int i = 0; i <= steps; i++)
+    {
+        float angle = 2.0f * M_PI * i / steps + M_PI / 4.0f;
+        BenchmarkKeyframe key;
+        key.time = duration * i / steps;
+        key.position = {16.0f * std::cos(angle), 14.0f, 16.0f * std::sin(angle)};
+        key.lookAt = lookAt;
+        key.keys = i < 3 ? "d" : i < 5 ? "w" : i < 7 ? "2" : "1";
+        path.push_back(key);
+    }
+    return path;
+}
+
+std::vector<BenchmarkKeyframe> benchmarkPathLoad(const std::string& filepath)
+{
+    std::ifstream file(filepath);
+    if(!file)
+    {
+        std::cerr << "[Benchmark] Couldn't open path " << filepath << std::endl;
+        std::cerr.flush();
+        throw std::runtime_error("[Benchmark] Couldn't open path " + filepath);
+    }
+
+    std::vector<BenchmarkKeyframe> path;
+    std::string line;
+    for(int lineNumber = 1; std::getline(file, line); lineNumber++)
+    {
+        size_t first = line.find_first_not_of(" \t\r");
+        if(first == std::string::npos || line[first] == '#')
+            continue;
+
+        std::istringstream stream(line);
+        BenchmarkKeyframe key;
+        stream >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.lookAt.x >> key.lookAt.y >> key.lookAt.z;
+        if(stream.fail() || (!path.empty() && key.time < path.back().time))
+        {
+            std::cerr << "[Benchmark] Invalid keyframe in " << filepath << " (" << lineNumber << "): " << line << std::endl;
+            std::cerr.flush();
+            throw std::runtime_error("[Benchmark] Invalid keyframe in " + filepath);
+        }
+        if(stream >> key.keys && key.keys == "-")
+            key.keys.clear();
+
+        path.push_back(key);
+    }
+
+    if(path.empty())
+    {
+        std::cerr << "[Benchmark] No keyframes in " << filepath << std::endl;
+        std::cerr.flush();
+        throw std::runtime_error("[Benchmark] No keyframes in " + filepath);
+    }
+    return path;
+}
+
+BenchmarkKeyframe benchmarkPathSample(const std::vector<BenchmarkKeyframe>& path, float time)
+{
+    float duration = path.back().time - path.front().time;
+    if(duration <= 0.0f)
+        return path.front();
+
+    time = path.front().time + std::fmod(time, duration);
+    size_t next = 1;
+    while(next < path.size() - 1 && path[next].time <= time)
+        next++;
+
+    const BenchmarkKeyframe& a = path[next - 1];
+    const BenchmarkKeyframe& b = path[next];
+    float t = b.time > a.time ? (time - a.time) / (b.time - a.time) : 0.0f;
+
+    BenchmarkKeyframe key;
+    key.time = time;
+    key.position = detail::lerp(a.position, b.position, t);
+    key.lookAt = detail::lerp(a.lookAt, b.lookAt, t);
+    key.keys = time >= b.time ? b.keys : a.keys;
+    return key;
+}
+
+void benchmarkRecord(Benchmark& bench, double frameMs, double cpuMs, const RenderStats& renderStats, const GLStateStats& stateStats)
+{
+    bench.frameMs.push_back(frameMs);
+    bench.cpuMs.push_back(cpuMs);
+    bench.draws += renderStats.draws;
+    bench.programChanges += renderStats.programChanges;
+    bench.vaoChanges += renderStats.vaoChanges;
+    bench.textureChanges += renderStats.textureChanges;
+    bench.uniformChanges += renderStats.uniformChanges;
+    bench.glCallsIssued += stateStats.issued;
+    bench.glCallsElided += stateStats.elided;
+}
+
+bool benchmarkWriteReport(const Benchmark& bench, const Options& options, const std::string& filepath)
+{
+    std::ostringstream out;
+    double frames = std::max<size_t>(bench.frameMs.size(), 1);
+
+    out << "{\n"
+        << "  \"frames\": " << bench.frameMs.size() << ",\n"
+        << "  \"warmup\": " << options.warmup << ",\n"
+        << "  \"width\": " << options.width << ",\n"
+        << "  \"height\": " << options.height << ",\n"
+        << "  \"headless\": " << (options.headless ? "true" : "false") << ",\n"
+        << "  \"scene\": \"";
+    jsonWriteEscaped(out, options.scene);
+    out << "\",\n"
+        << "  \"gridResolution\": " << options.gridResolution << ",\n"
+        << "  \"boats\": " << options.boats << ",\n";
+    detail::writeStats(out, "frameMs", bench.frameMs);
+    out << ",\n";
+    detail::writeStats(out, "cpuMs", bench.cpuMs);
+    out << ",\n";
+    detail::writeStats(out, "gpuMs", bench.gpuMs);
+    if(!bench.resolutionScale.empty())
+    {
+        out << ",\n";
+        detail::writeStats(out, "resolutionScale", bench.resolutionScale);
+    }
+    out << ",\n"
+        << "  \"drawsPerFrame\": " << bench.draws / frames << ",\n"
+        << "  \"programChangesPerFrame\": " << bench.programChanges / frames << ",\n"
+        << "  \"vaoChangesPerFrame\": " << bench.vaoChanges / frames << ",\n"
+        << "  \"textureChangesPerFrame\": " << bench.textureChanges / frames << ",\n"
+        << "  \"uniformChangesPerFrame\": " << bench.uniformChanges / frames << ",\n"
+        << "  \"glCallsIssuedPerFrame\": " << bench.glCallsIssued / frames << ",\n"
+        << "  \"glCallsElidedPerFrame\": " << bench.glCallsElided / frames << "\n"
+        << "}\n";
+
+    if(filepath.empty())
+    {
+        std::cout << out.str();
+        return true;
+    }
+
+    std::ofstream file(filepath);
+    file << out.str();
+    if(!file)
+    {
+        std::cerr << "[Benchmark] Couldn't write report " << filepath << std::endl;
+        return false;
+    }
+    std::cout << "[Benchmark] Wrote report " << filepath << std::endl;
+    return true;
+}
+
+void benchmarkJobs(int workers)
+{
+    unsigned int hardware = std::max(std::thread::hardware_concurrency(), 1u);
+    unsigned int maxWorkers = workers < 0 ? hardware - 1 : workers;
+    std::cout << "[Jobs] " << hardware << " hardware thread(s), measuring up to " << maxWorkers << " worker(s)" << std::endl;
+
+    /* spawn overhead: batches of empty jobs, small enough to fit the deques */
+    jobsInit(maxWorkers);
+    {
+        const int batches = 200;
+        const int batchSize = 1000;
+        auto start = std::chrono::steady_clock::now();
+        for(int batch = 0; batch < batches; batch++)
+        {
+            JobCounter counter;
+            for(int i = 0; i < batchSize; i++)
+                jobRun(counter, detail::emptyTask, nullptr);
+            jobWait(counter);
+        }
+        std::cout << "[Jobs] spawn + wait: " << detail::elapsedMs(start) * 1e6 / (batches * batchSize) << " ns per empty job" << std::endl;
+
+        const uint32_t count = 1 << 20;
+        std::vector<uint32_t> values(count, 0);
+        start = std::chrono::steady_clock::now();
+        parallelFor(0, count, 1, [&](uint32_t begin, uint32_t end) {
+            for(uint32_t i = begin; i < end; i++)
+                values[i] = i;
+        });
+        double ms = detail::elapsedMs(start);
+        bool valid = true;
+        for(uint32_t i = 0; i < count; i++)
+            valid &= values[i] == i;
+        std::cout << "[Jobs] parallelFor grain 1: " << ms * 1e6 / count << " ns per element" << (valid ? "" : " (INVALID RESULT)") << std::endl;
+
+        /* dependency: the continuation has to see the results of all jobs of the first counter */
+        std::atomic<int> done{0};
+        int seen = -1;
+        struct Dependency { std::atomic<int>* done; int* seen; } dependency = {&done, &seen};
+        JobCounter first, second;
+        for(int i = 0; i < 64; i++)
+            jobRun(first, [](void* data) { static_cast<Dependency*>(data)->done->fetch_add(1); }, &dependency);
+        jobRunAfter(first, second, [](void* data) {
+            Dependency* d = static_cast<Dependency*>(data);
+            *d->seen = d->done->load();
+        }, &dependency);
+        jobWait(second);
+        std::cout << "[Jobs] dependency: continuation saw " << seen << "/64 finished jobs" << std::endl;
+    }
+
+    /* scaling of a compute bound loop, about 10 us of work per grain */
+    const uint32_t count = 1 << 23;
+    const uint32_t grain = 4096;
+    std::vector<float> output(count);
+    double inlineMs = 0.0;
+    std::vector<unsigned int> workerCounts = {0};
+    for(unsigned int w = 1; w < maxWorkers; w *= 2)
+        workerCounts.push_back(w);
+    if(maxWorkers > 0)
+        workerCounts.push_back(maxWorkers);
+
+    for(unsigned int w : workerCounts)
+    {
+        jobsInit(w);
+        double best = 1e30;
+        for(int run = 0; run < 5; run++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            parallelFor(0, count, grain, [&](uint32_t begin, uint32_t end) {
+                for(uint32_t i = begin; i < end; i++)
+                    output[i] = std::sqrt(float(i)) * std::sin(i * 0.001f);
+            });
+            best = std::min(best, detail::elapsedMs(start));
+        }
+        if(w == 0)
+            inlineMs = best;
+
+        double speedup = inlineMs / best;
+        std::cout << "[Jobs] parallelFor " << count << " elements, " << w << " worker(s): " << best << " ms, speedup "
+                  << speedup << ", efficiency " << 100.0 * speedup / (w + 1) << "% (the waiting thread helps)" << std::endl;
+    }
+    jobsShutdown();
+}
+
+void benchmarkFleet(const Mesh& mesh, const std::vector<FleetPart>& parts, const ShaderProgram* program,
+                    const Matrix4D& view, const Vector4D frustum[6], int maxCount, int frames)
+{
+    std::vector<int> counts;
+    for(int count = 1000; count < maxCount; count *= 2)
+        counts.push_back(count);
+    counts.push_back(maxCount);
+
+    const int warmup = 10;
+    frames = std::max(frames, 1);
+    std::cout << "[Fleet] " << frames << " frames per size, " << jobsWorkerCount() << " worker(s)" << std::endl;
+    std::cout << "[Fleet]    boats  visible  update ms  cull ms  upload ms  draw ms  total ms  ns/boat" << std::endl;
+
+    RenderQueue queue;
+    std::vector<Matrix4D> instances;
+    std::vector<float> layers;
+    for(int count : counts)
+    {
+        Fleet fleet = fleetCreate(mesh, parts, count);
+        double drawMs = 0.0;
+        for(int frame = 0; frame < warmup + frames; frame++)
+        {
+            if(frame == warmup)
+            {
+                fleet.frames = 0;
+                fleet.visibleSum = 0;
+                fleet.updateMs = fleet.cullMs = fleet.uploadMs = 0.0;
+                drawMs = 0.0;
+            }
+            fleetUpdate(fleet, 1.0f / 60.0f);
+            GLsizei visible = fleetCull(fleet, frustum, instances, layers);
+            renderQueueBegin(queue, 500.0f);
+            fleetEnqueue(fleet, queue, program, visible, view);
+            fleetUpload(fleet, instances, layers, visible);
+
+            /* wait for the GPU, the draw time includes the rendering */
+            auto start = std::chrono::steady_clock::now();
+            renderQueueSubmit(queue);
+            glFinish();
+            drawMs += detail::elapsedMs(start);
+        }
+
+        double updateMs = fleet.updateMs / frames;
+        double cullMs = fleet.cullMs / frames;
+        double uploadMs = fleet.uploadMs / frames;
+        double totalMs = updateMs + cullMs + uploadMs + drawMs / frames;
+        char row[128];
+        std::snprintf(row, sizeof(row), "%9d %8.0f %10.3f %8.3f %10.3f %8.3f %9.3f %8.1f", count,
+                      double(fleet.visibleSum) / frames, updateMs, cullMs, uploadMs, drawMs / frames, totalMs,
+                      totalMs * 1e6 / count);
+        std::cout << "[Fleet] " << row << std::endl;
+        fleetDelete(fleet);
+    }
+}
+
+void benchmarkBvh()
+{
+    const int queries = 100;
+    const int scans = 10;           // queries repeated as linear scans, they take long with 1M boxes
+    std::cout << "[BVH] " << queries << " queries per type, linear scans over the first " << scans << std::endl;
+    std::cout << "[BVH]    boxes  build ms  refit ms rebuilds    nodes   cost | query      bvh us   scan us  results" << std::endl;
+
+    for(int count : {10000, 100000, 1000000})
+    {
+        /* boxes of boat size on a square of the same density as a fleet */
+        uint32_t state = 12345u;
+        auto random = [&state](float min, float max) {
+            state = state * 1664525u + 1013904223u;
+            return min + (max - min) * float(state >> 8) / float(1 << 24);
+        };
+        float extent = 6.0f * std::sqrt(float(count));
+        std::vector<Bounds> bounds(count);
+        std::vector<Vector3D> velocity(count);
+        for(Bounds& box : bounds)
+        {
+            Vector3D center(random(-extent, extent), random(0.0f, 2.0f), random(-extent, extent));
+            Vector3D half(random(0.5f, 3.5f), random(0.5f, 2.0f), random(0.5f, 1.5f));
+            box = {center - half, center + half};
+        }
+        for(Vector3D& v : velocity)
+            v = Vector3D(random(-4.0f, 4.0f), 0.0f, random(-4.0f, 4.0f));
+
+        Bvh bvh;
+        auto start = std::chrono::steady_clock::now();
+        bvhBuild(bvh, bounds);
+        double buildMs = detail::elapsedMs(start);
+
+        /* one second of movement at 60 Hz, the refit time includes the rebuilds they trigger */
+        const int steps = 60;
+        double refitMs = 0.0;
+        for(int step = 0; step < steps; step++)
+        {
+            for(int i = 0; i < count; i++)
+            {
+                Vector3D delta = velocity[i] * (1.0f / 60.0f);
+                bounds[i].min += delta;
+                bounds[i].max += delta;
+            }
+            start = std::chrono::steady_clock::now();
+            bvhRefit(bvh, bounds);
+            refitMs += detail::elapsedMs(start);
+        }
+        char head[96];
+        std::snprintf(head, sizeof(head), "%9d %9.2f %9.3f %8llu %8zu %6.1f", count, buildMs, refitMs / steps,
+                      (unsigned long long) bvh.builds - 1, bvh.nodes.size(), bvhCost(bvh));
+
+        /* random query shapes over the whole area */
+        std::vector<Camera> cameras;
+        std::vector<Bounds> boxes;
+        std::vector<Vector3D> centers, origins, directions;
+        for(int q = 0; q < queries; q++)
+        {
+            Vector3D position(random(-extent, extent), random(5.0f, 30.0f), random(-extent, extent));
+            Vector3D target(position.x + random(-50.0f, 50.0f), 0.0f, position.z + random(-50.0f, 50.0f));
+            cameras.push_back(cameraCreate(1280.0f, 720.0f, float(to_radians(45.0)), 0.1f, 500.0f, position, target));
+            Vector3D center(random(-extent, extent), 0.0f, random(-extent, extent));
+            boxes.push_back({center - Vector3D(25.0f, 5.0f, 25.0f), center + Vector3D(25.0f, 5.0f, 25.0f)});
+            centers.push_back(center);
+            origins.push_back(position);
+            directions.push_back(normalize(target - position));
+        }
+
+        std::vector<uint32_t> result;
+        auto run = [&](const char* name, const auto& query, const auto& scan) {
+            size_t hits = 0;
+            start = std::chrono::steady_clock::now();
+            for(int q = 0; q < queries; q++)
+            {
+                result.clear();
+                query(q, result);
+                hits += result.size();
+            }
+            double bvhUs = detail::elapsedMs(start) * 1000.0 / queries;
+
+            size_t scanHits = 0, queryHits = 0;
+            start = std::chrono::steady_clock::now();
+            for(int q = 0; q < scans; q++)
+            {
+                for(int i = 0; i < count; i++)
+                    scanHits += scan(q, bounds[i]) ? 1 : 0;
+            }
+            double scanUs = detail::elapsedMs(start) * 1000.0 / scans;
+            for(int q = 0; q < scans; q++)
+            {
+                result.clear();
+                query(q, result);
+                queryHits += result.size();
+            }
+
+            char row[160];
+            std::snprintf(row, sizeof(row), "%s | %-8s %9.1f %9.1f %8.1f%s", head, name, bvhUs, scanUs,
+                          double(hits) / queries, scanHits == queryHits ? "" : " (MISMATCH)");
+            std::cout << "[BVH] " << row << std::endl;
+            std::fill(head, head + std::strlen(head), ' ');
+        };
+
+        run("frustum", [&](int q, std::vector<uint32_t>& out) { bvhQueryFrustum(bvh, cameraMatrices(cameras[q]).frustum, out); },
+            [&](int q, const Bounds& box) { return frustumClassify(cameraMatrices(cameras[q]).frustum, box) != 0; });
+        run("box", [&](int q, std::vector<uint32_t>& out) { bvhQueryBounds(bvh, boxes[q], out); },
+            [&](int q, const Bounds& box) { return boundsOverlap(box, boxes[q]); });
+        run("sphere", [&](int q, std::vector<uint32_t>& out) { bvhQuerySphere(bvh, centers[q], 25.0f, out); },
+            [&](int q, const Bounds& box) { return boundsOverlapSphere(box, centers[q], 25.0f); });
+        run("ray", [&](int q, std::vector<uint32_t>& out) { bvhQueryRay(bvh, origins[q], directions[q], 500.0f, out); },
+            [&](int q, const Bounds& box) {
+                Vector3D inverse(1.0f / directions[q].x, 1.0f / directions[q].y, 1.0f / directions[q].z);
+                return boundsRay(box, origins[q], inverse, 500.0f) >= 0.0f;
+            });
+    }
+}
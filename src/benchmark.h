@@ -0,0 +1,124 @@
+#pragma once
+
+#include "mygl/base.h"
+#include "mygl/glstate.h"
+#include "mygl/renderqueue.h"
+#include "core/bvh.h"
+#include "fleet.h"
+#include "options.h"
+
+#include <vector>
+
+/* camera and input state at a point of the benchmark path */
+struct BenchmarkKeyframe
+{
+    float time = 0.0f;
+    Vector3D position;
+    Vector3D lookAt;
+    std::string keys;       // pressed keys, any of "wasd12" (boat rotation, camera mode)
+};
+
+struct Benchmark
+{
+    std::vector<BenchmarkKeyframe> path;
+
+    /* one entry per measured frame */
+    std::vector<double> frameMs;
+    std::vector<double> cpuMs;
+    std::vector<double> gpuMs;
+    std::vector<double> resolutionScale;        // empty without dynamic resolution
+
+    /* totals over all measured frames */
+    unsigned long long draws = 0;
+    unsigned long long programChanges = 0;
+    unsigned long long vaoChanges = 0;
+    unsigned long long textureChanges = 0;
+    unsigned long long uniformChanges = 0;
+    unsigned long long glCallsIssued = 0;
+    unsigned long long glCallsElided = 0;
+};
+
+/**
+ * @brief Built-in benchmark path: one orbit around the boat while it is rotated, with a switch to the third person
+ * camera and back.
+ */
+std::vector<BenchmarkKeyframe> benchmarkPathDefault();
+
+/**
+ * @brief Load a benchmark path. One keyframe per line: time, camera position (x y z), look at point (x y z) and
+ * optionally the pressed keys ("-" for none). Keyframes have to be sorted by time, lines starting with # are ignored.
+ *
+ * @param filepath Path to the keyframe file.
+ *
+ * @return Keyframes of the path.
+ *
+ * usage:
+ *
+ *   # time  position     lookAt   keys
+ *   0.0     10 14 10     0 4 0    -
+ *   2.5     -10 14 10    0 4 0    wa
+ *
+ */
+std::vector<BenchmarkKeyframe> benchmarkPathLoad(const std::string& filepath);
+
+/**
+ * @brief Sample the path at a point in time. Camera position and look at point are interpolated linearly, keys are
+ * taken from the last keyframe at or before the time. The path repeats after its last keyframe.
+ *
+ * @param path Keyframes of the path.
+ * @param time Time since the start of the benchmark in seconds.
+ */
+BenchmarkKeyframe benchmarkPathSample(const std::vector<BenchmarkKeyframe>& path, float time);
+
+/**
+ * @brief Add one measured frame.
+ *
+ * @param bench Benchmark to add the frame to.
+ * @param frameMs Wall time of the whole frame.
+ * @param cpuMs Time the CPU spent on update and draw submission.
+ * @param renderStats Render queue statistics of the frame.
+ * @param stateStats GL state cache statistics of the frame.
+ */
+void benchmarkRecord(Benchmark& bench, double frameMs, double cpuMs, const RenderStats& renderStats, const GLStateStats& stateStats);
+
+/**
+ * @brief Write avg/p50/p95/p99/max of frame, CPU and GPU times and the average draw counts per frame as JSON.
+ *
+ * @param bench Measured benchmark.
+ * @param options Options of the run, the scene parameters are part of the report.
+ * @param filepath Output file, the report is printed to stdout if empty.
+ *
+ * @return False if the file couldn't be written.
+ */
+bool benchmarkWriteReport(const Benchmark& bench, const Options& options, const std::string& filepath);
+
+/**
+ * @brief Micro-benchmarks of the job system: cost of spawning and waiting for empty jobs and the scaling of a compute
+ * bound parallelFor from 0 workers (inline) up to the given worker count. Results are printed to stdout.
+ *
+ * @param workers Largest worker count to measure, -1 for one per additional hardware thread.
+ */
+void benchmarkJobs(int workers);
+
+/**
+ * @brief Per frame cost of the fleet as a function of its size: fleets of 1000, 2000, 4000, ... boats up to maxCount
+ * are updated, culled, uploaded and drawn for a number of frames each. Prints one row per size with the average
+ * milliseconds of every stage and the cost per boat. The frame uniforms have to be set by the caller.
+ *
+ * @param mesh Mesh of the boat parts.
+ * @param parts Parts of the boat model.
+ * @param program Program compiled with INSTANCED.
+ * @param view View matrix of the camera.
+ * @param frustum Normalized planes of the culling frustum.
+ * @param maxCount Largest fleet.
+ * @param frames Measured frames per size, after a warmup of 10 frames.
+ */
+void benchmarkFleet(const Mesh& mesh, const std::vector<FleetPart>& parts, const ShaderProgram* program,
+                    const Matrix4D& view, const Vector4D frustum[6], int maxCount, int frames);
+
+/**
+ * @brief Benchmarks the bounding volume hierarchy with 10k, 100k and 1M random boxes spread over the water: build,
+ * refit after every box moved and frustum, box, sphere and ray queries, each compared to a linear scan over all boxes
+ * (which also checks the results). Results are printed to stdout.
+ */
+void benchmarkBvh();
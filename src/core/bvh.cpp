@@ -0,0 +1,481 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <functional>
+
+namespace detail
+{
+const int kBvhBins = 16;
+const uint32_t kBvhMinSplit = 3;        // nodes with fewer items always become leaves
+const uint32_t kBvhMaxLeaf = 8;         // larger nodes are split even if the SAH prefers a leaf
+const int kBvhMaxDepth = 48;            // keeps the traversal stacks of 64 entries sufficient
+
+Bounds bvhEmpty()
+{
+    return {{FLT_MAX, FLT_MAX, FLT_MAX}, {-FLT_MAX, -FLT_MAX, -FLT_MAX}};
+}
+
+void bvhGrow(Bounds& bounds, const Bounds& other)
+{
+    bounds.min.x = std::min(bounds.min.x, other.min.x);
+    bounds.min.y = std::min(bounds.min.y, other.min.y);
+    bounds.min.z = std::min(bounds.min.z, other.min.z);
+    bounds.max.x = std::max(bounds.max.x, other.max.x);
+    bounds.max.y = std::max(bounds.max.y, other.max.y);
+    bounds.max.z = std::max(bounds.max.z, other.max.z);
+}
+
+void bvhGrow(Bounds& bounds, const Vector3D& point)
+{
+    bvhGrow(bounds, Bounds{point, point});
+}
+
+/* half the surface area, enough for the ratios of the SAH */
+float bvhArea(const Bounds& bounds)
+{
+    Vector3D size = bounds.max - bounds.min;
+    return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+Vector3D bvhCenter(const Bounds& bounds)
+{
+    return (bounds.min + bounds.max) * 0.5f;
+}
+
+/* bounds of the items and of their centers */
+void bvhNodeBounds(const Bvh& bvh, const std::vector<Bounds>& bounds, const std::vector<Vector3D>& centers,
+                   uint32_t first, uint32_t count, Bounds& nodeBounds, Bounds& centerBounds)
+{
+    nodeBounds = bvhEmpty();
+    centerBounds = bvhEmpty();
+    for(uint32_t i = first; i < first + count; i++)
+    {
+        bvhGrow(nodeBounds, bounds[bvh.items[i]]);
+        bvhGrow(centerBounds, centers[bvh.items[i]]);
+    }
+}
+
+/* best binned SAH split of a node, returns false if a leaf is cheaper or no split separates the items */
+bool bvhFindSplit(const Bvh& bvh, const std::vector<Bounds>& bounds, const std::vector<Vector3D>& centers,
+                  const BvhNode& node, const Bounds& centerBounds, int& bestAxis, float& bestPosition)
+{
+    float bestCost = FLT_MAX;
+    for(int axis = 0; axis < 3; axis++)
+    {
+        float low = centerBounds.min[axis];
+        float extent = centerBounds.max[axis] - low;
+        if(extent <= 0.0f)
+            continue;
+
+        Bounds binBounds[kBvhBins];
+        uint32_t binCount[kBvhBins] = {};
+        std::fill(binBounds, binBounds + kBvhBins, bvhEmpty());
+        float scale = kBvhBins / extent;
+        for(uint32_t i = node.first; i < node.first + node.count; i++)
+        {
+            uint32_t item = bvh.items[i];
+            int bin = std::min(int((centers[item][axis] - low) * scale), kBvhBins - 1);
+            binCount[bin]++;
+            bvhGrow(binBounds[bin], bounds[item]);
+        }
+
+        /* sweep from the right, then evaluate every plane between bins from the left */
+        float rightArea[kBvhBins];
+        uint32_t rightCount[kBvhBins];
+        Bounds right = bvhEmpty();
+        uint32_t count = 0;
+        for(int bin = kBvhBins - 1; bin > 0; bin--)
+        {
+            bvhGrow(right, binBounds[bin]);
+            count += binCount[bin];
+            rightArea[bin] = count > 0 ? bvhArea(right) : 0.0f;
+            rightCount[bin] = count;
+        }
+        Bounds left = bvhEmpty();
+        count = 0;
+        for(int bin = 0; bin < kBvhBins - 1; bin++)
+        {
+            bvhGrow(left, binBounds[bin]);
+            count += binCount[bin];
+            if(count == 0 || rightCount[bin + 1] == 0)
+                continue;
+            float cost = bvhArea(left) * count + rightArea[bin + 1] * rightCount[bin + 1];
+            if(cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestPosition = low + (bin + 1) / scale;
+            }
+        }
+    }
+
+    if(bestCost == FLT_MAX)
+        return false;
+
+    /* traversing a node costs about as much as testing one item */
+    float area = bvhArea(node.bounds);
+    return node.count > kBvhMaxLeaf || area + bestCost < area * node.count;
+}
+
+void bvhCopyItemBounds(Bvh& bvh, const std::vector<Bounds>& bounds)
+{
+    bvh.itemBounds.resize(bvh.items.size());
+    for(size_t i = 0; i < bvh.items.size(); i++)
+    {
+        bvh.itemBounds[i] = bounds[bvh.items[i]];
+    }
+}
+
+/* box of a leaf from its items, of an inner node from its children */
+void bvhRefitNode(Bvh& bvh, BvhNode& node)
+{
+    node.bounds = bvhEmpty();
+    if(node.count > 0)
+    {
+        for(uint32_t i = node.first; i < node.first + node.count; i++)
+            bvhGrow(node.bounds, bvh.itemBounds[i]);
+    }
+    else
+    {
+        bvhGrow(node.bounds, bvh.nodes[node.first].bounds);
+        bvhGrow(node.bounds, bvh.nodes[node.first + 1].bounds);
+    }
+}
+
+/* children are stored after their parent, so a reverse pass sees the children first */
+void bvhRefitNodes(Bvh& bvh)
+{
+    for(size_t n = bvh.nodes.size(); n-- > 0;)
+        bvhRefitNode(bvh, bvh.nodes[n]);
+}
+
+/* SAH term of a node before the division by the area of the root */
+double bvhNodeCost(const BvhNode& node)
+{
+    return double(bvhArea(node.bounds)) * (node.count > 0 ? node.count : 1);
+}
+
+double bvhCostSum(const Bvh& bvh)
+{
+    double cost = 0.0;
+    for(const BvhNode& node : bvh.nodes)
+        cost += bvhNodeCost(node);
+    return cost;
+}
+
+/* parent of every node and leaf of every object, for refits of single objects */
+void bvhLinkNodes(Bvh& bvh)
+{
+    bvh.parents.assign(bvh.nodes.size(), 0);
+    bvh.leaves.resize(bvh.items.size());
+    for(uint32_t n = 0; n < bvh.nodes.size(); n++)
+    {
+        const BvhNode& node = bvh.nodes[n];
+        if(node.count > 0)
+        {
+            for(uint32_t i = node.first; i < node.first + node.count; i++)
+                bvh.leaves[bvh.items[i]] = n;
+        }
+        else
+        {
+            bvh.parents[node.first] = n;
+            bvh.parents[node.first + 1] = n;
+        }
+    }
+}
+
+/* cost of the refitted tree, rebuilds it once it degraded too much */
+bool bvhCheckCost(Bvh& bvh, const std::vector<Bounds>& bounds)
+{
+    bvh.cost = float(bvh.costSum / std::max(double(bvhArea(bvh.nodes[0].bounds)), double(FLT_MIN)));
+    if(bvh.cost > bvh.buildCost * bvh.rebuildRatio)
+    {
+        bvhBuild(bvh, bounds);
+        return true;
+    }
+    return false;
+}
+
+/* depth first traversal: testNode(bounds) returns 0 to skip a subtree, 2 to take it whole without further tests */
+template <typename TestNode, typename TestItem>
+void bvhTraverse(const Bvh& bvh, std::vector<uint32_t>& items, const TestNode& testNode, const TestItem& testItem)
+{
+    if(bvh.nodes.empty())
+        return;
+
+    struct Entry { uint32_t node; bool inside; };
+    Entry stack[64];
+    int size = 0;
+    stack[size++] = {0, false};
+    while(size > 0)
+    {
+        Entry entry = stack[--size];
+        const BvhNode& node = bvh.nodes[entry.node];
+        bool inside = entry.inside;
+        if(!inside)
+        {
+            int result = testNode(node.bounds);
+            if(result == 0)
+                continue;
+            inside = result == 2;
+        }
+
+        if(node.count > 0)
+        {
+            for(uint32_t i = node.first; i < node.first + node.count; i++)
+            {
+                if(inside || testItem(bvh.itemBounds[i]))
+                    items.push_back(bvh.items[i]);
+            }
+        }
+        else
+        {
+            stack[size++] = {node.first + 1, inside};
+            stack[size++] = {node.first, inside};
+        }
+    }
+}
+}
+
+void bvhBuild(Bvh& bvh, const std::vector<Bounds>& bounds)
+{
+    uint32_t count = uint32_t(bounds.size());
+    bvh.nodes.clear();
+    bvh.items.resize(count);
+    for(uint32_t i = 0; i < count; i++)
+        bvh.items[i] = i;
+    bvh.builds++;
+    if(count == 0)
+    {
+        bvh.itemBounds.clear();
+        bvh.parents.clear();
+        bvh.leaves.clear();
+        bvh.buildCost = bvh.cost = 0.0f;
+        bvh.costSum = 0.0;
+        return;
+    }
+
+    std::vector<Vector3D> centers(count);
+    for(uint32_t i = 0; i < count; i++)
+        centers[i] = detail::bvhCenter(bounds[i]);
+
+    /* at most 2 * count - 1 nodes, reserved so references stay valid */
+    bvh.nodes.reserve(2 * size_t(count));
+    bvh.nodes.push_back({{}, 0, count});
+
+    struct Task { uint32_t node; int depth; };
+    std::vector<Task> tasks = {{0, 0}};
+    while(!tasks.empty())
+    {
+        Task task = tasks.back();
+        tasks.pop_back();
+
+        BvhNode& node = bvh.nodes[task.node];
+        Bounds centerBounds;
+        detail::bvhNodeBounds(bvh, bounds, centers, node.first, node.count, node.bounds, centerBounds);
+        if(node.count < detail::kBvhMinSplit || task.depth >= detail::kBvhMaxDepth)
+            continue;
+
+        uint32_t* begin = bvh.items.data() + node.first;
+        uint32_t* end = begin + node.count;
+        uint32_t* middle = nullptr;
+        int axis = 0;
+        float position = 0.0f;
+        if(detail::bvhFindSplit(bvh, bounds, centers, node, centerBounds, axis, position))
+        {
+            middle = std::partition(begin, end, [&](uint32_t item) { return centers[item][axis] < position; });
+        }
+        if(middle == nullptr || middle == begin || middle == end)
+        {
+            /* all centers in one bin (or on one point) but too many items for a leaf: split at the median */
+            if(node.count <= detail::kBvhMaxLeaf)
+                continue;
+            Vector3D extent = centerBounds.max - centerBounds.min;
+            axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+            middle = begin + node.count / 2;
+            std::nth_element(begin, middle, end, [&](uint32_t a, uint32_t b) { return centers[a][axis] < centers[b][axis]; });
+        }
+
+        uint32_t leftCount = uint32_t(middle - begin);
+        uint32_t left = uint32_t(bvh.nodes.size());
+        bvh.nodes.push_back({{}, node.first, leftCount});
+        bvh.nodes.push_back({{}, node.first + leftCount, node.count - leftCount});
+        BvhNode& parent = bvh.nodes[task.node];
+        parent.first = left;
+        parent.count = 0;
+        tasks.push_back({left + 1, task.depth + 1});
+        tasks.push_back({left, task.depth + 1});
+    }
+
+    detail::bvhCopyItemBounds(bvh, bounds);
+    detail::bvhLinkNodes(bvh);
+    bvh.costSum = detail::bvhCostSum(bvh);
+    bvh.buildCost = bvh.cost = bvhCost(bvh);
+}
+
+bool bvhRefit(Bvh& bvh, const std::vector<Bounds>& bounds)
+{
+    if(bounds.size() != bvh.items.size() || bvh.nodes.empty())
+    {
+        bvhBuild(bvh, bounds);
+        return true;
+    }
+
+    detail::bvhCopyItemBounds(bvh, bounds);
+    detail::bvhRefitNodes(bvh);
+    bvh.refits++;
+    bvh.costSum = detail::bvhCostSum(bvh);
+    return detail::bvhCheckCost(bvh, bounds);
+}
+
+bool bvhRefit(Bvh& bvh, const std::vector<Bounds>& bounds, const std::vector<uint32_t>& moved)
+{
+    if(bounds.size() != bvh.items.size() || bvh.nodes.empty())
+    {
+        bvhBuild(bvh, bounds);
+        return true;
+    }
+    if(moved.empty())
+        return false;
+
+    /* with most objects moved, one pass over all nodes is cheaper than collecting the paths */
+    if(moved.size() > bvh.items.size() / 4)
+        return bvhRefit(bvh, bounds);
+
+    /* leaves of the moved objects and all their ancestors, refitted children first (they have higher indices); the
+     * SAH sum is updated with the difference of every refitted node */
+    std::vector<uint32_t>& dirty = bvh.dirtyNodes;
+    std::vector<unsigned char>& marked = bvh.dirtyMarks;
+    marked.resize(bvh.nodes.size(), 0);
+    dirty.clear();
+    for(uint32_t object : moved)
+    {
+        for(uint32_t n = bvh.leaves[object]; !marked[n]; n = bvh.parents[n])
+        {
+            marked[n] = 1;
+            dirty.push_back(n);
+            if(n == 0)
+                break;
+        }
+    }
+    std::sort(dirty.begin(), dirty.end(), std::greater<uint32_t>());
+    for(uint32_t n : dirty)
+    {
+        BvhNode& node = bvh.nodes[n];
+        if(node.count > 0)
+        {
+            for(uint32_t i = node.first; i < node.first + node.count; i++)
+                bvh.itemBounds[i] = bounds[bvh.items[i]];
+        }
+        bvh.costSum -= detail::bvhNodeCost(node);
+        detail::bvhRefitNode(bvh, node);
+        bvh.costSum += detail::bvhNodeCost(node);
+        marked[n] = 0;
+    }
+    bvh.refits++;
+    return detail::bvhCheckCost(bvh, bounds);
+}
+
+float bvhCost(const Bvh& bvh)
+{
+    if(bvh.nodes.empty())
+        return 0.0f;
+
+    double rootArea = std::max(detail::bvhArea(bvh.nodes[0].bounds), FLT_MIN);
+    return float(detail::bvhCostSum(bvh) / rootArea);
+}
+
+void bvhQueryFrustum(const Bvh& bvh, const Vector4D frustum[6], std::vector<uint32_t>& items)
+{
+    detail::bvhTraverse(bvh, items, [&](const Bounds& box) { return frustumClassify(frustum, box); },
+                        [&](const Bounds& box) { return frustumClassify(frustum, box) != 0; });
+}
+
+void bvhQueryBounds(const Bvh& bvh, const Bounds& bounds, std::vector<uint32_t>& items)
+{
+    auto overlap = [&](const Bounds& box) { return boundsOverlap(box, bounds); };
+    detail::bvhTraverse(bvh, items, [&](const Bounds& box) { return overlap(box) ? 1 : 0; }, overlap);
+}
+
+void bvhQuerySphere(const Bvh& bvh, const Vector3D& center, float radius, std::vector<uint32_t>& items)
+{
+    auto overlap = [&](const Bounds& box) { return boundsOverlapSphere(box, center, radius); };
+    detail::bvhTraverse(bvh, items, [&](const Bounds& box) { return overlap(box) ? 1 : 0; }, overlap);
+}
+
+void bvhQueryRay(const Bvh& bvh, const Vector3D& origin, const Vector3D& direction, float maxDistance,
+                 std::vector<uint32_t>& items)
+{
+    Vector3D inverse(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+    auto hit = [&](const Bounds& box) { return boundsRay(box, origin, inverse, maxDistance) >= 0.0f; };
+    detail::bvhTraverse(bvh, items, [&](const Bounds& box) { return hit(box) ? 1 : 0; }, hit);
+}
+
+int frustumClassify(const Vector4D frustum[6], const Bounds& box)
+{
+    int result = 2;
+    for(int p = 0; p < 6; p++)
+    {
+        const Vector4D& plane = frustum[p];
+        /* corners farthest along and against the plane normal */
+        float farthest = plane.x * (plane.x > 0.0f ? box.max.x : box.min.x) + plane.y * (plane.y > 0.0f ? box.max.y : box.min.y)
+                         + plane.z * (plane.z > 0.0f ? box.max.z : box.min.z) + plane.w;
+        if(farthest < 0.0f)
+            return 0;
+        float nearest = plane.x * (plane.x > 0.0f ? box.min.x : box.max.x) + plane.y * (plane.y > 0.0f ? box.min.y : box.max.y)
+                        + plane.z * (plane.z > 0.0f ? box.min.z : box.max.z) + plane.w;
+        if(nearest < 0.0f)
+            result = 1;
+    }
+    return result;
+}
+
+Bounds boundsTransform(const Bounds& bounds, const Matrix4D& matrix)
+{
+    /* center transforms as a point, the half extent by the absolute values of the linear part */
+    Vector3D center = detail::bvhCenter(bounds);
+    Vector3D half = (bounds.max - bounds.min) * 0.5f;
+    Vector3D worldCenter = Vector3D(matrix * Vector4D(center, 1.0f));
+    Vector3D worldHalf;
+    for(int i = 0; i < 3; i++)
+    {
+        worldHalf[i] = std::fabs(matrix(i, 0)) * half.x + std::fabs(matrix(i, 1)) * half.y
+                       + std::fabs(matrix(i, 2)) * half.z;
+    }
+    return {worldCenter - worldHalf, worldCenter + worldHalf};
+}
+
+bool boundsOverlap(const Bounds& a, const Bounds& b)
+{
+    return a.min.x <= b.max.x && a.max.x >= b.min.x && a.min.y <= b.max.y && a.max.y >= b.min.y
+           && a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+bool boundsOverlapSphere(const Bounds& box, const Vector3D& center, float radius)
+{
+    float dx = std::max(std::max(box.min.x - center.x, center.x - box.max.x), 0.0f);
+    float dy = std::max(std::max(box.min.y - center.y, center.y - box.max.y), 0.0f);
+    float dz = std::max(std::max(box.min.z - center.z, center.z - box.max.z), 0.0f);
+    return dx * dx + dy * dy + dz * dz <= radius * radius;
+}
+
+float boundsRay(const Bounds& box, const Vector3D& origin, const Vector3D& inverseDirection, float maxDistance)
+{
+    float t0 = (box.min.x - origin.x) * inverseDirection.x;
+    float t1 = (box.max.x - origin.x) * inverseDirection.x;
+    float enter = std::min(t0, t1);
+    float exit = std::max(t0, t1);
+    t0 = (box.min.y - origin.y) * inverseDirection.y;
+    t1 = (box.max.y - origin.y) * inverseDirection.y;
+    enter = std::max(enter, std::min(t0, t1));
+    exit = std::min(exit, std::max(t0, t1));
+    t0 = (box.min.z - origin.z) * inverseDirection.z;
+    t1 = (box.max.z - origin.z) * inverseDirection.z;
+    enter = std::max(enter, std::min(t0, t1));
+    exit = std::min(exit, std::max(t0, t1));
+
+    enter = std::max(enter, 0.0f);
+    return enter <= exit && enter <= maxDistance ? enter : -1.0f;
+}
@@ -0,0 +1,234 @@
+#pragma once
+
+#include "core/entities.h"
+#include "math/matrix4d.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+struct BvhNode
+{
+    Bounds bounds;
+    uint32_t first = 0;     // leaf: first entry in Bvh::items, inner node: left child, the right child follows it
+    uint32_t count = 0;     // items of a leaf, 0 for inner nodes
+};
+
+/**
+ * Bounding volume hierarchy over axis aligned boxes, the spatial index of scene queries. It is built top-down with
+ * the surface area heuristic evaluated over 16 bins per axis and kept up to date by refitting the boxes bottom-up
+ * when objects move. Refitting keeps the tree topology, so its quality degrades as objects drift apart; the SAH cost
+ * is tracked and the tree is rebuilt once it exceeds the cost after the last build by the rebuild ratio.
+ *
+ * Children are always stored after their parent, so a reverse pass over the nodes refits the whole tree, and the item
+ * boxes are copied in leaf order so traversal touches contiguous memory. When only a few objects moved, just their
+ * leaves and the ancestors of those are refitted, and the SAH cost is updated with the difference of every refitted
+ * node instead of summing over the whole tree.
+ */
+struct Bvh
+{
+    std::vector<BvhNode> nodes;         // nodes[0] is the root
+    std::vector<uint32_t> items;        // indices of the objects in leaf order
+    std::vector<Bounds> itemBounds;     // boxes of the objects in leaf order
+    std::vector<uint32_t> parents;      // parent of every node, 0 for the root
+    std::vector<uint32_t> leaves;       // leaf of every object
+
+    float rebuildRatio = 1.3f;
+    float buildCost = 0.0f;             // SAH cost after the last build
+    float cost = 0.0f;                  // SAH cost after the last refit
+    double costSum = 0.0;               // cost times the area of the root, updated per refitted node
+
+    /* scratch of the partial refit */
+    std::vector<uint32_t> dirtyNodes;
+    std::vector<unsigned char> dirtyMarks;
+
+    /* statistics */
+    uint64_t builds = 0;
+    uint64_t refits = 0;
+};
+
+/**
+ * @brief Classifies a box against a frustum.
+ *
+ * @param frustum Planes of the frustum, a point p is inside if dot(plane.xyz, p) + plane.w >= 0 for all of them (see
+ * CameraMatrices::frustum).
+ * @param box Box to classify.
+ *
+ * @return 0 if the box is outside, 1 if it intersects the frustum and 2 if it is fully inside.
+ */
+int frustumClassify(const Vector4D frustum[6], const Bounds& box);
+
+/**
+ * @brief Box around a box transformed by a matrix.
+ */
+Bounds boundsTransform(const Bounds& bounds, const Matrix4D& matrix);
+
+/**
+ * @brief Checks whether two boxes intersect, touching counts as intersecting.
+ */
+bool boundsOverlap(const Bounds& a, const Bounds& b);
+
+/**
+ * @brief Checks whether a box intersects a sphere.
+ */
+bool boundsOverlapSphere(const Bounds& box, const Vector3D& center, float radius);
+
+/**
+ * @brief Distance along a ray at which it enters a box (slab test), 0 if it starts inside.
+ *
+ * @param box Box to test.
+ * @param origin Start of the ray.
+ * @param inverseDirection Component-wise inverse of the ray direction.
+ * @param maxDistance End of the segment in multiples of the direction.
+ *
+ * @return Entry distance, negative if the segment misses the box.
+ */
+float boundsRay(const Bounds& box, const Vector3D& origin, const Vector3D& inverseDirection, float maxDistance);
+
+/**
+ * @brief Builds the hierarchy from scratch.
+ *
+ * @param bvh Hierarchy to build.
+ * @param bounds World space box of every object, the index of a box is the item returned by the queries.
+ *
+ * usage:
+ *
+ *   Bvh bvh;
+ *   bvhBuild(bvh, worldBounds);
+ *   ...                                    // objects move, worldBounds updated
+ *   bvhRefit(bvh, worldBounds);            // same objects, rebuilds if the tree degraded
+ *   bvhRefit(bvh, worldBounds, moved);     // only the boxes of the objects in moved changed
+ *
+ *   std::vector<uint32_t> visible;
+ *   bvhQueryFrustum(bvh, cameraMatrices(camera).frustum, visible);
+ *
+ */
+void bvhBuild(Bvh& bvh, const std::vector<Bounds>& bounds);
+
+/**
+ * @brief Updates the boxes of all nodes for moved objects and rebuilds the hierarchy once refitting made it too slow
+ * to query. The number of objects has to be the same as in the last build.
+ *
+ * @param bvh Hierarchy to update.
+ * @param bounds World space box of every object.
+ *
+ * @return True if the hierarchy was rebuilt.
+ */
+bool bvhRefit(Bvh& bvh, const std::vector<Bounds>& bounds);
+
+/**
+ * @brief Updates the boxes for a few moved objects: only their leaves and the ancestors of those are refitted. Does
+ * nothing if no object moved, falls back to the full refit when many of them did.
+ *
+ * @param bvh Hierarchy to update.
+ * @param bounds World space box of every object, only the ones of the moved objects are read unless it rebuilds.
+ * @param moved Indices of the objects whose box changed since the last refit or build.
+ *
+ * @return True if the hierarchy was rebuilt.
+ */
+bool bvhRefit(Bvh& bvh, const std::vector<Bounds>& bounds, const std::vector<uint32_t>& moved);
+
+/**
+ * @brief Surface area heuristic cost of the current tree: expected number of node and item tests of a random ray.
+ */
+float bvhCost(const Bvh& bvh);
+
+/**
+ * @brief Collects all objects whose box intersects the view frustum. Boxes fully inside skip the tests of their subtree.
+ *
+ * @param bvh Hierarchy.
+ * @param frustum Planes of the frustum (see frustumClassify).
+ * @param items Indices of the objects, appended.
+ */
+void bvhQueryFrustum(const Bvh& bvh, const Vector4D frustum[6], std::vector<uint32_t>& items);
+
+/**
+ * @brief Collects all objects whose box intersects a box.
+ */
+void bvhQueryBounds(const Bvh& bvh, const Bounds& bounds, std::vector<uint32_t>& items);
+
+/**
+ * @brief Collects all objects whose box intersects a sphere.
+ */
+void bvhQuerySphere(const Bvh& bvh, const Vector3D& center, float radius, std::vector<uint32_t>& items);
+
+/**
+ * @brief Collects all objects whose box is hit by a ray segment, in no particular order.
+ *
+ * @param bvh Hierarchy.
+ * @param origin Start of the ray.
+ * @param direction Direction of the ray, not necessarily normalized.
+ * @param maxDistance End of the segment in multiples of direction.
+ * @param items Indices of the objects, appended.
+ */
+void bvhQueryRay(const Bvh& bvh, const Vector3D& origin, const Vector3D& direction, float maxDistance,
+                 std::vector<uint32_t>& items);
+
+
+/**
+ * @brief Closest hit along a ray. Nodes are visited front to back and skipped once they are farther than the closest
+ * hit so far, objects whose box is hit are tested exactly by the callback.
+ *
+ * @param bvh Hierarchy.
+ * @param origin Start of the ray.
+ * @param direction Direction of the ray, not necessarily normalized.
+ * @param maxDistance End of the segment in multiples of direction, the distance of the closest hit on return.
+ * @param intersect Callable float(uint32_t item, float maxDistance) returning the distance of the hit with the object,
+ * negative if there is none.
+ *
+ * @return Index of the closest object, UINT32_MAX if nothing was hit.
+ */
+template <typename Intersect>
+uint32_t bvhRaycast(const Bvh& bvh, const Vector3D& origin, const Vector3D& direction, float& maxDistance,
+                    const Intersect& intersect)
+{
+    if(bvh.nodes.empty())
+        return UINT32_MAX;
+
+    Vector3D inverse(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+    uint32_t closest = UINT32_MAX;
+    struct Entry { uint32_t node; float distance; };
+    Entry stack[64];            // the build limits the depth, a depth first traversal never holds more entries
+    int size = 0;
+
+    float rootDistance = boundsRay(bvh.nodes[0].bounds, origin, inverse, maxDistance);
+    if(rootDistance >= 0.0f)
+        stack[size++] = {0, rootDistance};
+
+    while(size > 0)
+    {
+        Entry entry = stack[--size];
+        if(entry.distance > maxDistance)
+            continue;
+
+        const BvhNode& node = bvh.nodes[entry.node];
+        if(node.count > 0)
+        {
+            for(uint32_t i = node.first; i < node.first + node.count; i++)
+            {
+                if(boundsRay(bvh.itemBounds[i], origin, inverse, maxDistance) < 0.0f)
+                    continue;
+                float distance = intersect(bvh.items[i], maxDistance);
+                if(distance >= 0.0f && distance <= maxDistance)
+                {
+                    maxDistance = distance;
+                    closest = bvh.items[i];
+                }
+            }
+            continue;
+        }
+
+        /* push the farther child first, so the nearer one is visited next */
+        float left = boundsRay(bvh.nodes[node.first].bounds, origin, inverse, maxDistance);
+        float right = boundsRay(bvh.nodes[node.first + 1].bounds, origin, inverse, maxDistance);
+        Entry first = {node.first, left};
+        Entry second = {node.first + 1, right};
+        if(right >= 0.0f && (left < 0.0f || right < left))
+            std::swap(first, second);
+        if(second.distance >= 0.0f)
+            stack[size++] = second;
+        if(first.distance >= 0.0f)
+            stack[size++] = first;
+    }
+    return closest;
+}
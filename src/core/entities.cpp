@@ -0,0 +1,137 @@
+#include "entities.h"
+#include "transform.h"
+
+#include <cassert>
+
+void entityReserve(EntityStore& store, std::size_t count)
+{
+    store.entity.reserve(count);
+    store.transform.reserve(count);
+    store.mesh.reserve(count);
+    store.color.reserve(count);
+    store.bounds.reserve(count);
+    store.velocity.reserve(count);
+    store.texture.reserve(count);
+    store.slot.reserve(count);
+    store.generation.reserve(count);
+}
+
+Entity entityCreate(EntityStore& store, int transform, int mesh, const Vector4D& color, const Bounds& bounds, const Vector3D& velocity, int texture)
+{
+    Entity entity;
+    if(!store.freeIndices.empty())
+    {
+        entity.index = store.freeIndices.back();
+        store.freeIndices.pop_back();
+    }
+    else
+    {
+        entity.index = static_cast<uint32_t>(store.slot.size());
+        store.slot.push_back(0);
+        store.generation.push_back(0);
+    }
+    entity.generation = store.generation[entity.index];
+    store.slot[entity.index] = static_cast<uint32_t>(store.entity.size());
+
+    store.entity.push_back(entity);
+    store.transform.push_back(transform);
+    store.mesh.push_back(mesh);
+    store.color.push_back(color);
+    store.bounds.push_back(bounds);
+    store.velocity.push_back(velocity);
+    store.texture.push_back(texture);
+
+    return entity;
+}
+
+void entityAppend(EntityStore& store, std::size_t count, const int* transform, const int* mesh, const Vector4D* color,
+                  const Bounds* bounds, const int* texture)
+{
+    /* new handles only, free indices of destroyed entities are left to entityCreate */
+    uint32_t firstIndex = static_cast<uint32_t>(store.slot.size());
+    uint32_t firstSlot = static_cast<uint32_t>(store.entity.size());
+    store.slot.resize(firstIndex + count);
+    store.generation.resize(firstIndex + count, 0);
+    store.entity.resize(firstSlot + count);
+    for(std::size_t i = 0; i < count; i++)
+    {
+        store.slot[firstIndex + i] = firstSlot + static_cast<uint32_t>(i);
+        store.entity[firstSlot + i] = {firstIndex + static_cast<uint32_t>(i), 0};
+    }
+
+    store.transform.insert(store.transform.end(), transform, transform + count);
+    store.mesh.insert(store.mesh.end(), mesh, mesh + count);
+    store.color.insert(store.color.end(), color, color + count);
+    store.bounds.insert(store.bounds.end(), bounds, bounds + count);
+    store.velocity.resize(store.velocity.size() + count, Vector3D(0.0f, 0.0f, 0.0f));
+    if(texture)
+        store.texture.insert(store.texture.end(), texture, texture + count);
+    else
+        store.texture.resize(store.texture.size() + count, -1);
+}
+
+void entityDestroy(EntityStore& store, Entity entity)
+{
+    if(!entityAlive(store, entity))
+    {
+        return;
+    }
+
+    uint32_t removed = store.slot[entity.index];
+    uint32_t last = static_cast<uint32_t>(store.entity.size() - 1);
+
+    /* move the last entity into the freed slot to keep the arrays packed */
+    if(removed != last)
+    {
+        store.entity[removed] = store.entity[last];
+        store.transform[removed] = store.transform[last];
+        store.mesh[removed] = store.mesh[last];
+        store.color[removed] = store.color[last];
+        store.bounds[removed] = store.bounds[last];
+        store.velocity[removed] = store.velocity[last];
+        store.texture[removed] = store.texture[last];
+        store.slot[store.entity[removed].index] = removed;
+    }
+
+    store.entity.pop_back();
+    store.transform.pop_back();
+    store.mesh.pop_back();
+    store.color.pop_back();
+    store.bounds.pop_back();
+    store.velocity.pop_back();
+    store.texture.pop_back();
+
+    store.generation[entity.index]++;
+    store.freeIndices.push_back(entity.index);
+}
+
+bool entityAlive(const EntityStore& store, Entity entity)
+{
+    return entity.index < store.generation.size() && store.generation[entity.index] == entity.generation;
+}
+
+std::size_t entitySlot(const EntityStore& store, Entity entity)
+{
+    assert(entityAlive(store, entity));
+    return store.slot[entity.index];
+}
+
+std::size_t entityCount(const EntityStore& store)
+{
+    return store.entity.size();
+}
+
+void entityIntegrate(EntityStore& store, TransformGraph& graph, float dt)
+{
+    std::size_t count = store.entity.size();
+    for(std::size_t i = 0; i < count; i++)
+    {
+        const Vector3D& v = store.velocity[i];
+        if(v.x == 0.0f && v.y == 0.0f && v.z == 0.0f)
+        {
+            continue;
+        }
+        int node = store.transform[i];
+        transformSetTranslation(graph, node, graph.translation[node] + v * dt);
+    }
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "math/vector3d.h"
+#include "math/vector4d.h"
+
+#include <cstdint>
+#include <vector>
+
+struct TransformGraph;
+
+/* stable entity handle, the generation detects handles of destroyed entities */
+struct Entity
+{
+    uint32_t index = UINT32_MAX;
+    uint32_t generation = 0;
+};
+
+/* axis aligned bounding box in the local space of an entity */
+struct Bounds
+{
+    Vector3D min;
+    Vector3D max;
+};
+
+/**
+ * Entity storage with one dense array per component (structure of arrays). Alive entities are packed at the front of
+ * every array, so systems iterate linearly over [0, entityCount) without holes; destroying an entity moves the last
+ * one into its slot. Handles stay valid because they go through a sparse index table.
+ */
+struct EntityStore
+{
+    /* dense component arrays, element i of every array belongs to the same entity */
+    std::vector<Entity> entity;
+    std::vector<int> transform;             // node in the TransformGraph of the scene
+    std::vector<int> mesh;                  // index into the mesh table of the scene
+    std::vector<Vector4D> color;
+    std::vector<Bounds> bounds;
+    std::vector<Vector3D> velocity;         // world units per second, applied to the translation of the node
+    std::vector<int> texture;               // index into the texture table of the scene, -1 for none
+
+    /* sparse handle table */
+    std::vector<uint32_t> slot;             // handle index -> dense slot
+    std::vector<uint32_t> generation;       // current generation per handle index
+    std::vector<uint32_t> freeIndices;
+};
+
+/**
+ * @brief Reserves memory for a number of entities so spawning them doesn't reallocate.
+ *
+ * @param store Entity store.
+ * @param count Total number of entities expected.
+ */
+void entityReserve(EntityStore& store, std::size_t count);
+
+/**
+ * @brief Creates an entity with all components.
+ *
+ * @param store Entity store.
+ * @param transform Node in the transform graph that positions the entity.
+ * @param mesh Index of the mesh in the mesh table of the scene.
+ * @param color Color the mesh is tinted with.
+ * @param bounds Local space bounds of the mesh.
+ * @param velocity Linear velocity.
+ * @param texture Index of the texture in the texture table of the scene, -1 for none.
+ *
+ * @return Handle of the new entity.
+ */
+Entity entityCreate(EntityStore& store, int transform, int mesh, const Vector4D& color, const Bounds& bounds,
+                    const Vector3D& velocity = {0.0f, 0.0f, 0.0f}, int texture = -1);
+
+/**
+ * @brief Creates many entities at once, e.g. from a loaded scene, with one copy per component array. The velocity of
+ * the new entities is zero.
+ *
+ * @param store Entity store.
+ * @param count Number of entities.
+ * @param transform Node of every entity.
+ * @param mesh Mesh of every entity.
+ * @param color Color of every entity.
+ * @param bounds Local space bounds of every entity.
+ * @param texture Texture of every entity, nullptr if none has one.
+ */
+void entityAppend(EntityStore& store, std::size_t count, const int* transform, const int* mesh, const Vector4D* color,
+                  const Bounds* bounds, const int* texture = nullptr);
+
+/**
+ * @brief Destroys an entity, the last entity is moved into its slot. Its transform node stays in the graph.
+ *
+ * @param store Entity store.
+ * @param entity Handle of the entity.
+ */
+void entityDestroy(EntityStore& store, Entity entity);
+
+/**
+ * @brief Checks whether a handle refers to an existing entity.
+ */
+bool entityAlive(const EntityStore& store, Entity entity);
+
+/**
+ * @brief Returns the dense slot of an entity, i.e. the index into the component arrays.
+ */
+std::size_t entitySlot(const EntityStore& store, Entity entity);
+
+/**
+ * @brief Number of alive entities.
+ */
+std::size_t entityCount(const EntityStore& store);
+
+/**
+ * @brief Moves all entities with a non-zero velocity by velocity * dt.
+ *
+ * @param store Entity store.
+ * @param graph Transform graph the transform components refer to.
+ * @param dt Time step in seconds.
+ */
+void entityIntegrate(EntityStore& store, TransformGraph& graph, float dt);
@@ -0,0 +1,442 @@
+#include "jobs.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace detail
+{
+/* jobs in flight per thread, bounded by the job storage and the deque; jobs beyond that run inline */
+const uint32_t kMaxJobs = 4096;
+/* threads that aren't workers but push jobs (main thread and e.g. the simulation thread) */
+const uint32_t kExternalThreads = 8;
+
+/* storage of a queued job, busy until the executing thread copied the job out */
+struct JobSlot
+{
+    Job job;
+    std::atomic<bool> busy{false};
+};
+
+/* Chase-Lev work-stealing deque of fixed capacity (Le et al., "Correct and Efficient Work-Stealing for Weak Memory
+ * Models", 2013). The owner pushes/pops at the bottom, thieves steal at the top. */
+struct WorkDeque
+{
+    alignas(64) std::atomic<int64_t> top{0};
+    alignas(64) std::atomic<int64_t> bottom{0};
+    alignas(64) std::atomic<JobSlot*> buffer[kMaxJobs];
+
+    bool push(JobSlot* job)
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        if(b - t >= int64_t(kMaxJobs))
+            return false;
+
+        /* release publishes the job to thieves that acquire bottom */
+        buffer[b & (kMaxJobs - 1)].store(job, std::memory_order_relaxed);
+        bottom.store(b + 1, std::memory_order_release);
+        return true;
+    }
+
+    JobSlot* pop()
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+
+        if(t > b)
+        {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        JobSlot* job = buffer[b & (kMaxJobs - 1)].load(std::memory_order_relaxed);
+        if(t == b)
+        {
+            /* last job, race against thieves */
+            if(!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                job = nullptr;
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return job;
+    }
+
+    JobSlot* steal()
+    {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if(t >= b)
+            return nullptr;
+
+        JobSlot* job = buffer[t & (kMaxJobs - 1)].load(std::memory_order_relaxed);
+        if(!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return nullptr;
+        return job;
+    }
+};
+
+/* per thread state, only the owner allocates job slots */
+struct alignas(64) Worker
+{
+    WorkDeque deque;
+    JobSlot jobs[kMaxJobs];
+    uint32_t nextJob = 0;
+    uint32_t random = 0;
+};
+
+std::unique_ptr<Worker[]> workers;
+uint32_t workerCount = 0;
+uint32_t slotCount = 0;
+std::atomic<uint32_t> activeSlots{0};     // slots [0, activeSlots) own a deque that may hold jobs
+std::vector<std::thread> threads;
+std::atomic<uint32_t> generation{0};
+
+/* idle workers sleep until a job is pushed, only touched when a worker runs out of work */
+std::atomic<bool> quit{false};
+std::atomic<uint64_t> wakeEpoch{0};
+std::atomic<uint32_t> sleeping{0};
+std::mutex sleepMutex;
+std::condition_variable wake;
+
+struct ThreadSlot
+{
+    uint32_t generation = UINT32_MAX;
+    uint32_t slot = 0;
+};
+thread_local ThreadSlot threadSlot;
+
+/* slot of the calling thread, threads outside the pool claim one of the external slots on first use */
+Worker* localWorker()
+{
+    uint32_t current = generation.load(std::memory_order_acquire);
+    if(threadSlot.generation != current)
+    {
+        uint32_t slot = activeSlots.fetch_add(1, std::memory_order_acq_rel);
+        if(slot >= slotCount)
+        {
+            activeSlots.fetch_sub(1, std::memory_order_acq_rel);
+            return nullptr;
+        }
+        threadSlot = {current, slot};
+    }
+    return &workers[threadSlot.slot];
+}
+
+/* next free slot, normally the first one tried; a job still sitting at the top of the deque keeps its slot */
+JobSlot* allocate(Worker& worker)
+{
+    for(uint32_t i = 0; i < kMaxJobs; i++)
+    {
+        JobSlot& slot = worker.jobs[worker.nextJob++ & (kMaxJobs - 1)];
+        if(!slot.busy.load(std::memory_order_acquire))
+        {
+            slot.busy.store(true, std::memory_order_relaxed);
+            return &slot;
+        }
+    }
+    return nullptr;
+}
+
+uint32_t nextRandom(Worker& worker)
+{
+    /* xorshift32 */
+    uint32_t x = worker.random;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    worker.random = x;
+    return x;
+}
+
+void finish(JobCounter* counter);
+
+void execute(const Job& job)
+{
+    job.execute(job);
+    finish(job.counter);
+}
+
+/* copies the job out so the slot can be reused while the job runs */
+void execute(JobSlot* slot)
+{
+    Job job = slot->job;
+    slot->busy.store(false, std::memory_order_release);
+    execute(job);
+}
+
+void notify()
+{
+    wakeEpoch.fetch_add(1, std::memory_order_seq_cst);
+    if(sleeping.load(std::memory_order_seq_cst) > 0)
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        wake.notify_one();
+    }
+}
+
+/* pushes a copy of the job onto the deque of the calling thread, runs it inline if that's not possible */
+void submit(const Job& job)
+{
+    Worker* worker = workers ? localWorker() : nullptr;
+    JobSlot* slot = worker ? allocate(*worker) : nullptr;
+    if(slot != nullptr)
+    {
+        slot->job = job;
+        if(worker->deque.push(slot))
+        {
+            notify();
+            return;
+        }
+        slot->busy.store(false, std::memory_order_relaxed);
+    }
+
+    execute(job);
+}
+
+void lock(JobCounter& counter)
+{
+    while(counter.lock.test_and_set(std::memory_order_acquire))
+        std::this_thread::yield();
+}
+
+void unlock(JobCounter& counter)
+{
+    counter.lock.clear(std::memory_order_release);
+}
+
+void finish(JobCounter* counter)
+{
+    /* lock free unless this may be the last job of the group */
+    int pending = counter->pending.load(std::memory_order_relaxed);
+    while(pending > 1)
+    {
+        if(counter->pending.compare_exchange_weak(pending, pending - 1, std::memory_order_acq_rel))
+            return;
+    }
+
+    /* the counter only reaches zero under its lock, so jobRunAfter either queued its job before or sees zero, and
+     * jobWait doesn't return (and free the counter) before the lock is released */
+    std::vector<Job> continuations;
+    lock(*counter);
+    if(counter->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        continuations.swap(counter->continuations);
+    unlock(*counter);
+
+    for(const Job& job : continuations)
+        submit(job);
+}
+
+/* executes one job of the own deque or a stolen one, false if there was nothing to do */
+bool runOne(Worker* worker)
+{
+    JobSlot* job = worker ? worker->deque.pop() : nullptr;
+    if(job == nullptr)
+    {
+        uint32_t slots = std::min(activeSlots.load(std::memory_order_acquire), slotCount);
+        uint32_t start = worker ? nextRandom(*worker) : 0;
+        for(uint32_t i = 0; i < slots && job == nullptr; i++)
+        {
+            Worker& victim = workers[(start + i) % slots];
+            if(&victim != worker)
+                job = victim.deque.steal();
+        }
+    }
+    if(job == nullptr)
+        return false;
+
+    execute(job);
+    return true;
+}
+
+void workerLoop(uint32_t slot)
+{
+    threadSlot = {generation.load(std::memory_order_acquire), slot};
+    Worker* worker = &workers[slot];
+
+    uint32_t idle = 0;
+    while(!quit.load(std::memory_order_acquire))
+    {
+        uint64_t seen = wakeEpoch.load(std::memory_order_seq_cst);
+        if(runOne(worker))
+        {
+            idle = 0;
+            continue;
+        }
+
+        /* spin a little before sleeping, jobs often come in bursts */
+        if(++idle < 64)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleeping.fetch_add(1, std::memory_order_seq_cst);
+        wake.wait(lock, [&] { return quit.load() || wakeEpoch.load(std::memory_order_seq_cst) != seen; });
+        sleeping.fetch_sub(1, std::memory_order_seq_cst);
+        idle = 0;
+    }
+}
+
+void runTask(const Job& job)
+{
+    job.task(job.data);
+}
+
+struct ParallelFor
+{
+    void (*body)(void*, uint32_t, uint32_t);
+    void* data;
+    uint32_t grain;
+};
+
+/* keeps the left half, pushes the right half for thieves until the range is small enough */
+void runRange(const Job& job)
+{
+    const ParallelFor& loop = *static_cast<const ParallelFor*>(job.data);
+    uint32_t begin = job.begin;
+    uint32_t end = job.end;
+    while(end - begin > loop.grain)
+    {
+        uint32_t middle = begin + (end - begin) / 2;
+        Job half = job;
+        half.begin = middle;
+        half.end = end;
+        job.counter->pending.fetch_add(1, std::memory_order_relaxed);
+        submit(half);
+        end = middle;
+    }
+    loop.body(loop.data, begin, end);
+}
+
+void parallelForRun(uint32_t begin, uint32_t end, uint32_t grain, void (*body)(void*, uint32_t, uint32_t), void* data)
+{
+    ParallelFor loop = {body, data, grain};
+    JobCounter counter;
+    counter.pending.store(1, std::memory_order_relaxed);
+
+    Job root;
+    root.execute = runRange;
+    root.data = &loop;
+    root.begin = begin;
+    root.end = end;
+    root.counter = &counter;
+
+    /* the calling thread starts splitting right away instead of waiting for a worker to pick the job up */
+    execute(root);
+    jobWait(counter);
+}
+}
+
+void jobsInit(int workers)
+{
+    if(detail::workers)
+        jobsShutdown();
+
+    unsigned int hardware = std::max(std::thread::hardware_concurrency(), 1u);
+    detail::workerCount = workers < 0 ? hardware - 1 : workers;
+    if(detail::workerCount == 0)
+        return;
+
+    /* slot 0 is the calling thread, then the workers, then threads that join later */
+    detail::slotCount = 1 + detail::workerCount + detail::kExternalThreads;
+    detail::workers.reset(new detail::Worker[detail::slotCount]);
+    for(uint32_t i = 0; i < detail::slotCount; i++)
+        detail::workers[i].random = 0x9E3779B9u * (i + 1);
+
+    uint32_t current = detail::generation.fetch_add(1, std::memory_order_acq_rel) + 1;
+    detail::threadSlot = {current, 0};
+    detail::activeSlots.store(1 + detail::workerCount, std::memory_order_release);
+    detail::quit.store(false);
+
+    for(uint32_t i = 1; i <= detail::workerCount; i++)
+        detail::threads.emplace_back(detail::workerLoop, i);
+}
+
+void jobsShutdown()
+{
+    if(!detail::workers)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(detail::sleepMutex);
+        detail::quit.store(true);
+    }
+    detail::wake.notify_all();
+    for(std::thread& thread : detail::threads)
+        thread.join();
+
+    detail::threads.clear();
+    detail::generation.fetch_add(1, std::memory_order_acq_rel);
+    detail::activeSlots.store(0);
+    detail::workers.reset();
+    detail::workerCount = 0;
+    detail::slotCount = 0;
+}
+
+unsigned int jobsWorkerCount()
+{
+    return detail::workerCount;
+}
+
+void jobRun(JobCounter& counter, void (*task)(void*), void* data)
+{
+    Job job;
+    job.execute = detail::runTask;
+    job.task = task;
+    job.data = data;
+    job.counter = &counter;
+
+    counter.pending.fetch_add(1, std::memory_order_relaxed);
+    detail::submit(job);
+}
+
+void jobRunAfter(JobCounter& dependency, JobCounter& counter, void (*task)(void*), void* data)
+{
+    Job job;
+    job.execute = detail::runTask;
+    job.task = task;
+    job.data = data;
+    job.counter = &counter;
+    counter.pending.fetch_add(1, std::memory_order_relaxed);
+
+    detail::lock(dependency);
+    bool done = dependency.pending.load(std::memory_order_acquire) == 0;
+    if(!done)
+        dependency.continuations.push_back(job);
+    detail::unlock(dependency);
+
+    if(done)
+        detail::submit(job);
+}
+
+void jobWait(JobCounter& counter)
+{
+    detail::Worker* worker = detail::workers ? detail::localWorker() : nullptr;
+    while(counter.pending.load(std::memory_order_acquire) > 0)
+    {
+        if(!detail::workers || !detail::runOne(worker))
+            std::this_thread::yield();
+    }
+
+    /* the last finish() may still hold the lock */
+    detail::lock(counter);
+    detail::unlock(counter);
+}
+
+bool jobDone(JobCounter& counter)
+{
+    if(counter.pending.load(std::memory_order_acquire) > 0)
+        return false;
+
+    /* same handshake as jobWait */
+    detail::lock(counter);
+    detail::unlock(counter);
+    return true;
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+struct JobCounter;
+
+/* unit of work, executed once by any thread of the pool */
+struct Job
+{
+    void (*execute)(const Job& job) = nullptr;
+    void (*task)(void* data) = nullptr;
+    void* data = nullptr;
+    uint32_t begin = 0;
+    uint32_t end = 0;
+    JobCounter* counter = nullptr;      // decremented when the job finished
+};
+
+/**
+ * Number of unfinished jobs of a group. Jobs registered with jobRunAfter are started by the thread that brings the
+ * counter to zero, so dependencies don't block a worker. The counter has to outlive all jobs that refer to it.
+ */
+struct JobCounter
+{
+    std::atomic<int> pending{0};
+
+    /* continuations, guarded by a spin lock per counter (there is no global lock) */
+    std::atomic_flag lock = ATOMIC_FLAG_INIT;
+    std::vector<Job> continuations;
+};
+
+/**
+ * Work-stealing job system. Every worker owns a Chase-Lev deque: it pushes and pops jobs at the bottom without
+ * synchronization with other threads, idle workers steal from the top of a random victim. Threads that are not
+ * workers (main thread, simulation thread) get a deque on their first push and execute jobs while they wait, so
+ * waiting never wastes a core.
+ *
+ * Without jobsInit (or with 0 workers) everything runs inline on the calling thread.
+ *
+ * usage:
+ *
+ *   jobsInit();                                       // one worker per additional hardware thread
+ *
+ *   parallelFor(0, count, 1024, [&](uint32_t begin, uint32_t end) {
+ *       for(uint32_t i = begin; i < end; i++) { positions[i] += velocity[i] * dt; }
+ *   });
+ *
+ *   JobCounter counter;
+ *   jobRun(counter, loadMesh, &request);
+ *   jobRunAfter(counter, uploadDone, uploadMesh, &request);    // starts when loadMesh finished
+ *   jobWait(uploadDone);
+ *
+ *   jobsShutdown();
+ *
+ */
+
+/**
+ * @brief Start the worker threads. The calling thread becomes the main thread of the pool.
+ *
+ * @param workers Number of worker threads, -1 uses one per hardware thread except the calling one.
+ */
+void jobsInit(int workers = -1);
+
+/**
+ * @brief Stop and join all workers. No jobs may be in flight.
+ */
+void jobsShutdown();
+
+/**
+ * @brief Number of worker threads, not counting the threads that only help while waiting.
+ */
+unsigned int jobsWorkerCount();
+
+/**
+ * @brief Run a task on the pool.
+ *
+ * @param counter Counter that is incremented now and decremented when the task finished.
+ * @param task Function to run.
+ * @param data Argument of the task, has to stay valid until the task finished.
+ */
+void jobRun(JobCounter& counter, void (*task)(void*), void* data);
+
+/**
+ * @brief Run a task after all jobs of another counter finished.
+ *
+ * @param dependency Counter to wait for.
+ * @param counter Counter that is incremented now and decremented when the task finished.
+ * @param task Function to run.
+ * @param data Argument of the task, has to stay valid until the task finished.
+ */
+void jobRunAfter(JobCounter& dependency, JobCounter& counter, void (*task)(void*), void* data);
+
+/**
+ * @brief Wait until all jobs of a counter finished, executing other jobs in the meantime.
+ */
+void jobWait(JobCounter& counter);
+
+/**
+ * @brief True if all jobs of a counter finished, without waiting. Once it returned true the counter may be freed.
+ */
+bool jobDone(JobCounter& counter);
+
+namespace detail
+{
+void parallelForRun(uint32_t begin, uint32_t end, uint32_t grain, void (*body)(void*, uint32_t, uint32_t), void* data);
+}
+
+/**
+ * @brief Call body(begin, end) for sub ranges of [begin, end) of at most grain elements in parallel and wait for all of
+ * them. Ranges are split in halves on demand, idle workers steal the larger halves.
+ *
+ * @param begin First index.
+ * @param end One past the last index.
+ * @param grain Maximum number of elements per call, small enough to balance the load, large enough to amortize the
+ * scheduling (about 10 us of work).
+ * @param body Callable with the signature void(uint32_t begin, uint32_t end).
+ */
+template<typename Body>
+void parallelFor(uint32_t begin, uint32_t end, uint32_t grain, const Body& body)
+{
+    if(end <= begin)
+        return;
+    if(end - begin <= grain || jobsWorkerCount() == 0)
+    {
+        body(begin, end);
+        return;
+    }
+
+    auto call = [](void* data, uint32_t rangeBegin, uint32_t rangeEnd) {
+        (*static_cast<const Body*>(data))(rangeBegin, rangeEnd);
+    };
+    detail::parallelForRun(begin, end, grain > 0 ? grain : 1, call, const_cast<Body*>(&body));
+}
@@ -0,0 +1,163 @@
+#include "picking.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PICK_SSE 1
+#endif
+
+namespace detail
+{
+/* determinants below this are parallel to the triangle, degenerate padding triangles have a determinant of 0 */
+const float kPickEpsilon = 1e-8f;
+
+float pickScalar(const PickMesh& mesh, uint32_t i, const PickRay& ray)
+{
+    const Vector3D& d = ray.direction;
+    float e1x = mesh.edge1[0][i], e1y = mesh.edge1[1][i], e1z = mesh.edge1[2][i];
+    float e2x = mesh.edge2[0][i], e2y = mesh.edge2[1][i], e2z = mesh.edge2[2][i];
+
+    float px = d.y * e2z - d.z * e2y;
+    float py = d.z * e2x - d.x * e2z;
+    float pz = d.x * e2y - d.y * e2x;
+    float det = e1x * px + e1y * py + e1z * pz;
+    if(std::fabs(det) < kPickEpsilon)
+        return -1.0f;
+    float inverseDet = 1.0f / det;
+
+    float tx = ray.origin.x - mesh.v0[0][i], ty = ray.origin.y - mesh.v0[1][i], tz = ray.origin.z - mesh.v0[2][i];
+    float u = (tx * px + ty * py + tz * pz) * inverseDet;
+    if(u < 0.0f || u > 1.0f)
+        return -1.0f;
+
+    float qx = ty * e1z - tz * e1y;
+    float qy = tz * e1x - tx * e1z;
+    float qz = tx * e1y - ty * e1x;
+    float v = (d.x * qx + d.y * qy + d.z * qz) * inverseDet;
+    if(v < 0.0f || u + v > 1.0f)
+        return -1.0f;
+
+    return (e2x * qx + e2y * qy + e2z * qz) * inverseDet;
+}
+}
+
+PickMesh pickMeshCreate(const std::vector<Vector3D>& positions, const std::vector<unsigned int>& indices)
+{
+    PickMesh mesh;
+    mesh.triangles = uint32_t(indices.size() / 3);
+    uint32_t padded = (mesh.triangles + 3) / 4 * 4;
+    for(int axis = 0; axis < 3; axis++)
+    {
+        mesh.v0[axis].assign(padded, 0.0f);
+        mesh.edge1[axis].assign(padded, 0.0f);
+        mesh.edge2[axis].assign(padded, 0.0f);
+    }
+
+    for(uint32_t i = 0; i < mesh.triangles; i++)
+    {
+        const Vector3D& a = positions[indices[3 * i]];
+        Vector3D e1 = positions[indices[3 * i + 1]] - a;
+        Vector3D e2 = positions[indices[3 * i + 2]] - a;
+        for(int axis = 0; axis < 3; axis++)
+        {
+            mesh.v0[axis][i] = a[axis];
+            mesh.edge1[axis][i] = e1[axis];
+            mesh.edge2[axis][i] = e2[axis];
+        }
+    }
+    return mesh;
+}
+
+float pickMeshIntersect(const PickMesh& mesh, const PickRay& ray, float maxDistance)
+{
+    float closest = maxDistance;
+    bool hit = false;
+    uint32_t count = uint32_t(mesh.v0[0].size());
+
+#ifdef PICK_SSE
+    /* Möller-Trumbore on 4 triangles, the ray is the same for all lanes */
+    const __m128 dx = _mm_set1_ps(ray.direction.x), dy = _mm_set1_ps(ray.direction.y), dz = _mm_set1_ps(ray.direction.z);
+    const __m128 ox = _mm_set1_ps(ray.origin.x), oy = _mm_set1_ps(ray.origin.y), oz = _mm_set1_ps(ray.origin.z);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 epsilon = _mm_set1_ps(detail::kPickEpsilon);
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    for(uint32_t i = 0; i < count; i += 4)
+    {
+        __m128 e1x = _mm_loadu_ps(&mesh.edge1[0][i]), e1y = _mm_loadu_ps(&mesh.edge1[1][i]), e1z = _mm_loadu_ps(&mesh.edge1[2][i]);
+        __m128 e2x = _mm_loadu_ps(&mesh.edge2[0][i]), e2y = _mm_loadu_ps(&mesh.edge2[1][i]), e2z = _mm_loadu_ps(&mesh.edge2[2][i]);
+
+        /* p = d x e2, det = e1 . p */
+        __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+        __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+        __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+        __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+        __m128 valid = _mm_cmpge_ps(_mm_andnot_ps(signMask, det), epsilon);
+        if(_mm_movemask_ps(valid) == 0)
+            continue;
+        __m128 inverseDet = _mm_div_ps(one, _mm_or_ps(_mm_and_ps(valid, det), _mm_andnot_ps(valid, one)));
+
+        /* t = o - v0, u = t . p / det */
+        __m128 tx = _mm_sub_ps(ox, _mm_loadu_ps(&mesh.v0[0][i]));
+        __m128 ty = _mm_sub_ps(oy, _mm_loadu_ps(&mesh.v0[1][i]));
+        __m128 tz = _mm_sub_ps(oz, _mm_loadu_ps(&mesh.v0[2][i]));
+        __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz)), inverseDet);
+
+        /* q = t x e1, v = d . q / det, distance = e2 . q / det */
+        __m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+        __m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+        __m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+        __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inverseDet);
+        __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inverseDet);
+
+        valid = _mm_and_ps(valid, _mm_cmpge_ps(u, zero));
+        valid = _mm_and_ps(valid, _mm_cmpge_ps(v, zero));
+        valid = _mm_and_ps(valid, _mm_cmple_ps(_mm_add_ps(u, v), one));
+        valid = _mm_and_ps(valid, _mm_cmpge_ps(t, zero));
+        valid = _mm_and_ps(valid, _mm_cmple_ps(t, _mm_set1_ps(closest)));
+        int mask = _mm_movemask_ps(valid);
+        if(mask == 0)
+            continue;
+
+        float distances[4];
+        _mm_storeu_ps(distances, t);
+        for(int lane = 0; lane < 4; lane++)
+        {
+            if(mask & (1 << lane))
+            {
+                closest = std::min(closest, distances[lane]);
+                hit = true;
+            }
+        }
+    }
+#else
+    for(uint32_t i = 0; i < count; i++)
+    {
+        float distance = detail::pickScalar(mesh, i, ray);
+        if(distance >= 0.0f && distance <= closest)
+        {
+            closest = distance;
+            hit = true;
+        }
+    }
+#endif
+    return hit ? closest : -1.0f;
+}
+
+PickRay pickRayFromCursor(const Matrix4D& inverseViewProjection, float x, float y)
+{
+    /* window y points down, clip space y up */
+    float ndcX = 2.0f * x - 1.0f;
+    float ndcY = 1.0f - 2.0f * y;
+    Vector4D nearPoint = inverseViewProjection * Vector4D(ndcX, ndcY, -1.0f, 1.0f);
+    Vector4D farPoint = inverseViewProjection * Vector4D(ndcX, ndcY, 1.0f, 1.0f);
+    Vector3D origin = Vector3D(nearPoint) / nearPoint.w;
+    return {origin, Vector3D(farPoint) / farPoint.w - origin};
+}
+
+PickRay pickRayTransform(const PickRay& ray, const Matrix4D& matrix)
+{
+    return {Vector3D(matrix * Vector4D(ray.origin, 1.0f)), Vector3D(matrix * Vector4D(ray.direction, 0.0f))};
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "core/bvh.h"
+#include "math/matrix4d.h"
+
+#include <cstdint>
+#include <vector>
+
+struct PickRay
+{
+    Vector3D origin;
+    Vector3D direction;     // not normalized, distances along the ray are in multiples of it
+};
+
+/**
+ * Triangles of a mesh prepared for ray tests on the CPU: the first vertex and the two edges of every triangle in
+ * separate arrays (structure of arrays), padded with degenerate triangles to a multiple of 4 so Möller-Trumbore runs
+ * on 4 triangles per SSE instruction without a scalar tail.
+ */
+struct PickMesh
+{
+    std::vector<float> v0[3];
+    std::vector<float> edge1[3];
+    std::vector<float> edge2[3];
+    uint32_t triangles = 0;         // without the padding
+};
+
+/**
+ * @brief Copies the triangles of an indexed mesh.
+ *
+ * @param positions Vertex positions.
+ * @param indices Three indices per triangle.
+ *
+ * @return Mesh prepared for pickMeshIntersect.
+ *
+ * usage:
+ *
+ *   PickMesh cube = pickMeshCreate(cube::vertexPos, cube::indices);
+ *   PickRay ray = pickRayFromCursor(matrices.inverseViewProjection, 0.5f, 0.5f);
+ *   float distance = farPlane;
+ *   uint32_t item = bvhRaycast(bvh, ray.origin, ray.direction, distance, [&](uint32_t item, float maxDistance) {
+ *       PickRay local = pickRayTransform(ray, inverse(world[item]));
+ *       return pickMeshIntersect(cube, local, maxDistance);
+ *   });
+ *
+ */
+PickMesh pickMeshCreate(const std::vector<Vector3D>& positions, const std::vector<unsigned int>& indices);
+
+/**
+ * @brief Closest intersection of a ray with the triangles of a mesh, both sides of a triangle count.
+ *
+ * @param mesh Mesh in the same space as the ray.
+ * @param ray Ray to test.
+ * @param maxDistance Hits farther than this are ignored.
+ *
+ * @return Distance of the closest hit in multiples of the ray direction, negative if there is none.
+ */
+float pickMeshIntersect(const PickMesh& mesh, const PickRay& ray, float maxDistance);
+
+/**
+ * @brief Ray through a point of the window, from the near to the far plane.
+ *
+ * @param inverseViewProjection Inverse of projection * view of the camera.
+ * @param x Horizontal position in [0, 1], left to right.
+ * @param y Vertical position in [0, 1], top to bottom as in window coordinates.
+ *
+ * @return Ray starting on the near plane, the far plane is at distance 1.
+ */
+PickRay pickRayFromCursor(const Matrix4D& inverseViewProjection, float x, float y);
+
+/**
+ * @brief Ray in another space, e.g. the local space of an object with the inverse of its world matrix. Distances
+ * along the ray stay the same because the direction is not renormalized.
+ */
+PickRay pickRayTransform(const PickRay& ray, const Matrix4D& matrix);
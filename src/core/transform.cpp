@@ -0,0 +1,131 @@
+#include "transform.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace detail
+{
+    /* flags in TransformGraph::dirty */
+    const unsigned char localDirty = 1;     // local TRS changed, local matrix has to be rebuilt
+    const unsigned char worldDirty = 2;     // world matrix has to be rebuilt (also set for all descendants in the pass)
+
+    /* builds T * R * S without the general 4x4 products */
+    Matrix4D composeTRS(const Vector3D& t, const Matrix3D& r, const Vector3D& s)
+    {
+        return Matrix4D(r(0,0) * s.x, r(0,1) * s.y, r(0,2) * s.z, t.x,
+                        r(1,0) * s.x, r(1,1) * s.y, r(1,2) * s.z, t.y,
+                        r(2,0) * s.x, r(2,1) * s.y, r(2,2) * s.z, t.z,
+                        0.0f,         0.0f,         0.0f,         1.0f);
+    }
+
+    void markDirty(TransformGraph& graph, int node)
+    {
+        assert(node >= 0 && node < static_cast<int>(graph.parent.size()));
+        graph.dirty[node] = localDirty | worldDirty;
+    }
+}
+
+int transformCreate(TransformGraph& graph, int parent, const Vector3D& translation, const Matrix3D& rotation, const Vector3D& scale)
+{
+    int node = static_cast<int>(graph.parent.size());
+    assert(parent < node);
+
+    graph.parent.push_back(parent);
+    graph.translation.push_back(translation);
+    graph.rotation.push_back(rotation);
+    graph.scale.push_back(scale);
+    graph.local.push_back(Matrix4D::identity());
+    graph.world.push_back(Matrix4D::identity());
+    graph.dirty.push_back(detail::localDirty | detail::worldDirty);
+
+    return node;
+}
+
+int transformAppend(TransformGraph& graph, std::size_t count, const int* parent, const Vector3D* translation,
+                    const Matrix3D* rotation, const Vector3D* scale)
+{
+    int first = static_cast<int>(graph.parent.size());
+    graph.parent.insert(graph.parent.end(), parent, parent + count);
+    graph.translation.insert(graph.translation.end(), translation, translation + count);
+    graph.rotation.insert(graph.rotation.end(), rotation, rotation + count);
+    graph.scale.insert(graph.scale.end(), scale, scale + count);
+    graph.local.resize(graph.local.size() + count, Matrix4D::identity());
+    graph.world.resize(graph.world.size() + count, Matrix4D::identity());
+    graph.dirty.resize(graph.dirty.size() + count, detail::localDirty | detail::worldDirty);
+
+    return first;
+}
+
+void transformReserve(TransformGraph& graph, std::size_t count)
+{
+    graph.parent.reserve(count);
+    graph.translation.reserve(count);
+    graph.rotation.reserve(count);
+    graph.scale.reserve(count);
+    graph.local.reserve(count);
+    graph.world.reserve(count);
+    graph.dirty.reserve(count);
+}
+
+void transformSetTranslation(TransformGraph& graph, int node, const Vector3D& translation)
+{
+    detail::markDirty(graph, node);
+    graph.translation[node] = translation;
+}
+
+void transformSetRotation(TransformGraph& graph, int node, const Matrix3D& rotation)
+{
+    detail::markDirty(graph, node);
+    graph.rotation[node] = rotation;
+}
+
+void transformSetScale(TransformGraph& graph, int node, const Vector3D& scale)
+{
+    detail::markDirty(graph, node);
+    graph.scale[node] = scale;
+}
+
+void transformRotate(TransformGraph& graph, int node, const Matrix3D& r)
+{
+    detail::markDirty(graph, node);
+    graph.rotation[node] = r * graph.rotation[node];
+}
+
+void transformUpdate(TransformGraph& graph)
+{
+    std::size_t count = graph.parent.size();
+    graph.updated.clear();
+
+    for(std::size_t i = 0; i < count; i++)
+    {
+        int p = graph.parent[i];
+        unsigned char flags = graph.dirty[i];
+        if(p >= 0 && (graph.dirty[p] & detail::worldDirty))
+        {
+            flags |= detail::worldDirty;
+        }
+        if(!flags)
+        {
+            continue;
+        }
+
+        if(flags & detail::localDirty)
+        {
+            graph.local[i] = detail::composeTRS(graph.translation[i], graph.rotation[i], graph.scale[i]);
+        }
+        graph.world[i] = p >= 0 ? graph.world[p] * graph.local[i] : graph.local[i];
+
+        /* keep worldDirty set until the end of the pass so the children pick it up */
+        graph.dirty[i] = detail::worldDirty;
+        graph.updated.push_back(static_cast<int>(i));
+    }
+
+    std::fill(graph.dirty.begin(), graph.dirty.end(), 0);
+    graph.updatedNodes = static_cast<unsigned int>(graph.updated.size());
+}
+
+const Matrix4D& transformWorld(const TransformGraph& graph, int node)
+{
+    assert(node >= 0 && node < static_cast<int>(graph.world.size()));
+    return graph.world[node];
+}
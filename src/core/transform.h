@@ -0,0 +1,106 @@
+#pragma once
+
+#include "math/vector3d.h"
+#include "math/matrix3d.h"
+#include "math/matrix4d.h"
+
+#include <vector>
+
+/**
+ * Transform hierarchy stored as flat arrays. A node has a local translation/rotation/scale and a parent; its world
+ * matrix is the parent's world matrix times its local matrix. Parents are always created before their children, so
+ * one linear pass in creation order updates the whole graph, and only nodes whose local transform or one of whose
+ * ancestors changed since the last update are recomputed. The world matrices are contiguous and can be uploaded as is.
+ */
+struct TransformGraph
+{
+    std::vector<int> parent;                // -1 for root nodes
+    std::vector<Vector3D> translation;
+    std::vector<Matrix3D> rotation;
+    std::vector<Vector3D> scale;
+
+    std::vector<Matrix4D> local;            // cached T * R * S
+    std::vector<Matrix4D> world;            // cached parent world * local
+    std::vector<unsigned char> dirty;       // see detail flags in transform.cpp
+
+    unsigned int updatedNodes = 0;          // nodes recomputed by the last transformUpdate
+    std::vector<int> updated;               // those nodes in creation order
+};
+
+/**
+ * @brief Creates a node in a transform graph.
+ *
+ * @param graph Transform graph.
+ * @param parent Parent node, has to exist already (-1 for a root node).
+ * @param translation Local translation.
+ * @param rotation Local rotation.
+ * @param scale Local scale.
+ *
+ * @return Index of the new node.
+ *
+ * usage:
+ *
+ *   int boat = transformCreate(graph);
+ *   int mast = transformCreate(graph, boat, {-1.0f, 2.4f, 0.0f}, Matrix3D::identity(), {0.15f, 1.5f, 0.15f});
+ *   transformRotate(graph, boat, Matrix3D::rotationY(0.1f));   // moves the mast as well
+ *   transformUpdate(graph);
+ *   shaderUniform(uModel, graph.world[mast]);
+ *
+ */
+int transformCreate(TransformGraph& graph, int parent = -1, const Vector3D& translation = {0.0f, 0.0f, 0.0f},
+                    const Matrix3D& rotation = Matrix3D::identity(), const Vector3D& scale = {1.0f, 1.0f, 1.0f});
+
+/**
+ * @brief Appends many nodes at once, e.g. from a loaded scene, with one copy per array.
+ *
+ * @param graph Transform graph.
+ * @param count Number of nodes.
+ * @param parent Parent of every node, relative to the whole graph, -1 for root nodes. Parents come before children.
+ * @param translation Local translation of every node.
+ * @param rotation Local rotation of every node.
+ * @param scale Local scale of every node.
+ *
+ * @return Index of the first new node.
+ */
+int transformAppend(TransformGraph& graph, std::size_t count, const int* parent, const Vector3D* translation,
+                    const Matrix3D* rotation, const Vector3D* scale);
+
+/**
+ * @brief Reserves memory for a number of nodes so creating them doesn't reallocate.
+ *
+ * @param graph Transform graph.
+ * @param count Total number of nodes expected.
+ */
+void transformReserve(TransformGraph& graph, std::size_t count);
+
+/**
+ * @brief Set the local translation of a node.
+ */
+void transformSetTranslation(TransformGraph& graph, int node, const Vector3D& translation);
+
+/**
+ * @brief Set the local rotation of a node.
+ */
+void transformSetRotation(TransformGraph& graph, int node, const Matrix3D& rotation);
+
+/**
+ * @brief Set the local scale of a node.
+ */
+void transformSetScale(TransformGraph& graph, int node, const Vector3D& scale);
+
+/**
+ * @brief Apply an additional rotation to a node (in the space of its parent, rotation = r * rotation).
+ */
+void transformRotate(TransformGraph& graph, int node, const Matrix3D& r);
+
+/**
+ * @brief Recompute the world matrices of all changed nodes and their subtrees.
+ *
+ * @param graph Transform graph.
+ */
+void transformUpdate(TransformGraph& graph);
+
+/**
+ * @brief Get the world matrix of a node as of the last transformUpdate.
+ */
+const Matrix4D& transformWorld(const TransformGraph& graph, int node);
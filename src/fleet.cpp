@@ -0,0 +1,401 @@
+#include "fleet.h"
+#include "core/jobs.h"
+#include "mygl/glstate.h"
+#include "mygl/profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FLEET_SSE 1
+#endif
+
+namespace detail
+{
+/* boats per job, culling packs the visible boats of a chunk at its begin */
+const uint32_t kFleetChunk = 4096;
+
+double fleetMsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/* xorshift, the fleet looks the same on every run */
+float fleetRandom(uint32_t& state, float min, float max)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return min + (max - min) * float(state & 0xFFFFFF) / float(0xFFFFFF);
+}
+
+/* turn by turnRate * dt with sin/cos approximated to third order (exact to 1e-7 for the small angles of one frame),
+ * renormalize against drift and move forward, the local x axis of the model */
+void fleetUpdateScalar(Fleet& fleet, uint32_t i, float dt)
+{
+    float angle = fleet.turnRate[i] * dt;
+    float cosDelta = 1.0f - 0.5f * angle * angle;
+    float sinDelta = angle - angle * angle * angle / 6.0f;
+    float c = fleet.cosHeading[i] * cosDelta - fleet.sinHeading[i] * sinDelta;
+    float s = fleet.sinHeading[i] * cosDelta + fleet.cosHeading[i] * sinDelta;
+    float norm = 1.0f / std::sqrt(c * c + s * s);
+    fleet.cosHeading[i] = c * norm;
+    fleet.sinHeading[i] = s * norm;
+
+    float distance = fleet.speed[i] * dt;
+    float x = fleet.x[i] + fleet.cosHeading[i] * distance;
+    float z = fleet.z[i] - fleet.sinHeading[i] * distance;
+    fleet.x[i] = x > fleet.extent ? x - 2.0f * fleet.extent : x < -fleet.extent ? x + 2.0f * fleet.extent : x;
+    fleet.z[i] = z > fleet.extent ? z - 2.0f * fleet.extent : z < -fleet.extent ? z + 2.0f * fleet.extent : z;
+}
+
+void fleetUpdateRange(Fleet& fleet, uint32_t begin, uint32_t end, float dt)
+{
+    uint32_t i = begin;
+#ifdef FLEET_SSE
+    const __m128 vDt = _mm_set1_ps(dt);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 sixth = _mm_set1_ps(1.0f / 6.0f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 three = _mm_set1_ps(3.0f);
+    const __m128 extent = _mm_set1_ps(fleet.extent);
+    const __m128 negExtent = _mm_set1_ps(-fleet.extent);
+    const __m128 size = _mm_set1_ps(2.0f * fleet.extent);
+    for(; i + 4 <= end; i += 4)
+    {
+        __m128 angle = _mm_mul_ps(_mm_loadu_ps(&fleet.turnRate[i]), vDt);
+        __m128 angle2 = _mm_mul_ps(angle, angle);
+        __m128 cosDelta = _mm_sub_ps(one, _mm_mul_ps(half, angle2));
+        __m128 sinDelta = _mm_sub_ps(angle, _mm_mul_ps(_mm_mul_ps(angle2, angle), sixth));
+
+        __m128 c0 = _mm_loadu_ps(&fleet.cosHeading[i]);
+        __m128 s0 = _mm_loadu_ps(&fleet.sinHeading[i]);
+        __m128 c = _mm_sub_ps(_mm_mul_ps(c0, cosDelta), _mm_mul_ps(s0, sinDelta));
+        __m128 s = _mm_add_ps(_mm_mul_ps(s0, cosDelta), _mm_mul_ps(c0, sinDelta));
+
+        /* rsqrt plus one Newton step: y * (3 - x * y^2) / 2 */
+        __m128 lengthSq = _mm_add_ps(_mm_mul_ps(c, c), _mm_mul_ps(s, s));
+        __m128 norm = _mm_rsqrt_ps(lengthSq);
+        norm = _mm_mul_ps(_mm_mul_ps(half, norm), _mm_sub_ps(three, _mm_mul_ps(lengthSq, _mm_mul_ps(norm, norm))));
+        c = _mm_mul_ps(c, norm);
+        s = _mm_mul_ps(s, norm);
+        _mm_storeu_ps(&fleet.cosHeading[i], c);
+        _mm_storeu_ps(&fleet.sinHeading[i], s);
+
+        __m128 distance = _mm_mul_ps(_mm_loadu_ps(&fleet.speed[i]), vDt);
+        __m128 x = _mm_add_ps(_mm_loadu_ps(&fleet.x[i]), _mm_mul_ps(c, distance));
+        __m128 z = _mm_sub_ps(_mm_loadu_ps(&fleet.z[i]), _mm_mul_ps(s, distance));
+
+        /* wrap around: subtract the size where above the extent, add it where below */
+        x = _mm_sub_ps(x, _mm_and_ps(_mm_cmpgt_ps(x, extent), size));
+        x = _mm_add_ps(x, _mm_and_ps(_mm_cmplt_ps(x, negExtent), size));
+        z = _mm_sub_ps(z, _mm_and_ps(_mm_cmpgt_ps(z, extent), size));
+        z = _mm_add_ps(z, _mm_and_ps(_mm_cmplt_ps(z, negExtent), size));
+        _mm_storeu_ps(&fleet.x[i], x);
+        _mm_storeu_ps(&fleet.z[i], z);
+    }
+#endif
+    for(; i < end; i++)
+    {
+        fleetUpdateScalar(fleet, i, dt);
+    }
+}
+
+/* cull the boats of a chunk and pack the visible ones at the begin of the chunk, returns their number */
+uint32_t fleetCullChunk(Fleet& fleet, const Vector4D planes[6], uint32_t begin, uint32_t end)
+{
+    uint32_t* visible = &fleet.visible[begin];
+    uint32_t count = 0;
+    uint32_t i = begin;
+#ifdef FLEET_SSE
+    const __m128 negRadius = _mm_set1_ps(-fleet.radius);
+    for(; i + 4 <= end; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(&fleet.x[i]);
+        __m128 z = _mm_loadu_ps(&fleet.z[i]);
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for(int p = 0; p < 6; p++)
+        {
+            /* the sphere is centered at the origin of the boat, at height 0 */
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p].x), x),
+                                                    _mm_mul_ps(_mm_set1_ps(planes[p].z), z)),
+                                         _mm_set1_ps(planes[p].w));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+        }
+        int mask = _mm_movemask_ps(inside);
+        for(int lane = 0; lane < 4; lane++)
+        {
+            if(mask & (1 << lane)) { visible[count++] = i + lane; }
+        }
+    }
+#endif
+    for(; i < end; i++)
+    {
+        bool inside = true;
+        for(int p = 0; p < 6 && inside; p++)
+        {
+            inside = planes[p].x * fleet.x[i] + planes[p].z * fleet.z[i] + planes[p].w >= -fleet.radius;
+        }
+        if(inside) { visible[count++] = i; }
+    }
+    return count;
+}
+}
+
+Fleet fleetCreate(const Mesh& mesh, const std::vector<FleetPart>& parts, int count, float spacing, int liveries)
+{
+    if(!GLAD_GL_ARB_instanced_arrays)
+    {
+        std::cerr << "[Fleet] Instanced arrays (ARB_instanced_arrays) are not supported" << std::endl;
+        std::cerr.flush();
+        throw std::runtime_error("[Fleet] Instanced arrays are not supported");
+    }
+
+    Fleet fleet;
+    fleet.parts = parts;
+    fleet.indexCount = mesh.size_ibo;
+    fleet.extent = 0.5f * spacing * std::sqrt(float(std::max(count, 1)));
+
+    /* bounding sphere of the parts, cubes of [-1, 1]^3: distance of the part center plus half its diagonal */
+    for(const FleetPart& part : parts)
+    {
+        Vector3D center = Vector3D(part.model[3]);
+        Vector3D diagonal = Vector3D(part.model[0] + part.model[1] + part.model[2]);
+        fleet.radius = std::max(fleet.radius, length(center) + length(diagonal));
+    }
+
+    uint32_t state = 0x9E3779B9u;
+    size_t n = size_t(std::max(count, 0));
+    fleet.x.resize(n);
+    fleet.z.resize(n);
+    fleet.cosHeading.resize(n);
+    fleet.sinHeading.resize(n);
+    fleet.speed.resize(n);
+    fleet.turnRate.resize(n);
+    liveries = std::clamp(liveries, 0, 256);
+    fleet.livery.resize(liveries > 0 ? n : 0);
+    fleet.liveryLayers.assign(size_t(liveries), 0.0f);
+    for(size_t i = 0; i < n; i++)
+    {
+        float heading = detail::fleetRandom(state, 0.0f, 2.0f * float(M_PI));
+        fleet.x[i] = detail::fleetRandom(state, -fleet.extent, fleet.extent);
+        fleet.z[i] = detail::fleetRandom(state, -fleet.extent, fleet.extent);
+        fleet.cosHeading[i] = std::cos(heading);
+        fleet.sinHeading[i] = std::sin(heading);
+        fleet.speed[i] = detail::fleetRandom(state, 1.0f, 4.0f);
+        fleet.turnRate[i] = detail::fleetRandom(state, -0.3f, 0.3f);
+        if(liveries > 0)
+            fleet.livery[i] = uint8_t(std::min(int(detail::fleetRandom(state, 0.0f, float(liveries))), liveries - 1));
+    }
+    fleet.visible.resize(n);
+    fleet.chunkVisible.resize((n + detail::kFleetChunk - 1) / detail::kFleetChunk);
+
+    /* vertex array sharing the buffers of the mesh, with one matrix per instance in the attributes 2-5 */
+    glGenVertexArrays(1, &fleet.vao);
+    glGenBuffers(1, &fleet.instanceVbo);
+    if(liveries > 0)
+        glGenBuffers(1, &fleet.layerVbo);
+    glStateBindVertexArray(fleet.vao);
+    {
+        glStateBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+        glStateBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+        glEnableVertexAttribArray(eDataIdx::Position);
+        glEnableVertexAttribArray(eDataIdx::Color);
+        glVertexAttribPointer(eDataIdx::Position, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) offsetof(Vertex, pos));
+        glVertexAttribPointer(eDataIdx::Color, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) offsetof(Vertex, color));
+
+        glStateBindBuffer(GL_ARRAY_BUFFER, fleet.instanceVbo);
+        for(GLuint column = 0; column < 4; column++)
+        {
+            GLuint attribute = eDataIdx::Instance + column;
+            glEnableVertexAttribArray(attribute);
+            glVertexAttribPointer(attribute, 4, GL_FLOAT, GL_FALSE, sizeof(Matrix4D), (void*) (column * sizeof(Vector4D)));
+            glVertexAttribDivisorARB(attribute, 1);
+        }
+        if(fleet.layerVbo != 0)
+        {
+            glStateBindBuffer(GL_ARRAY_BUFFER, fleet.layerVbo);
+            glEnableVertexAttribArray(eDataIdx::Layer);
+            glVertexAttribPointer(eDataIdx::Layer, 1, GL_FLOAT, GL_FALSE, sizeof(float), nullptr);
+            glVertexAttribDivisorARB(eDataIdx::Layer, 1);
+        }
+        glCheckError();
+    }
+    glStateBindVertexArray(0);
+    glStateBindBuffer(GL_ARRAY_BUFFER, 0);
+    glStateBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    return fleet;
+}
+
+void fleetUpdate(Fleet& fleet, float dt)
+{
+    if(fleet.x.empty()) { return; }
+
+    PROFILE_CPU("fleet update");
+    auto start = std::chrono::steady_clock::now();
+    parallelFor(0, uint32_t(fleet.x.size()), detail::kFleetChunk, [&](uint32_t begin, uint32_t end) {
+        detail::fleetUpdateRange(fleet, begin, end, dt);
+    });
+    fleet.updateMs += detail::fleetMsSince(start);
+}
+
+GLsizei fleetCull(Fleet& fleet, const Vector4D frustum[6], std::vector<Matrix4D>& instances,
+                  std::vector<float>& layers)
+{
+    if(fleet.x.empty()) { return 0; }
+
+    PROFILE_CPU("fleet cull");
+    auto start = std::chrono::steady_clock::now();
+
+    /* pass 1: cull every chunk in parallel */
+    uint32_t count = uint32_t(fleet.x.size());
+    uint32_t chunks = uint32_t(fleet.chunkVisible.size());
+    parallelFor(0, chunks, 1, [&](uint32_t begin, uint32_t end) {
+        for(uint32_t chunk = begin; chunk < end; chunk++)
+        {
+            uint32_t first = chunk * detail::kFleetChunk;
+            fleet.chunkVisible[chunk] = detail::fleetCullChunk(fleet, frustum, first, std::min(first + detail::kFleetChunk, count));
+        }
+    });
+
+    /* offsets of the chunks in the instance array */
+    std::vector<uint32_t> offsets(chunks + 1, 0);
+    for(uint32_t chunk = 0; chunk < chunks; chunk++)
+    {
+        offsets[chunk + 1] = offsets[chunk] + fleet.chunkVisible[chunk];
+    }
+    uint32_t visible = offsets[chunks];
+    if(instances.size() < visible)
+    {
+        instances.resize(visible);
+    }
+    bool liveries = !fleet.livery.empty();
+    if(liveries && layers.size() < visible)
+    {
+        layers.resize(visible);
+    }
+
+    /* pass 2: write the root matrices (rotation about y, translation) and livery layers of the visible boats in parallel */
+    parallelFor(0, chunks, 1, [&](uint32_t begin, uint32_t end) {
+        for(uint32_t chunk = begin; chunk < end; chunk++)
+        {
+            const uint32_t* indices = &fleet.visible[chunk * detail::kFleetChunk];
+            Matrix4D* out = &instances[offsets[chunk]];
+            for(uint32_t k = 0; k < fleet.chunkVisible[chunk]; k++)
+            {
+                uint32_t i = indices[k];
+                float c = fleet.cosHeading[i];
+                float s = fleet.sinHeading[i];
+                out[k] = Matrix4D(c, 0.0f, s, fleet.x[i],
+                                  0.0f, 1.0f, 0.0f, 0.0f,
+                                  -s, 0.0f, c, fleet.z[i],
+                                  0.0f, 0.0f, 0.0f, 1.0f);
+            }
+            if(liveries)
+            {
+                float* layer = &layers[offsets[chunk]];
+                for(uint32_t k = 0; k < fleet.chunkVisible[chunk]; k++)
+                {
+                    layer[k] = fleet.liveryLayers[fleet.livery[indices[k]]];
+                }
+            }
+        }
+    });
+
+    fleet.frames++;
+    fleet.visibleSum += visible;
+    fleet.cullMs += detail::fleetMsSince(start);
+    return GLsizei(visible);
+}
+
+void fleetEnqueue(const Fleet& fleet, RenderQueue& queue, const ShaderProgram* program, GLsizei visible,
+                  const Matrix4D& view, const ShaderProgram* texturedProgram, GLuint textureArray)
+{
+    if(visible == 0) { return; }
+
+    for(const FleetPart& part : fleet.parts)
+    {
+        DrawPacket packet;
+        packet.program = program;
+        if(part.textured && texturedProgram && fleet.layerVbo != 0)
+        {
+            packet.program = texturedProgram;
+            packet.texture = textureArray;
+        }
+        packet.vao = fleet.vao;
+        packet.indexCount = fleet.indexCount;
+        packet.instanceCount = visible;
+        packet.model = part.model;
+        packet.color = part.color;
+        packet.depth = -(view * part.model[3]).z;
+        renderQueuePush(queue, packet);
+    }
+}
+
+void fleetUpload(Fleet& fleet, const std::vector<Matrix4D>& instances, const std::vector<float>& layers,
+                 GLsizei visible)
+{
+    PROFILE_CPU("fleet upload");
+    auto start = std::chrono::steady_clock::now();
+
+    /* orphan the storage used by the previous frame, grow it in steps to avoid reallocations every frame */
+    glStateBindBuffer(GL_ARRAY_BUFFER, fleet.instanceVbo);
+    if(size_t(visible) > fleet.instanceCapacity)
+    {
+        fleet.instanceCapacity = std::max(size_t(visible), fleet.instanceCapacity * 3 / 2);
+    }
+    glBufferData(GL_ARRAY_BUFFER, fleet.instanceCapacity * sizeof(Matrix4D), nullptr, GL_STREAM_DRAW);
+    if(visible > 0)
+    {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, visible * sizeof(Matrix4D), instances.data());
+    }
+    if(fleet.layerVbo != 0)
+    {
+        glStateBindBuffer(GL_ARRAY_BUFFER, fleet.layerVbo);
+        glBufferData(GL_ARRAY_BUFFER, fleet.instanceCapacity * sizeof(float), nullptr, GL_STREAM_DRAW);
+        if(visible > 0)
+        {
+            glBufferSubData(GL_ARRAY_BUFFER, 0, visible * sizeof(float), layers.data());
+        }
+    }
+    glStateBindBuffer(GL_ARRAY_BUFFER, 0);
+    fleet.uploadMs += detail::fleetMsSince(start);
+}
+
+void fleetReport(const Fleet& fleet)
+{
+    if(fleet.frames == 0 || fleet.x.empty()) { return; }
+
+    double frames = double(fleet.frames);
+    std::cout << "[Fleet] " << fleet.x.size() << " boats, " << fleet.visibleSum / frames << " visible on average, "
+              << fleet.parts.size() << " instanced draws per frame; per frame: update " << fleet.updateMs / frames
+              << " ms, cull " << fleet.cullMs / frames << " ms, upload " << fleet.uploadMs / frames << " ms"
+#ifdef FLEET_SSE
+              << " (SSE)"
+#endif
+              << std::endl;
+}
+
+void fleetDelete(Fleet& fleet)
+{
+    if(fleet.vao == 0) { return; }
+
+    glStateForgetVertexArray(fleet.vao);
+    glStateForgetBuffer(fleet.instanceVbo);
+    glDeleteVertexArrays(1, &fleet.vao);
+    glDeleteBuffers(1, &fleet.instanceVbo);
+    if(fleet.layerVbo != 0)
+    {
+        glStateForgetBuffer(fleet.layerVbo);
+        glDeleteBuffers(1, &fleet.layerVbo);
+    }
+    fleet.vao = 0;
+    fleet.instanceVbo = 0;
+    fleet.layerVbo = 0;
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "mygl/base.h"
+#include "mygl/mesh.h"
+#include "mygl/renderqueue.h"
+
+#include <cstdint>
+#include <vector>
+
+/* one part of the boat model, drawn once per visible boat with the same mesh */
+struct FleetPart
+{
+    Matrix4D model;         // relative to the boat
+    Vector4D color;
+    bool textured = false;  // drawn with the livery of each boat
+};
+
+/**
+ * Large number of identical boats cruising on the water. Boats are stored as structure of arrays, updated in parallel
+ * (4 boats per SSE instruction where available) and culled against the view frustum with their bounding sphere. The
+ * root matrices of the visible boats form an instance buffer, so every part of the model is a single instanced draw
+ * no matter how many boats there are: the vertex shader variant INSTANCED computes aInstance * uModel * aPosition.
+ * With liveries every boat picks one texture for its textured parts; the layer of that texture in the texture array
+ * travels next to the matrix as a second instance attribute, so differently textured boats still share one draw.
+ */
+struct Fleet
+{
+    /* one entry per boat */
+    std::vector<float> x;
+    std::vector<float> z;
+    std::vector<float> cosHeading;      // heading as unit vector, rotated incrementally instead of calling sin/cos
+    std::vector<float> sinHeading;
+    std::vector<float> speed;           // world units per second along the heading
+    std::vector<float> turnRate;        // radians per second
+    std::vector<uint8_t> livery;        // index into liveryLayers, empty without liveries
+
+    /* texture array layer of each livery, set before fleetCull (see textureStreamUse) */
+    std::vector<float> liveryLayers;
+
+    std::vector<FleetPart> parts;
+    float radius = 0.0f;                // bounding sphere of the model around its origin
+    float extent = 0.0f;                // boats live in [-extent, extent] on both axes and wrap around
+
+    /* culling scratch: visible boats of each chunk, packed at the begin of the chunk */
+    std::vector<uint32_t> visible;
+    std::vector<uint32_t> chunkVisible;
+
+    /* GL objects: the mesh buffers plus the per-instance matrices in attributes 2-5 and layers in attribute 6 */
+    GLuint vao = 0;
+    GLuint instanceVbo = 0;
+    GLuint layerVbo = 0;                // 0 without liveries
+    GLsizei indexCount = 0;
+    size_t instanceCapacity = 0;
+
+    /* statistics in milliseconds */
+    uint64_t frames = 0;
+    uint64_t visibleSum = 0;
+    double updateMs = 0.0;
+    double cullMs = 0.0;
+    double uploadMs = 0.0;
+};
+
+/**
+ * @brief Creates a fleet with random positions, headings and speeds. The model is drawn with the buffers of a mesh.
+ *
+ * @param mesh Mesh of every part, its buffers are shared with a vertex array that adds the instance attributes.
+ * @param parts Parts of the boat model.
+ * @param count Number of boats.
+ * @param spacing Average distance between boats, the fleet covers a square of count * spacing^2.
+ * @param liveries Number of textures the boats pick from for their textured parts (at most 256), 0 for none.
+ *
+ * @return Initialized fleet.
+ *
+ * usage:
+ *
+ *   Fleet fleet = fleetCreate(cubeMesh, parts, 10000);
+ *   fleetUpdate(fleet, dt);                                                    // simulation
+ *   GLsizei visible = fleetCull(fleet, matrices.frustum, instances, layers);   // snapshot
+ *   fleetEnqueue(fleet, queue, &instancedProgram, visible, view);
+ *   fleetUpload(fleet, instances, layers, visible);                            // renderer, before the submit
+ *   renderQueueSubmit(queue);
+ *
+ */
+Fleet fleetCreate(const Mesh& mesh, const std::vector<FleetPart>& parts, int count, float spacing = 12.0f,
+                  int liveries = 0);
+
+/**
+ * @brief Moves and turns all boats, in parallel on the job system.
+ *
+ * @param fleet Fleet to update.
+ * @param dt Time step in seconds.
+ */
+void fleetUpdate(Fleet& fleet, float dt);
+
+/**
+ * @brief Collects the root matrices of all boats whose bounding sphere intersects the view frustum, in parallel.
+ *
+ * @param fleet Fleet to cull.
+ * @param frustum Normalized planes of the view frustum, usually the ones cached by cameraMatrices.
+ * @param instances Root matrices of the visible boats, grown as needed.
+ * @param layers Livery layers of the visible boats in the same order, untouched without liveries.
+ *
+ * @return Number of visible boats.
+ */
+GLsizei fleetCull(Fleet& fleet, const Vector4D frustum[6], std::vector<Matrix4D>& instances,
+                  std::vector<float>& layers);
+
+/**
+ * @brief Push one instanced draw packet per part.
+ *
+ * @param fleet Fleet to draw.
+ * @param queue Render queue of the frame.
+ * @param program Program compiled with INSTANCED.
+ * @param visible Number of instances returned by fleetCull.
+ * @param view View matrix, used for the sort depth.
+ * @param texturedProgram Program compiled with INSTANCED and TEXTURED for the textured parts, program if null.
+ * @param textureArray Texture array holding the liveries.
+ */
+void fleetEnqueue(const Fleet& fleet, RenderQueue& queue, const ShaderProgram* program, GLsizei visible,
+                  const Matrix4D& view, const ShaderProgram* texturedProgram = nullptr, GLuint textureArray = 0);
+
+/**
+ * @brief Upload the instance matrices and layers, the previous buffer storage is orphaned. Has to run on the GL thread.
+ *
+ * @param fleet Fleet to draw.
+ * @param instances Root matrices returned by fleetCull.
+ * @param layers Livery layers returned by fleetCull.
+ * @param visible Number of visible boats.
+ */
+void fleetUpload(Fleet& fleet, const std::vector<Matrix4D>& instances, const std::vector<float>& layers,
+                 GLsizei visible);
+
+/**
+ * @brief Print the average per frame cost of the fleet.
+ */
+void fleetReport(const Fleet& fleet);
+
+/**
+ * @brief Cleanup and delete the vertex array and the instance buffers. The mesh buffers are not deleted.
+ */
+void fleetDelete(Fleet& fleet);
@@ -6,6 +6,11 @@
 
 #include <stb_image/stb_image_write.h>
 
+#ifdef MYGL_HAVE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
 /**
  * debugging function from Joey de Vries (LearnOpenGL)
  * https://learnopengl.com/In-Practice/Debugging
@@ -42,11 +47,13 @@ void screenshotToPNG(const std::string &filepath)
 
     std::vector<GLubyte> data(4 * nPixels);
 
-    glReadBuffer(GL_FRONT);
+    GLint readFramebuffer = 0;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFramebuffer);
+    glReadBuffer(readFramebuffer != 0 ? GL_COLOR_ATTACHMENT0 : GL_FRONT);
     glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, data.data());
 
-    stbi_flip_vertically_on_write(true);
-    stbi_write_png(filepath.c_str(), width, height, 4, data.data(), width * 4);
+    /* bottom row first, start at the last row with a negative stride instead of the global (thread-unsafe) flip flag */
+    stbi_write_png(filepath.c_str(), width, height, 4, data.data() + (height - 1) * width * 4, -width * 4);
 }
 
 void glfw_error_callback(int error, const char* description)
@@ -108,3 +115,180 @@ void windowDelete(GLFWwindow *window)
     glfwDestroyWindow(window);
     glfwTerminate();
 }
+
+namespace detail
+{
+#ifdef MYGL_HAVE_EGL
+bool eglHasExtension(const char* extensions, const std::string& name)
+{
+    if(extensions == nullptr)
+        return false;
+
+    std::istringstream stream(extensions);
+    std::string extension;
+    while(stream >> extension)
+        if(extension == name)
+            return true;
+    return false;
+}
+
+EGLDisplay eglOpenDisplay()
+{
+    /* a surfaceless platform display needs neither X11 nor a DRM device */
+    const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if(eglHasExtension(clientExtensions, "EGL_MESA_platform_surfaceless"))
+    {
+        auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if(getPlatformDisplay != nullptr)
+        {
+            EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+            if(display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr))
+                return display;
+        }
+    }
+
+    EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if(display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr))
+        return display;
+
+    return EGL_NO_DISPLAY;
+}
+
+bool eglCreate(HeadlessContext& context, unsigned int width, unsigned int height)
+{
+    EGLDisplay display = eglOpenDisplay();
+    if(display == EGL_NO_DISPLAY)
+    {
+        std::cerr << "[Headless] Couldn't open EGL display" << std::endl;
+        return false;
+    }
+
+    bool surfaceless = eglHasExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context");
+    EGLint configAttributes[] = {
+        EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint numConfigs = 0;
+    if(!eglBindAPI(EGL_OPENGL_API) || !eglChooseConfig(display, configAttributes, &config, 1, &numConfigs) || numConfigs == 0)
+    {
+        std::cerr << "[Headless] No suitable EGL config" << std::endl;
+        eglTerminate(display);
+        return false;
+    }
+
+    EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext eglContext = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+    if(eglContext == EGL_NO_CONTEXT)
+    {
+        std::cerr << "[Headless] Couldn't create EGL context" << std::endl;
+        eglTerminate(display);
+        return false;
+    }
+
+    EGLSurface surface = EGL_NO_SURFACE;
+    if(!surfaceless)
+    {
+        EGLint surfaceAttributes[] = { EGL_WIDTH, (EGLint) width, EGL_HEIGHT, (EGLint) height, EGL_NONE };
+        surface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+    }
+
+    if(!eglMakeCurrent(display, surface, surface, eglContext))
+    {
+        std::cerr << "[Headless] Couldn't make EGL context current" << std::endl;
+        if(surface != EGL_NO_SURFACE)
+            eglDestroySurface(display, surface);
+        eglDestroyContext(display, eglContext);
+        eglTerminate(display);
+        return false;
+    }
+
+    context.eglDisplay = display;
+    context.eglContext = eglContext;
+    context.eglSurface = surface;
+    context.backend = surfaceless ? "EGL surfaceless" : "EGL pbuffer";
+    return true;
+}
+#endif
+
+bool glfwCreateInvisible(HeadlessContext& context, unsigned int width, unsigned int height)
+{
+    if(!glfwInit())
+        return false;
+    glfwSetErrorCallback(glfw_error_callback);
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+    context.window = glfwCreateWindow(width, height, "headless", nullptr, nullptr);
+    if(context.window == nullptr)
+    {
+        glfwTerminate();
+        return false;
+    }
+
+    glfwMakeContextCurrent(context.window);
+    glfwSwapInterval(0);
+    context.backend = "GLFW invisible window";
+    return true;
+}
+}
+
+HeadlessContext headlessCreate(unsigned int width, unsigned int height)
+{
+    HeadlessContext context;
+    GLADloadproc loader = nullptr;
+
+#ifdef MYGL_HAVE_EGL
+    if(detail::eglCreate(context, width, height))
+        loader = (GLADloadproc) eglGetProcAddress;
+#endif
+    if(loader == nullptr && detail::glfwCreateInvisible(context, width, height))
+        loader = (GLADloadproc) glfwGetProcAddress;
+
+    if(loader == nullptr)
+    {
+        std::cerr << "[Headless] Couldn't create an offscreen GL context" << std::endl;
+        return context;
+    }
+
+    if(!gladLoadGLLoader(loader))
+    {
+        std::cerr << "[Headless] Couldn't initialize GLAD" << std::endl;
+        headlessDelete(context);
+        return context;
+    }
+
+    std::cout << "[Headless] " << context.backend << ": " << glGetString(GL_RENDERER) << " (" << glGetString(GL_VERSION) << ")" << std::endl;
+    return context;
+}
+
+void headlessDelete(HeadlessContext& context)
+{
+#ifdef MYGL_HAVE_EGL
+    if(context.eglContext != nullptr)
+    {
+        eglMakeCurrent(context.eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if(context.eglSurface != nullptr)
+            eglDestroySurface(context.eglDisplay, context.eglSurface);
+        eglDestroyContext(context.eglDisplay, context.eglContext);
+        eglTerminate(context.eglDisplay);
+    }
+#endif
+    if(context.window != nullptr)
+        windowDelete(context.window);
+
+    context = HeadlessContext();
+}
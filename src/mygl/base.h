@@ -35,8 +35,44 @@ GLFWwindow* windowCreate(const std::string &title, unsigned int width, unsigned
  */
 void windowDelete(GLFWwindow* window);
 
+struct HeadlessContext
+{
+    GLFWwindow* window = nullptr;   // invisible GLFW window, used when EGL is unavailable
+    void* eglDisplay = nullptr;     // EGLDisplay
+    void* eglContext = nullptr;     // EGLContext
+    void* eglSurface = nullptr;     // EGLSurface, only set for the pbuffer fallback
+    std::string backend;
+};
+
+/**
+ * @brief Create an OpenGL context without a visible window for offscreen rendering on servers and CI machines. Prefers
+ * an EGL surfaceless context (e.g. Mesa llvmpipe), falls back to an EGL pbuffer and finally to an invisible GLFW
+ * window. The default framebuffer of the context must not be rendered to, use a Framebuffer instead.
+ *
+ * @param width Width of the invisible window / pbuffer.
+ * @param height Height of the invisible window / pbuffer.
+ *
+ * @return Context with either window or eglContext set, both are null on failure.
+ *
+ * usage:
+ *
+ *   HeadlessContext context = headlessCreate(1280, 720);
+ *   if(context.window == nullptr && context.eglContext == nullptr) { return EXIT_FAILURE; }
+ *   ...
+ *   headlessDelete(context);
+ *
+ */
+HeadlessContext headlessCreate(unsigned int width, unsigned int height);
+/**
+ * @brief Delete the headless context. Has to be called for each headless context after it is not used anymore.
+ *
+ * @param context Headless context to delete.
+ */
+void headlessDelete(HeadlessContext& context);
+
 /**
- * @brief Save current viewport as PNG image.
+ * @brief Save current viewport as PNG image. Reads from the bound read framebuffer if one is bound, from the front
+ * buffer of the window otherwise.
  *
  * @param filepath Path to output image.
  */
@@ -18,19 +18,7 @@ Vector3D sphericalCoords(const Camera& cam)
     return Vector3D(r, phi, theta);
 }
 
-}
-
-Camera cameraCreate(float width, float height, float fov, float nearPlane, float farPlane, const Vector3D &initPos, const Vector3D &lookAt, const Vector3D &initUp)
-{
-    return {width, height, fov, nearPlane, farPlane, initPos, lookAt, initUp};
-}
-
-Matrix4D cameraProjection(const Camera &cam)
-{
-    return Matrix4D::perspective(cam.fov, cam.width/cam.height, cam.nearPlane, cam.farPlane);
-}
-
-Matrix4D cameraView(const Camera &cam)
+Matrix4D lookAtView(const Camera& cam)
 {
     Vector3D front = normalize(cam.lookAt - cam.position);
     Vector3D right = normalize(cross(front, cam.initUp));
@@ -44,7 +32,109 @@ Matrix4D cameraView(const Camera &cam)
             );
 
     return  rotation * Matrix4D::translation(-cam.position);
-} 
+}
+
+/* Gribb/Hartmann: the planes are sums/differences of the rows of the view-projection matrix */
+void extractFrustum(const Matrix4D& m, Vector4D planes[6])
+{
+    Vector4D row[4];
+    for(int i = 0; i < 4; i++)
+    {
+        row[i] = Vector4D(m(i, 0), m(i, 1), m(i, 2), m(i, 3));
+    }
+
+    planes[0] = row[3] + row[0];
+    planes[1] = row[3] - row[0];
+    planes[2] = row[3] + row[1];
+    planes[3] = row[3] - row[1];
+    planes[4] = row[3] + row[2];
+    planes[5] = row[3] - row[2];
+
+    for(int i = 0; i < 6; i++)
+    {
+        planes[i] /= length(Vector3D(planes[i]));
+    }
+}
+
+void update(const Camera& cam)
+{
+    CameraMatrices& cache = cam._cache;
+    if(!cache.viewDirty && !cache.projectionDirty)
+    {
+        return;
+    }
+
+    if(cache.viewDirty)
+    {
+        cache.view = lookAtView(cam);
+        cache.inverseView = inverse(cache.view);
+    }
+    if(cache.projectionDirty)
+    {
+        cache.projection = Matrix4D::perspective(cam.fov, cam.width/cam.height, cam.nearPlane, cam.farPlane);
+        cache.inverseProjection = inverse(cache.projection);
+    }
+
+    cache.viewProjection = cache.projection * cache.view;
+    cache.inverseViewProjection = cache.inverseView * cache.inverseProjection;
+    extractFrustum(cache.viewProjection, cache.frustum);
+
+    cache.viewDirty = false;
+    cache.projectionDirty = false;
+}
+
+}
+
+Camera cameraCreate(float width, float height, float fov, float nearPlane, float farPlane, const Vector3D &initPos, const Vector3D &lookAt, const Vector3D &initUp)
+{
+    return {width, height, fov, nearPlane, farPlane, initPos, lookAt, initUp, CameraMatrices()};
+}
+
+const Matrix4D& cameraProjection(const Camera &cam)
+{
+    detail::update(cam);
+    return cam._cache.projection;
+}
+
+const Matrix4D& cameraView(const Camera &cam)
+{
+    detail::update(cam);
+    return cam._cache.view;
+}
+
+const CameraMatrices& cameraMatrices(const Camera& cam)
+{
+    detail::update(cam);
+    return cam._cache;
+}
+
+void cameraResize(Camera& cam, float width, float height)
+{
+    if(cam.width != width || cam.height != height)
+    {
+        cam.width = width;
+        cam.height = height;
+        cam._cache.projectionDirty = true;
+    }
+}
+
+void cameraSetLookAt(Camera& cam, const Vector3D& lookAt)
+{
+    if(cam.lookAt.x != lookAt.x || cam.lookAt.y != lookAt.y || cam.lookAt.z != lookAt.z)
+    {
+        cam.lookAt = lookAt;
+        cam._cache.viewDirty = true;
+    }
+}
+
+void cameraSetPosition(Camera& cam, const Vector3D& position)
+{
+    if(cam.position.x != position.x || cam.position.y != position.y || cam.position.z != position.z)
+    {
+        cam.position = position;
+        cam._cache.viewDirty = true;
+    }
+}
 
 void cameraUpdateOrbit(Camera& cam, const Vector2D& mouseDiff, float zoom)
 {
@@ -63,4 +153,5 @@ void cameraUpdateOrbit(Camera& cam, const Vector2D& mouseDiff, float zoom)
     Vector3D cartCoord(r * sin(theta) * sin(phi), r * cos(theta), r * sin(theta) * cos(phi));
 
     cam.position = cam.lookAt + cartCoord;
+    cam._cache.viewDirty = true;
 }
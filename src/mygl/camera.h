@@ -4,6 +4,23 @@
 #include <math/vector3d.h>
 #include <math/matrix4d.h>
 
+/* derived camera state, recomputed lazily when the camera was changed through one of the camera functions */
+struct CameraMatrices
+{
+    Matrix4D view;
+    Matrix4D projection;
+    Matrix4D viewProjection;
+    Matrix4D inverseView;
+    Matrix4D inverseProjection;
+    Matrix4D inverseViewProjection;
+
+    /* left, right, bottom, top, near, far in world space; xyz is the inward normal, w the distance (dot(p, n) + w >= 0 inside) */
+    Vector4D frustum[6];
+
+    bool viewDirty = true;
+    bool projectionDirty = true;
+};
+
 struct Camera
 {
     float width;
@@ -14,6 +31,10 @@ struct Camera
     Vector3D position;
     Vector3D lookAt;
     Vector3D initUp;
+
+    /* don't write the fields above directly after creation, use cameraResize/cameraSetLookAt/cameraUpdateOrbit so the
+     * cache is invalidated */
+    mutable CameraMatrices _cache;
 };
 
 /**
@@ -33,22 +54,57 @@ struct Camera
 Camera cameraCreate(float width, float height, float fov, float nearPlane, float farPlane, const Vector3D& initPos, const Vector3D& lookAt = {0, 0, 0}, const Vector3D& initUp = {0, 1, 0});
 
 /**
- * @brief Get projection matrix from a camera.
+ * @brief Get projection matrix from a camera. Cached, only recomputed after the camera changed.
  *
  * @param cam Camera from which the projection matrix is calculated.
  *
  * @return Projection matrix.
  */
-Matrix4D cameraProjection(const Camera& cam);
+const Matrix4D& cameraProjection(const Camera& cam);
 
 /**
- * @brief Get view matrix from a camera.
+ * @brief Get view matrix from a camera. Cached, only recomputed after the camera changed.
  *
  * @param cam Camera from which the view matrix is calculated.
  *
  * @return View matrix.
  */
-Matrix4D cameraView(const Camera& cam);
+const Matrix4D& cameraView(const Camera& cam);
+
+/**
+ * @brief Get all derived matrices (view, projection, view-projection, their inverses) and the frustum planes of a
+ * camera. Everything is computed once after a change and then served from the cache.
+ *
+ * @param cam Camera.
+ *
+ * @return Up to date camera matrices.
+ */
+const CameraMatrices& cameraMatrices(const Camera& cam);
+
+/**
+ * @brief Update the image size of a camera (e.g. after the window was resized).
+ *
+ * @param cam Camera that gets updated.
+ * @param width Image width.
+ * @param height Image height.
+ */
+void cameraResize(Camera& cam, float width, float height);
+
+/**
+ * @brief Update the point a camera is looking at.
+ *
+ * @param cam Camera that gets updated.
+ * @param lookAt Point at which the camera is looking at.
+ */
+void cameraSetLookAt(Camera& cam, const Vector3D& lookAt);
+
+/**
+ * @brief Move the camera to a new position, the look at point stays the same.
+ *
+ * @param cam Camera that gets updated.
+ * @param position New camera position.
+ */
+void cameraSetPosition(Camera& cam, const Vector3D& position);
 
 /**
  * @brief Update camera position on the orbit around the look at point using spherical coordinates.
@@ -0,0 +1,150 @@
+#include "dynamicresolution.h"
+#include "glstate.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace detail
+{
+/* average the GPU time of the interval and move the scale towards the one that meets the budget */
+bool resolutionAdjust(DynamicResolution& resolution)
+{
+    const DynamicResolutionSettings& settings = resolution.settings;
+    resolution.gpuMs = resolution.gpuSumMs / resolution.gpuSamples;
+    resolution.gpuSumMs = 0.0;
+    resolution.gpuSamples = 0;
+
+    double gpuMs = resolution.gpuMs;
+    if(gpuMs <= settings.targetMs * (1.0 + settings.hysteresis) && gpuMs >= settings.targetMs * (1.0 - settings.hysteresis))
+        return false;
+
+    /* the cost grows with the pixel count, i.e. with the square of the scale; snap to 5% steps against flicker */
+    float ideal = gpuMs > 0.0 ? float(resolution.scale * std::sqrt(settings.targetMs / gpuMs)) : settings.maxScale;
+    float scale = std::clamp(std::round(ideal * 20.0f) / 20.0f, settings.minScale, settings.maxScale);
+    if(scale == resolution.scale)
+        return false;
+
+    resolution.scale = scale;
+    resolution.adjustments++;
+    return true;
+}
+}
+
+DynamicResolution dynamicResolutionCreate(const DynamicResolutionSettings& settings)
+{
+    DynamicResolution resolution;
+    resolution.settings = settings;
+    resolution.settings.minScale = std::clamp(settings.minScale, 0.1f, 1.0f);
+    resolution.settings.maxScale = std::clamp(settings.maxScale, resolution.settings.minScale, 1.0f);
+    resolution.settings.interval = std::max(settings.interval, 1);
+    resolution.scale = resolution.settings.maxScale;
+
+    resolution.timing = GLAD_GL_ARB_timer_query;
+    if(resolution.timing)
+    {
+        glGenQueries(DynamicResolution::kLatency * 2, &resolution.queries[0][0]);
+    }
+    else
+    {
+        std::cerr << "[DynamicResolution] No timer queries (ARB_timer_query), the scale stays at " << resolution.scale
+                  << std::endl;
+    }
+    return resolution;
+}
+
+void dynamicResolutionBegin(DynamicResolution& resolution, GLuint output, int width, int height)
+{
+    /* the framebuffer covers the maximum scale of the current output size */
+    if(width != resolution.outputWidth || height != resolution.outputHeight || resolution.framebuffer.id == 0)
+    {
+        if(resolution.framebuffer.id != 0)
+        {
+            framebufferDelete(resolution.framebuffer);
+        }
+        resolution.framebuffer = framebufferCreate(std::max(int(std::ceil(width * resolution.settings.maxScale)), 1),
+                                                   std::max(int(std::ceil(height * resolution.settings.maxScale)), 1));
+        resolution.outputWidth = width;
+        resolution.outputHeight = height;
+    }
+    resolution.output = output;
+    resolution.width = std::clamp(int(std::round(width * resolution.scale)), 1, resolution.framebuffer.width);
+    resolution.height = std::clamp(int(std::round(height * resolution.scale)), 1, resolution.framebuffer.height);
+
+    /* read the timestamps of the frame that used this slot before, they are late enough to be available */
+    GLuint* queries = resolution.queries[resolution.frame % DynamicResolution::kLatency];
+    if(resolution.timing && resolution.frame >= DynamicResolution::kLatency)
+    {
+        GLint available = 0;
+        glGetQueryObjectiv(queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if(available)
+        {
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &end);
+            if(end >= begin)
+            {
+                resolution.gpuSumMs += (end - begin) / 1e6;
+                resolution.gpuSamples++;
+            }
+        }
+    }
+    if(resolution.timing)
+    {
+        glQueryCounter(queries[0], GL_TIMESTAMP);
+    }
+
+    glStateBindFramebuffer(GL_FRAMEBUFFER, resolution.framebuffer.id);
+    glStateViewport(0, 0, resolution.width, resolution.height);
+}
+
+bool dynamicResolutionEnd(DynamicResolution& resolution)
+{
+    /* stretch the rendered part to the whole output */
+    glStateBindFramebuffer(GL_READ_FRAMEBUFFER, resolution.framebuffer.id);
+    glStateBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolution.output);
+    glBlitFramebuffer(0, 0, resolution.width, resolution.height, 0, 0, resolution.outputWidth, resolution.outputHeight,
+                      GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    glStateBindFramebuffer(GL_FRAMEBUFFER, resolution.output);
+    glStateViewport(0, 0, resolution.outputWidth, resolution.outputHeight);
+
+    if(resolution.timing)
+    {
+        glQueryCounter(resolution.queries[resolution.frame % DynamicResolution::kLatency][1], GL_TIMESTAMP);
+    }
+    resolution.frame++;
+
+    resolution.frames++;
+    resolution.scaleSum += resolution.scale;
+    resolution.scaleMin = std::min(resolution.scaleMin, resolution.scale);
+    resolution.scaleMax = std::max(resolution.scaleMax, resolution.scale);
+
+    if(resolution.gpuSamples >= resolution.settings.interval)
+    {
+        return detail::resolutionAdjust(resolution);
+    }
+    return false;
+}
+
+void dynamicResolutionReport(const DynamicResolution& resolution)
+{
+    if(resolution.frames == 0) { return; }
+
+    std::cout << "[DynamicResolution] Scale avg " << resolution.scaleSum / resolution.frames << " (min "
+              << resolution.scaleMin << ", max " << resolution.scaleMax << "), " << resolution.adjustments
+              << " adjustments, last GPU time " << resolution.gpuMs << " ms for a budget of "
+              << resolution.settings.targetMs << " ms" << std::endl;
+}
+
+void dynamicResolutionDelete(DynamicResolution& resolution)
+{
+    if(resolution.framebuffer.id != 0)
+    {
+        framebufferDelete(resolution.framebuffer);
+        resolution.framebuffer = Framebuffer();
+    }
+    if(resolution.timing)
+    {
+        glDeleteQueries(DynamicResolution::kLatency * 2, &resolution.queries[0][0]);
+    }
+}
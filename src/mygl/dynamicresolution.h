@@ -0,0 +1,104 @@
+#pragma once
+
+#include "base.h"
+#include "framebuffer.h"
+
+#include <cstdint>
+
+struct DynamicResolutionSettings
+{
+    double targetMs = 16.0;         // GPU time budget per frame
+    float minScale = 0.5f;          // bounds of the scale of each axis
+    float maxScale = 1.0f;
+    float hysteresis = 0.1f;        // the GPU time has to leave target * (1 +- hysteresis) before the scale changes
+    int interval = 8;               // frames averaged per adjustment
+};
+
+/**
+ * Dynamic resolution scaling. The scene is rendered into an offscreen framebuffer at a fraction of the output size and
+ * stretched to the output with a linear blit. Every few frames the average GPU time of the frame is compared to the
+ * budget and the scale is moved towards the one that meets it, assuming the cost is proportional to the pixel count.
+ *
+ * The GPU time is measured with timestamp queries around the frame, they are read back a few frames later so the
+ * measurement never stalls, and they don't interfere with the GL_TIME_ELAPSED queries of the profiler.
+ */
+struct DynamicResolution
+{
+    DynamicResolutionSettings settings;
+    float scale = 1.0f;
+
+    /* allocated at maxScale times the output size, a lower scale only renders into a part of it */
+    Framebuffer framebuffer;
+    GLuint output = 0;
+    int outputWidth = 0;
+    int outputHeight = 0;
+    int width = 0;                  // size rendered this frame
+    int height = 0;
+
+    /* timestamps at the begin and end of the last frames */
+    static const int kLatency = 4;
+    GLuint queries[kLatency][2] = {};
+    uint64_t frame = 0;
+    bool timing = false;
+    double gpuSumMs = 0.0;
+    int gpuSamples = 0;
+    double gpuMs = 0.0;             // average of the last adjustment interval
+
+    /* statistics */
+    uint64_t frames = 0;
+    double scaleSum = 0.0;
+    float scaleMin = 1.0f;
+    float scaleMax = 0.0f;
+    int adjustments = 0;
+};
+
+/**
+ * @brief Create the timestamp queries, the framebuffer is created on the first frame.
+ *
+ * @param settings Budget, bounds and hysteresis.
+ *
+ * @return Initialized dynamic resolution, starting at the maximum scale.
+ *
+ * usage:
+ *
+ *   DynamicResolution resolution = dynamicResolutionCreate(settings);
+ *   while(...)
+ *   {
+ *       dynamicResolutionBegin(resolution, 0, windowWidth, windowHeight);
+ *       draw();
+ *       dynamicResolutionEnd(resolution);          // upscales into framebuffer 0
+ *       glfwSwapBuffers(window);
+ *   }
+ *   dynamicResolutionDelete(resolution);
+ *
+ */
+DynamicResolution dynamicResolutionCreate(const DynamicResolutionSettings& settings);
+
+/**
+ * @brief Bind the offscreen framebuffer and set the viewport to the scaled size.
+ *
+ * @param resolution Dynamic resolution.
+ * @param output Framebuffer the frame is presented in, 0 for the window.
+ * @param width Width of the output.
+ * @param height Height of the output.
+ */
+void dynamicResolutionBegin(DynamicResolution& resolution, GLuint output, int width, int height);
+
+/**
+ * @brief Upscale the frame into the output framebuffer, bind it again and adjust the scale of the next frames.
+ *
+ * @param resolution Dynamic resolution.
+ *
+ * @return True if the scale changed.
+ */
+bool dynamicResolutionEnd(DynamicResolution& resolution);
+
+/**
+ * @brief Print the scale statistics.
+ */
+void dynamicResolutionReport(const DynamicResolution& resolution);
+
+/**
+ * @brief Cleanup and delete the framebuffer and the queries.
+ */
+void dynamicResolutionDelete(DynamicResolution& resolution);
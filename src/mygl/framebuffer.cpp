@@ -0,0 +1,54 @@
+#include "framebuffer.h"
+#include "glstate.h"
+
+#include <iostream>
+#include <stdexcept>
+
+Framebuffer framebufferCreate(int width, int height)
+{
+    Framebuffer framebuffer;
+    framebuffer.width = width;
+    framebuffer.height = height;
+
+    glGenTextures(1, &framebuffer.color);
+    glStateBindTexture(0, GL_TEXTURE_2D, framebuffer.color);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenRenderbuffers(1, &framebuffer.depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, framebuffer.depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &framebuffer.id);
+    glStateBindFramebuffer(GL_FRAMEBUFFER, framebuffer.id);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, framebuffer.color, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, framebuffer.depth);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glStateBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glCheckError();
+
+    if(status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cerr << "[Framebuffer] Framebuffer incomplete (status " << std::hex << status << std::dec << ")" << std::endl;
+        std::cerr.flush();
+        framebufferDelete(framebuffer);
+        throw std::runtime_error("[Framebuffer] Framebuffer incomplete");
+    }
+
+    return framebuffer;
+}
+
+void framebufferDelete(const Framebuffer& framebuffer)
+{
+    glStateForgetFramebuffer(framebuffer.id);
+    glStateForgetTexture(framebuffer.color);
+
+    glDeleteFramebuffers(1, &framebuffer.id);
+    glDeleteRenderbuffers(1, &framebuffer.depth);
+    glDeleteTextures(1, &framebuffer.color);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "base.h"
+
+struct Framebuffer
+{
+    GLuint id = 0;
+    GLuint color = 0;       // RGBA8 texture
+    GLuint depth = 0;       // depth renderbuffer
+    int width = 0;
+    int height = 0;
+};
+
+/**
+ * @brief Creates a framebuffer object with an RGBA8 color texture and a 24 bit depth buffer for offscreen rendering.
+ *
+ * @param width Width in pixels.
+ * @param height Height in pixels.
+ *
+ * @return Initialized framebuffer.
+ *
+ * usage:
+ *
+ *   Framebuffer offscreen = framebufferCreate(1920, 1080);
+ *   glStateBindFramebuffer(GL_FRAMEBUFFER, offscreen.id);
+ *   glStateViewport(0, 0, offscreen.width, offscreen.height);
+ *
+ */
+Framebuffer framebufferCreate(int width, int height);
+
+/**
+ * @brief Cleanup and delete the framebuffer and its attachments. Has to be called for each framebuffer after it is not
+ * used anymore.
+ *
+ * @param framebuffer Framebuffer to delete.
+ */
+void framebufferDelete(const Framebuffer& framebuffer);
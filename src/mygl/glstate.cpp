@@ -0,0 +1,310 @@
+#include "glstate.h"
+
+namespace detail
+{
+    /* value that never matches a real object or state, forces the next call to be issued */
+    const GLuint unknown = 0xFFFFFFFF;
+    const unsigned int textureUnits = 16;
+
+    enum BufferSlot { ArrayBuffer, ElementBuffer, UniformBuffer, PackBuffer, UnpackBuffer, BufferSlots };
+    enum Capability { DepthTest, Blend, CullFace, Capabilities };
+
+    struct State
+    {
+        GLuint program;
+        GLuint vertexArray;
+        GLuint buffers[BufferSlots];
+        GLuint drawFramebuffer;
+        GLuint readFramebuffer;
+        GLuint activeTexture;
+        GLuint textures2D[textureUnits];
+        GLuint texturesArray[textureUnits];
+        GLuint capabilities[Capabilities];
+        GLuint depthMask;
+        GLenum blendSource;
+        GLenum blendDestination;
+        GLint viewport[4];
+    };
+
+    State makeUnknown()
+    {
+        State state;
+        state.program = unknown;
+        state.vertexArray = unknown;
+        for(GLuint& buffer : state.buffers) { buffer = unknown; }
+        state.drawFramebuffer = unknown;
+        state.readFramebuffer = unknown;
+        state.activeTexture = unknown;
+        for(GLuint& texture : state.textures2D) { texture = unknown; }
+        for(GLuint& texture : state.texturesArray) { texture = unknown; }
+        for(GLuint& capability : state.capabilities) { capability = unknown; }
+        state.depthMask = unknown;
+        state.blendSource = unknown;
+        state.blendDestination = unknown;
+        for(GLint& v : state.viewport) { v = -1; }
+        return state;
+    }
+
+    State state = makeUnknown();
+    GLStateStats frameStats;
+    GLStateStats totalStats;
+
+    void issued()
+    {
+        frameStats.issued++;
+        totalStats.issued++;
+    }
+
+    void elided()
+    {
+        frameStats.elided++;
+        totalStats.elided++;
+    }
+
+    /* returns true if the call has to be issued and updates the shadow value */
+    template<typename T>
+    bool change(T& shadow, T value)
+    {
+        if(shadow == value)
+        {
+            elided();
+            return false;
+        }
+        shadow = value;
+        issued();
+        return true;
+    }
+
+    int bufferSlot(GLenum target)
+    {
+        switch(target)
+        {
+            case GL_ARRAY_BUFFER:           return ArrayBuffer;
+            case GL_ELEMENT_ARRAY_BUFFER:   return ElementBuffer;
+            case GL_UNIFORM_BUFFER:         return UniformBuffer;
+            case GL_PIXEL_PACK_BUFFER:      return PackBuffer;
+            case GL_PIXEL_UNPACK_BUFFER:    return UnpackBuffer;
+        }
+        return -1;
+    }
+
+    int capabilitySlot(GLenum capability)
+    {
+        switch(capability)
+        {
+            case GL_DEPTH_TEST: return DepthTest;
+            case GL_BLEND:      return Blend;
+            case GL_CULL_FACE:  return CullFace;
+        }
+        return -1;
+    }
+}
+
+void glStateInvalidate()
+{
+    detail::state = detail::makeUnknown();
+}
+
+void glStateNewFrame()
+{
+    detail::frameStats = GLStateStats();
+}
+
+GLStateStats glStateFrameStats()
+{
+    return detail::frameStats;
+}
+
+GLStateStats glStateTotalStats()
+{
+    return detail::totalStats;
+}
+
+void glStateUseProgram(GLuint program)
+{
+    if(detail::change(detail::state.program, program))
+    {
+        glUseProgram(program);
+    }
+}
+
+void glStateBindVertexArray(GLuint vao)
+{
+    if(detail::change(detail::state.vertexArray, vao))
+    {
+        glBindVertexArray(vao);
+        /* the element buffer binding is part of the vertex array state */
+        detail::state.buffers[detail::ElementBuffer] = detail::unknown;
+    }
+}
+
+void glStateBindBuffer(GLenum target, GLuint buffer)
+{
+    int slot = detail::bufferSlot(target);
+    if(slot < 0)
+    {
+        detail::issued();
+        glBindBuffer(target, buffer);
+        return;
+    }
+    if(detail::change(detail::state.buffers[slot], buffer))
+    {
+        glBindBuffer(target, buffer);
+    }
+}
+
+void glStateBindFramebuffer(GLenum target, GLuint framebuffer)
+{
+    bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+    bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+
+    if(draw && read)
+    {
+        if(detail::state.drawFramebuffer == framebuffer && detail::state.readFramebuffer == framebuffer)
+        {
+            detail::elided();
+            return;
+        }
+        detail::issued();
+        detail::state.drawFramebuffer = framebuffer;
+        detail::state.readFramebuffer = framebuffer;
+        glBindFramebuffer(target, framebuffer);
+        return;
+    }
+    GLuint& shadow = draw ? detail::state.drawFramebuffer : detail::state.readFramebuffer;
+    if(detail::change(shadow, framebuffer))
+    {
+        glBindFramebuffer(target, framebuffer);
+    }
+}
+
+void glStateBindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+    GLuint* shadow = nullptr;
+    if(unit < detail::textureUnits)
+    {
+        if(target == GL_TEXTURE_2D)
+        {
+            shadow = &detail::state.textures2D[unit];
+        }
+        else if(target == GL_TEXTURE_2D_ARRAY)
+        {
+            shadow = &detail::state.texturesArray[unit];
+        }
+    }
+
+    if(shadow && *shadow == texture)
+    {
+        detail::elided();
+        return;
+    }
+    if(detail::change(detail::state.activeTexture, unit))
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+    if(shadow)
+    {
+        *shadow = texture;
+    }
+    detail::issued();
+    glBindTexture(target, texture);
+}
+
+void glStateEnable(GLenum capability, bool enabled)
+{
+    int slot = detail::capabilitySlot(capability);
+    if(slot >= 0 && !detail::change(detail::state.capabilities[slot], static_cast<GLuint>(enabled)))
+    {
+        return;
+    }
+    if(slot < 0)
+    {
+        detail::issued();
+    }
+
+    if(enabled)
+    {
+        glEnable(capability);
+    }
+    else
+    {
+        glDisable(capability);
+    }
+}
+
+void glStateDepthMask(GLboolean mask)
+{
+    if(detail::change(detail::state.depthMask, static_cast<GLuint>(mask)))
+    {
+        glDepthMask(mask);
+    }
+}
+
+void glStateBlendFunc(GLenum source, GLenum destination)
+{
+    if(detail::state.blendSource == source && detail::state.blendDestination == destination)
+    {
+        detail::elided();
+        return;
+    }
+    detail::issued();
+    detail::state.blendSource = source;
+    detail::state.blendDestination = destination;
+    glBlendFunc(source, destination);
+}
+
+void glStateViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    GLint* v = detail::state.viewport;
+    if(v[0] == x && v[1] == y && v[2] == width && v[3] == height)
+    {
+        detail::elided();
+        return;
+    }
+    detail::issued();
+    v[0] = x; v[1] = y; v[2] = width; v[3] = height;
+    glViewport(x, y, width, height);
+}
+
+void glStateForgetProgram(GLuint program)
+{
+    if(detail::state.program == program)
+    {
+        detail::state.program = detail::unknown;
+    }
+}
+
+void glStateForgetVertexArray(GLuint vao)
+{
+    if(detail::state.vertexArray == vao)
+    {
+        detail::state.vertexArray = detail::unknown;
+        detail::state.buffers[detail::ElementBuffer] = detail::unknown;
+    }
+}
+
+void glStateForgetBuffer(GLuint buffer)
+{
+    for(GLuint& shadow : detail::state.buffers)
+    {
+        if(shadow == buffer)
+        {
+            shadow = detail::unknown;
+        }
+    }
+}
+
+void glStateForgetFramebuffer(GLuint framebuffer)
+{
+    if(detail::state.drawFramebuffer == framebuffer) { detail::state.drawFramebuffer = detail::unknown; }
+    if(detail::state.readFramebuffer == framebuffer) { detail::state.readFramebuffer = detail::unknown; }
+}
+
+void glStateForgetTexture(GLuint texture)
+{
+    for(unsigned int i = 0; i < detail::textureUnits; i++)
+    {
+        if(detail::state.textures2D[i] == texture) { detail::state.textures2D[i] = detail::unknown; }
+        if(detail::state.texturesArray[i] == texture) { detail::state.texturesArray[i] = detail::unknown; }
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "base.h"
+
+/* calls that reached the driver vs. calls skipped because they wouldn't have changed anything */
+struct GLStateStats
+{
+    unsigned int issued = 0;
+    unsigned int elided = 0;
+};
+
+/**
+ * Thin state cache in front of the OpenGL binding and fixed function state calls. Every function shadows the value it
+ * sets and only calls OpenGL if the value changes. All code that changes these states has to go through these
+ * functions (or call glStateInvalidate afterwards), otherwise the shadow copy gets out of sync.
+ *
+ * usage:
+ *
+ *   glStateUseProgram(program.id);          // issued
+ *   glStateBindVertexArray(mesh.vao);       // issued
+ *   glStateBindVertexArray(mesh.vao);       // elided
+ *
+ */
+
+/**
+ * @brief Forget all shadowed state, the next call of every function is issued. Call after code that changed state
+ * behind the back of the cache.
+ */
+void glStateInvalidate();
+
+/**
+ * @brief Resets the per-frame counters, call once at the beginning of each frame.
+ */
+void glStateNewFrame();
+
+/**
+ * @brief Counters of the current frame (since the last glStateNewFrame).
+ */
+GLStateStats glStateFrameStats();
+
+/**
+ * @brief Counters since program start.
+ */
+GLStateStats glStateTotalStats();
+
+void glStateUseProgram(GLuint program);
+void glStateBindVertexArray(GLuint vao);
+
+/**
+ * @brief Binds a buffer. Supported targets: GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER (shadowed per vertex array),
+ * GL_UNIFORM_BUFFER, GL_PIXEL_PACK_BUFFER, GL_PIXEL_UNPACK_BUFFER; other targets are always issued.
+ */
+void glStateBindBuffer(GLenum target, GLuint buffer);
+
+/**
+ * @brief Binds a framebuffer to GL_FRAMEBUFFER, GL_DRAW_FRAMEBUFFER or GL_READ_FRAMEBUFFER.
+ */
+void glStateBindFramebuffer(GLenum target, GLuint framebuffer);
+
+/**
+ * @brief Binds a texture to a texture unit. Supported targets: GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY.
+ *
+ * @param unit Texture unit index (not GL_TEXTURE0 + unit).
+ * @param target Texture target.
+ * @param texture Texture object.
+ */
+void glStateBindTexture(GLuint unit, GLenum target, GLuint texture);
+
+/**
+ * @brief glEnable/glDisable for GL_DEPTH_TEST, GL_BLEND and GL_CULL_FACE; other capabilities are always issued.
+ */
+void glStateEnable(GLenum capability, bool enabled);
+
+void glStateDepthMask(GLboolean mask);
+void glStateBlendFunc(GLenum source, GLenum destination);
+void glStateViewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+/**
+ * @brief Has to be called before deleting an object that may be bound, OpenGL unbinds deleted objects implicitly.
+ */
+void glStateForgetProgram(GLuint program);
+void glStateForgetVertexArray(GLuint vao);
+void glStateForgetBuffer(GLuint buffer);
+void glStateForgetFramebuffer(GLuint framebuffer);
+void glStateForgetTexture(GLuint texture);
@@ -1,4 +1,5 @@
 #include "mesh.h"
+#include "glstate.h"
 
 Mesh meshCreate(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices, GLenum vertexBufferUsage, GLenum indexBufferUsage)
 {
@@ -8,13 +9,13 @@ Mesh meshCreate(const std::vector<Vertex> &vertices, const std::vector<unsigned
     glGenBuffers(1, &vbo);
     glGenBuffers(1, &ebo);
 
-    glBindVertexArray(vao);
+    glStateBindVertexArray(vao);
     {
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glStateBindBuffer(GL_ARRAY_BUFFER, vbo);
         glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), vertexBufferUsage);
         glCheckError();
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        glStateBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), indexBufferUsage);
         glCheckError();
 
@@ -25,9 +26,9 @@ Mesh meshCreate(const std::vector<Vertex> &vertices, const std::vector<unsigned
         glCheckError();
     }
 
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glStateBindVertexArray(0);
+    glStateBindBuffer(GL_ARRAY_BUFFER, 0);
+    glStateBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
     return Mesh{vao, vbo, ebo, (unsigned int) vertices.size(), (unsigned int) indices.size()};
 }
@@ -45,13 +46,13 @@ Mesh meshCreate(const std::vector<Vector3D>& positions, const std::vector<unsign
         vertices[i] = {positions[i], color};
     }
 
-    glBindVertexArray(vao);
+    glStateBindVertexArray(vao);
     {
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glStateBindBuffer(GL_ARRAY_BUFFER, vbo);
         glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), vertexBufferUsage);
         glCheckError();
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        glStateBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), indexBufferUsage);
         glCheckError();
 
@@ -62,15 +63,27 @@ Mesh meshCreate(const std::vector<Vector3D>& positions, const std::vector<unsign
         glCheckError();
     }
 
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glStateBindVertexArray(0);
+    glStateBindBuffer(GL_ARRAY_BUFFER, 0);
+    glStateBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
     return Mesh{vao, vbo, ebo, (unsigned int) vertices.size(), (unsigned int) indices.size()};
 }
 
+void meshUpdateVertices(const Mesh& mesh, const std::vector<Vertex>& vertices)
+{
+    GLsizeiptr size = vertices.size() * sizeof(Vertex);
+    glStateBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+    glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, size, vertices.data());
+    glCheckError();
+}
+
 void meshDelete(const Mesh &mesh)
 {
+    glStateForgetVertexArray(mesh.vao);
+    glStateForgetBuffer(mesh.vbo);
+    glStateForgetBuffer(mesh.ebo);
     glDeleteBuffers(1, &mesh.vbo);
     glDeleteBuffers(1, &mesh.ebo);
     glDeleteVertexArrays(1, &mesh.vao);
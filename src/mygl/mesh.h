@@ -4,7 +4,7 @@
 
 #include <vector>
 
-enum eDataIdx { Position = 0, Color = 1 };
+enum eDataIdx { Position = 0, Color = 1, Instance = 2, Layer = 6 };     // Instance: mat4 in 2-5 for instanced draws, Layer: texture array layer per instance
 
 struct Vertex
 {
@@ -64,6 +64,15 @@ Mesh meshCreate(const std::vector<Vertex>& vertices, const std::vector<unsigned
  */
 Mesh meshCreate(const std::vector<Vector3D>& positions, const std::vector<unsigned int>& indices, const Vector4D& color, GLenum vertexBufferUsage, GLenum indexBufferUsage);
 
+/**
+ * @brief Replace the vertex data of a mesh created with GL_DYNAMIC_DRAW. The previous buffer storage is orphaned, so the
+ * upload doesn't wait for draws that still read the old vertices.
+ *
+ * @param mesh Mesh to update.
+ * @param vertices New vertices, the count has to match the one the mesh was created with.
+ */
+void meshUpdateVertices(const Mesh& mesh, const std::vector<Vertex>& vertices);
+
 /**
  * @brief Cleanup and delete all OpenGL buffers of a mesh. Has to be called for each mesh after it is not used anymore.
  *
@@ -0,0 +1,176 @@
+#include "pacing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace detail
+{
+double pacingMs(std::chrono::steady_clock::duration duration)
+{
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+/* upper edge of the bin that contains the given fraction of the intervals, at most the longest interval */
+double pacingPercentile(const FramePacing& pacing, double fraction)
+{
+    uint64_t rank = uint64_t(std::ceil(fraction * pacing.count));
+    uint64_t seen = 0;
+    for(int i = 0; i < FramePacing::kBins; i++)
+    {
+        seen += pacing.bins[i];
+        if(seen >= rank && seen > 0)
+            return std::min((i + 1) * FramePacing::kBinMs, pacing.maxMs);
+    }
+    return pacing.maxMs;
+}
+}
+
+PresentMode presentModeSet(PresentMode mode)
+{
+    if(mode == PresentMode::Adaptive && !glfwExtensionSupported("WGL_EXT_swap_control_tear")
+       && !glfwExtensionSupported("GLX_EXT_swap_control_tear"))
+    {
+        std::cerr << "[Pacing] Adaptive sync is not supported (no swap_control_tear), using vsync" << std::endl;
+        mode = PresentMode::Vsync;
+    }
+
+    glfwSwapInterval(mode == PresentMode::Vsync ? 1 : mode == PresentMode::Adaptive ? -1 : 0);
+    return mode;
+}
+
+const char* presentModeName(PresentMode mode)
+{
+    switch(mode)
+    {
+        case PresentMode::Vsync: return "vsync";
+        case PresentMode::Adaptive: return "adaptive";
+        case PresentMode::Uncapped: return "uncapped";
+    }
+    return "unknown";
+}
+
+bool presentModeParse(const std::string& name, PresentMode& mode)
+{
+    for(PresentMode candidate : {PresentMode::Vsync, PresentMode::Adaptive, PresentMode::Uncapped})
+    {
+        if(name == presentModeName(candidate))
+        {
+            mode = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+void frameLimiterSetFps(FrameLimiter& limiter, double fps)
+{
+    limiter.fps = std::max(fps, 0.0);
+    limiter.deadline = std::chrono::steady_clock::now();
+}
+
+void frameLimiterWait(FrameLimiter& limiter)
+{
+    if(limiter.fps <= 0.0) { return; }
+
+    using clock = std::chrono::steady_clock;
+    auto period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / limiter.fps));
+    limiter.deadline += period;
+
+    /* more than a frame behind (breakpoint, hitch), start over instead of rushing the next frames */
+    auto now = clock::now();
+    if(limiter.deadline + period < now)
+    {
+        limiter.deadline = now;
+        return;
+    }
+
+    /* coarse sleeps while a sleep is very likely to end before the deadline */
+    double remaining = detail::pacingMs(limiter.deadline - now);
+    double estimate = limiter.sleepMean + std::sqrt(limiter.sleepM2 / limiter.sleepCount);
+    while(remaining > estimate)
+    {
+        auto start = clock::now();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        double slept = detail::pacingMs(clock::now() - start);
+        remaining -= slept;
+
+        /* restart the statistics now and then, so they follow changes of the system load */
+        if(limiter.sleepCount > 10000)
+        {
+            limiter.sleepCount = 1;
+            limiter.sleepM2 = 0.0;
+        }
+        limiter.sleepCount++;
+        double delta = slept - limiter.sleepMean;
+        limiter.sleepMean += delta / limiter.sleepCount;
+        limiter.sleepM2 += delta * (slept - limiter.sleepMean);
+        estimate = limiter.sleepMean + std::sqrt(limiter.sleepM2 / limiter.sleepCount);
+    }
+
+    /* spin for the rest */
+    while(clock::now() < limiter.deadline)
+    {
+        std::this_thread::yield();
+    }
+}
+
+void pacingRecord(FramePacing& pacing)
+{
+    auto now = std::chrono::steady_clock::now();
+    if(pacing.last != std::chrono::steady_clock::time_point())
+    {
+        double ms = detail::pacingMs(now - pacing.last);
+        int bin = std::min(int(ms / FramePacing::kBinMs), FramePacing::kBins - 1);
+        pacing.bins[bin]++;
+        pacing.minMs = pacing.count == 0 ? ms : std::min(pacing.minMs, ms);
+        pacing.maxMs = std::max(pacing.maxMs, ms);
+        pacing.sumMs += ms;
+        pacing.sumSquaresMs += ms * ms;
+        pacing.count++;
+    }
+    pacing.last = now;
+}
+
+void pacingReport(FramePacing& pacing, double targetMs)
+{
+    if(pacing.count == 0) { return; }
+
+    double mean = pacing.sumMs / pacing.count;
+    double deviation = std::sqrt(std::max(pacing.sumSquaresMs / pacing.count - mean * mean, 0.0));
+    std::cout << "[Pacing] " << pacing.count << " frames, avg " << mean << " ms (" << 1000.0 / mean << " fps), stddev "
+              << deviation << " ms, min " << pacing.minMs << " ms, p50 " << detail::pacingPercentile(pacing, 0.5)
+              << " ms, p95 " << detail::pacingPercentile(pacing, 0.95) << " ms, p99 "
+              << detail::pacingPercentile(pacing, 0.99) << " ms, max " << pacing.maxMs << " ms";
+    if(targetMs > 0.0)
+    {
+        /* a frame is late if it took more than 10% longer than intended */
+        uint64_t late = 0;
+        for(int i = 0; i < FramePacing::kBins; i++)
+        {
+            if(i * FramePacing::kBinMs >= targetMs * 1.1) { late += pacing.bins[i]; }
+        }
+        std::cout << ", " << late << " late for " << targetMs << " ms";
+    }
+    std::cout << std::endl;
+
+    uint64_t peak = *std::max_element(pacing.bins, pacing.bins + FramePacing::kBins);
+    for(int i = 0; i < FramePacing::kBins; i++)
+    {
+        if(pacing.bins[i] == 0) { continue; }
+        int bar = int(std::max<uint64_t>(pacing.bins[i] * 50 / peak, 1));
+        char range[32];
+        if(i == FramePacing::kBins - 1)
+            std::snprintf(range, sizeof(range), "%5.1f+        ms", i * FramePacing::kBinMs);
+        else
+            std::snprintf(range, sizeof(range), "%5.1f - %5.1f ms", i * FramePacing::kBinMs, (i + 1) * FramePacing::kBinMs);
+        std::cout << "  " << range << " |" << std::string(bar, '#') << " " << pacing.bins[i] << std::endl;
+    }
+
+    std::chrono::steady_clock::time_point last = pacing.last;
+    pacing = FramePacing();
+    pacing.last = last;
+}
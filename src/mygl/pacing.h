@@ -0,0 +1,105 @@
+#pragma once
+
+#include "base.h"
+
+#include <chrono>
+#include <cstdint>
+
+enum class PresentMode
+{
+    Vsync,          // swap interval 1, waits for the vertical blank
+    Adaptive,       // swap interval -1, tears instead of waiting a whole refresh when a frame is late
+    Uncapped,       // swap interval 0, measures the real throughput
+};
+
+/**
+ * Frame limiter that targets an arbitrary rate independent of the display. Sleeping is only accurate to the scheduler
+ * granularity, so it sleeps in 1 ms steps while the remaining time exceeds the mean plus one standard deviation of the
+ * observed sleep durations and spins for the rest. The deadline advances by one period per frame, so short overshoots
+ * are compensated by the next frame instead of accumulating.
+ */
+struct FrameLimiter
+{
+    double fps = 0.0;                           // 0 disables the limiter
+    std::chrono::steady_clock::time_point deadline;
+
+    /* statistics of the actual duration of a 1 ms sleep (Welford), in milliseconds */
+    double sleepMean = 1.0;
+    double sleepM2 = 0.0;
+    uint64_t sleepCount = 1;
+};
+
+/* distribution of the intervals between presented frames */
+struct FramePacing
+{
+    static const int kBins = 100;               // 0.5 ms bins, the last one collects everything above 49.5 ms
+    static constexpr double kBinMs = 0.5;
+
+    uint64_t bins[kBins] = {};
+    uint64_t count = 0;
+    double sumMs = 0.0;
+    double sumSquaresMs = 0.0;
+    double minMs = 0.0;
+    double maxMs = 0.0;
+    std::chrono::steady_clock::time_point last;
+};
+
+/**
+ * @brief Set the swap interval of the current context. Adaptive sync needs WGL/GLX_EXT_swap_control_tear and falls back
+ * to vsync without it.
+ *
+ * @param mode Requested present mode.
+ *
+ * @return Present mode in effect.
+ */
+PresentMode presentModeSet(PresentMode mode);
+
+/**
+ * @brief Name of a present mode as used on the command line ("vsync", "adaptive", "uncapped").
+ */
+const char* presentModeName(PresentMode mode);
+
+/**
+ * @brief Parse the name of a present mode.
+ *
+ * @return False for unknown names.
+ */
+bool presentModeParse(const std::string& name, PresentMode& mode);
+
+/**
+ * @brief Change the target rate of the limiter, the next deadline is one period from now.
+ *
+ * @param limiter Limiter to change.
+ * @param fps Frames per second, 0 disables the limiter.
+ */
+void frameLimiterSetFps(FrameLimiter& limiter, double fps);
+
+/**
+ * @brief Wait until the deadline of the current frame. Call once per frame after the swap.
+ *
+ * usage:
+ *
+ *   FrameLimiter limiter;
+ *   frameLimiterSetFps(limiter, 30.0);
+ *   while(...)
+ *   {
+ *       draw();
+ *       glfwSwapBuffers(window);
+ *       frameLimiterWait(limiter);
+ *   }
+ *
+ */
+void frameLimiterWait(FrameLimiter& limiter);
+
+/**
+ * @brief Record the interval since the previous call. Call once per frame at the same point of the frame loop.
+ */
+void pacingRecord(FramePacing& pacing);
+
+/**
+ * @brief Print statistics and the histogram of the recorded frame intervals and start a new recording.
+ *
+ * @param pacing Recorded intervals.
+ * @param targetMs Intended frame interval, intervals more than 10% above it are counted as late. 0 skips the count.
+ */
+void pacingReport(FramePacing& pacing, double targetMs);
@@ -0,0 +1,360 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace detail
+{
+/* events per thread, recording stops (and counts drops) when a buffer is full */
+const uint32_t kThreadCapacity = 1 << 16;
+/* GPU results are read kGpuLatency - 1 frames after they were issued */
+const uint32_t kGpuLatency = 4;
+const uint32_t kMaxGpuZones = 16;
+/* thread id of the GPU track in the exported trace */
+const uint32_t kGpuTrack = 0xFFFF;
+
+/* written by exactly one thread, count is published with release so a reader never sees half written events */
+struct ThreadBuffer
+{
+    uint32_t index = 0;
+    std::string name;
+    std::unique_ptr<ProfileEvent[]> events;
+    std::atomic<uint32_t> count{0};
+    std::atomic<uint32_t> dropped{0};
+};
+
+struct GpuFrame
+{
+    GLuint queries[kMaxGpuZones] = {};
+    const char* names[kMaxGpuZones] = {};
+    uint64_t starts[kMaxGpuZones] = {};
+    uint32_t count = 0;
+    /* GL_TIMESTAMP queries around all GPU work of the frame, zones only cover parts of it */
+    GLuint timestamps[2] = {};
+    uint64_t frameStart = 0;
+    bool frameBegun = false;
+    bool frameEnded = false;
+};
+
+std::atomic<bool> enabled{false};
+uint64_t epoch = 0;
+
+/* the registry is only locked when a thread records its first zone and when exporting */
+std::mutex registryMutex;
+std::vector<std::unique_ptr<ThreadBuffer>> registry;
+thread_local ThreadBuffer* threadBuffer = nullptr;
+
+/* GPU state, only touched on the GL thread */
+bool gpuSupported = false;
+bool gpuInitialized = false;
+GpuFrame gpuFrames[kGpuLatency];
+uint64_t gpuFrameIndex = 0;
+bool gpuZoneOpen = false;
+std::vector<ProfileEvent> gpuEvents;
+std::vector<double> gpuFrameTimes;
+
+ThreadBuffer& localBuffer()
+{
+    if(threadBuffer == nullptr)
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        registry.push_back(std::make_unique<ThreadBuffer>());
+        threadBuffer = registry.back().get();
+        threadBuffer->index = registry.size() - 1;
+        threadBuffer->name = "thread " + std::to_string(threadBuffer->index);
+        threadBuffer->events.reset(new ProfileEvent[kThreadCapacity]);
+    }
+    return *threadBuffer;
+}
+
+void gpuInit()
+{
+    gpuInitialized = true;
+    gpuSupported = GLAD_GL_ARB_timer_query || GLAD_GL_EXT_timer_query;
+    if(!gpuSupported)
+    {
+        std::cerr << "[Profiler] Timer queries not supported, GPU zones are disabled" << std::endl;
+        return;
+    }
+    for(GpuFrame& frame : gpuFrames)
+    {
+        glGenQueries(kMaxGpuZones, frame.queries);
+        glGenQueries(2, frame.timestamps);
+    }
+}
+
+void gpuResolve(GpuFrame& frame)
+{
+    double zonesMs = 0.0;
+    for(uint32_t i = 0; i < frame.count; i++)
+    {
+        /* issued kGpuLatency - 1 frames ago, the result is normally available and this does not block */
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &elapsed);
+
+        /* a zone can't take longer on the GPU than the wall time since it was issued, some drivers (llvmpipe)
+         * return garbage for the very first query */
+        if(elapsed > profilerNow() - frame.starts[i])
+            continue;
+        gpuEvents.push_back({frame.names[i], frame.starts[i], frame.starts[i] + elapsed});
+        zonesMs += elapsed / 1e6;
+    }
+
+    if(frame.frameBegun && frame.frameEnded)
+    {
+        GLuint64 begin = 0;
+        GLuint64 end = 0;
+        glGetQueryObjectui64v(frame.timestamps[0], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(frame.timestamps[1], GL_QUERY_RESULT, &end);
+        if(end >= begin && end - begin <= profilerNow() - frame.frameStart)
+            gpuFrameTimes.push_back((end - begin) / 1e6);
+    }
+    else if(frame.count > 0)
+        gpuFrameTimes.push_back(zonesMs);
+    frame.count = 0;
+    frame.frameBegun = false;
+    frame.frameEnded = false;
+}
+
+/* collects the frames still in flight, oldest first */
+void gpuResolveAll()
+{
+    if(!gpuSupported || gpuZoneOpen)
+        return;
+    for(uint32_t i = 1; i <= kGpuLatency; i++)
+        gpuResolve(gpuFrames[(gpuFrameIndex + i) % kGpuLatency]);
+}
+
+struct ZoneStats
+{
+    uint64_t count = 0;
+    double totalMs = 0.0;
+    double maxMs = 0.0;
+};
+
+void accumulate(std::map<std::string, ZoneStats>& stats, const ProfileEvent& event)
+{
+    ZoneStats& zone = stats[event.name];
+    double ms = (event.end - event.start) / 1e6;
+    zone.count++;
+    zone.totalMs += ms;
+    zone.maxMs = std::max(zone.maxMs, ms);
+}
+
+void printStats(const char* title, const std::map<std::string, ZoneStats>& stats)
+{
+    for(const auto& [name, zone] : stats)
+    {
+        std::cout << "[Profiler] " << title << " " << std::left << std::setw(16) << name << std::right
+                  << " count " << std::setw(7) << zone.count << "  avg " << std::setw(9) << zone.totalMs / zone.count
+                  << " ms  max " << std::setw(9) << zone.maxMs << " ms" << std::endl;
+    }
+}
+
+void writeEvent(std::ostream& out, const ProfileEvent& event, uint32_t tid, const char* category, bool& first)
+{
+    out << (first ? "\n" : ",\n") << "{\"name\":\"";
+    jsonWriteEscaped(out, event.name);
+    out << "\",\"cat\":\"" << category << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << tid
+        << ",\"ts\":" << (event.start - epoch) / 1e3 << ",\"dur\":" << (event.end - event.start) / 1e3 << "}";
+    first = false;
+}
+
+void writeThreadName(std::ostream& out, uint32_t tid, const std::string& name, bool& first)
+{
+    out << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << tid
+        << ",\"args\":{\"name\":\"";
+    jsonWriteEscaped(out, name);
+    out << "\"}}";
+    first = false;
+}
+}
+
+void jsonWriteEscaped(std::ostream& out, const std::string& text)
+{
+    for(char c : text)
+    {
+        if(c == '"' || c == '\\')
+            out << '\\' << c;
+        else if(c == '\n')
+            out << "\\n";
+        else if(c == '\t')
+            out << "\\t";
+        else if(static_cast<unsigned char>(c) < 0x20)
+            out << "\\u00" << "0123456789abcdef"[(c >> 4) & 0xF] << "0123456789abcdef"[c & 0xF];
+        else
+            out << c;
+    }
+}
+
+uint64_t profilerNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void profilerSetEnabled(bool enabled)
+{
+#ifndef MYGL_PROFILER
+    if(enabled)
+    {
+        std::cerr << "[Profiler] Built without MYGL_PROFILER (ENABLE_PROFILER=OFF), no zones are recorded" << std::endl;
+    }
+    enabled = false;
+#endif
+    if(enabled && detail::epoch == 0)
+        detail::epoch = profilerNow();
+    detail::enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool profilerEnabled()
+{
+    return detail::enabled.load(std::memory_order_relaxed);
+}
+
+void profilerSetThreadName(const char* name)
+{
+    detail::ThreadBuffer& buffer = detail::localBuffer();
+    std::lock_guard<std::mutex> lock(detail::registryMutex);
+    buffer.name = name;
+}
+
+void profilerRecord(const char* name, uint64_t start, uint64_t end)
+{
+    detail::ThreadBuffer& buffer = detail::localBuffer();
+    uint32_t count = buffer.count.load(std::memory_order_relaxed);
+    if(count == detail::kThreadCapacity)
+    {
+        buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    buffer.events[count] = {name, start, end};
+    buffer.count.store(count + 1, std::memory_order_release);
+}
+
+void profilerBeginFrame()
+{
+    if(!profilerEnabled())
+        return;
+    if(!detail::gpuInitialized)
+        detail::gpuInit();
+    if(!detail::gpuSupported)
+        return;
+
+    /* the slot about to be reused holds the oldest frame in the ring */
+    detail::gpuFrameIndex++;
+    detail::GpuFrame& frame = detail::gpuFrames[detail::gpuFrameIndex % detail::kGpuLatency];
+    detail::gpuResolve(frame);
+
+    frame.frameStart = profilerNow();
+    glQueryCounter(frame.timestamps[0], GL_TIMESTAMP);
+    frame.frameBegun = true;
+}
+
+void profilerEndFrame()
+{
+    if(!detail::gpuSupported)
+        return;
+    detail::GpuFrame& frame = detail::gpuFrames[detail::gpuFrameIndex % detail::kGpuLatency];
+    if(!frame.frameBegun || frame.frameEnded)
+        return;
+    glQueryCounter(frame.timestamps[1], GL_TIMESTAMP);
+    frame.frameEnded = true;
+}
+
+bool profilerGpuBegin(const char* name)
+{
+    if(!detail::gpuSupported || detail::gpuZoneOpen)
+        return false;
+
+    detail::GpuFrame& frame = detail::gpuFrames[detail::gpuFrameIndex % detail::kGpuLatency];
+    if(frame.count == detail::kMaxGpuZones)
+        return false;
+
+    frame.names[frame.count] = name;
+    frame.starts[frame.count] = profilerNow();
+    glBeginQuery(GL_TIME_ELAPSED, frame.queries[frame.count]);
+    frame.count++;
+    detail::gpuZoneOpen = true;
+    return true;
+}
+
+void profilerGpuEnd()
+{
+    glEndQuery(GL_TIME_ELAPSED);
+    detail::gpuZoneOpen = false;
+}
+
+const std::vector<double>& profilerGpuFrameTimes()
+{
+    detail::gpuResolveAll();
+    return detail::gpuFrameTimes;
+}
+
+void profilerReport()
+{
+    std::map<std::string, detail::ZoneStats> cpu;
+    std::map<std::string, detail::ZoneStats> gpu;
+    uint32_t dropped = 0;
+    detail::gpuResolveAll();
+    {
+        std::lock_guard<std::mutex> lock(detail::registryMutex);
+        for(const auto& buffer : detail::registry)
+        {
+            uint32_t count = buffer->count.load(std::memory_order_acquire);
+            for(uint32_t i = 0; i < count; i++)
+                detail::accumulate(cpu, buffer->events[i]);
+            dropped += buffer->dropped.load(std::memory_order_relaxed);
+        }
+    }
+    for(const ProfileEvent& event : detail::gpuEvents)
+        detail::accumulate(gpu, event);
+
+    detail::printStats("cpu", cpu);
+    detail::printStats("gpu", gpu);
+    if(dropped > 0)
+        std::cout << "[Profiler] " << dropped << " zone(s) dropped, thread buffers were full" << std::endl;
+}
+
+bool profilerExportChromeTrace(const std::string& filepath)
+{
+    std::ofstream out(filepath);
+    if(!out)
+    {
+        std::cerr << "[Profiler] Couldn't open " << filepath << std::endl;
+        return false;
+    }
+
+    detail::gpuResolveAll();
+    bool first = true;
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    {
+        std::lock_guard<std::mutex> lock(detail::registryMutex);
+        for(const auto& buffer : detail::registry)
+        {
+            detail::writeThreadName(out, buffer->index, buffer->name, first);
+            uint32_t count = buffer->count.load(std::memory_order_acquire);
+            for(uint32_t i = 0; i < count; i++)
+                detail::writeEvent(out, buffer->events[i], buffer->index, "cpu", first);
+        }
+    }
+
+    /* GPU zones start at the CPU time the query was issued, the duration is the time measured on the GPU */
+    if(!detail::gpuEvents.empty())
+    {
+        detail::writeThreadName(out, detail::kGpuTrack, "GPU", first);
+        for(const ProfileEvent& event : detail::gpuEvents)
+            detail::writeEvent(out, event, detail::kGpuTrack, "gpu", first);
+    }
+    out << "\n]}\n";
+
+    std::cout << "[Profiler] Wrote trace " << filepath << std::endl;
+    return out.good();
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "base.h"
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+/**
+ * Frame profiler with scoped CPU zones and GPU zones.
+ *
+ * CPU zones are written into a buffer owned by the recording thread (single producer, no locks on the hot path), so
+ * zones can be recorded from any thread. GPU zones measure GL_TIME_ELAPSED with a ring of query objects that is read
+ * back with a latency of several frames, so reading results never stalls the pipeline. GPU zones must not nest
+ * (a GL restriction on GL_TIME_ELAPSED queries) and must be recorded on the thread that owns the GL context.
+ *
+ * The zones compile to nothing without MYGL_PROFILER (CMake option ENABLE_PROFILER). When compiled in but disabled a
+ * zone costs a single flag check.
+ *
+ * usage:
+ *
+ *   profilerSetEnabled(true);
+ *   while(running)
+ *   {
+ *       profilerBeginFrame();
+ *       { PROFILE_CPU("update"); sceneUpdate(dt); }
+ *       { PROFILE_CPU("draw"); PROFILE_GPU("draw"); sceneDraw(); }
+ *   }
+ *   profilerExportChromeTrace("trace.json");   // open with chrome://tracing or ui.perfetto.dev
+ *
+ */
+
+/* one completed zone, times in nanoseconds of the steady clock */
+struct ProfileEvent
+{
+    const char* name = nullptr;     // has to outlive the profiler, usually a string literal
+    uint64_t start = 0;
+    uint64_t end = 0;
+};
+
+/**
+ * @brief Enable or disable recording at runtime. Disabled by default.
+ */
+void profilerSetEnabled(bool enabled);
+bool profilerEnabled();
+
+/**
+ * @brief Name the calling thread in the exported trace.
+ */
+void profilerSetThreadName(const char* name);
+
+/**
+ * @brief Mark the start of a new frame. Collects the GPU zones of the oldest frame in the query ring and issues a GPU
+ * timestamp for the start of the frame. Has to be called on the GL thread once per frame.
+ */
+void profilerBeginFrame();
+
+/**
+ * @brief Mark the end of the GPU work of a frame (before the buffer swap) with a second timestamp, so the frame time
+ * also covers the work outside of GPU zones. Has to be called on the GL thread.
+ */
+void profilerEndFrame();
+
+/**
+ * @brief Current time of the profiler clock in nanoseconds.
+ */
+uint64_t profilerNow();
+
+/**
+ * @brief Record a completed CPU zone for the calling thread. Usually called by PROFILE_CPU.
+ */
+void profilerRecord(const char* name, uint64_t start, uint64_t end);
+
+/**
+ * @brief Start/stop a GPU zone. Usually called by PROFILE_GPU.
+ *
+ * @return profilerGpuBegin returns false if no query was started (disabled, unsupported or too many zones this frame).
+ */
+bool profilerGpuBegin(const char* name);
+void profilerGpuEnd();
+
+/**
+ * @brief GPU time of a frame in milliseconds, from the timestamp of profilerBeginFrame to the one of profilerEndFrame
+ * (the sum of the zones for frames without an end), one entry per frame in frame order. Resolves the frames
+ * still in flight, which waits for the GPU, so call it after the last frame.
+ */
+const std::vector<double>& profilerGpuFrameTimes();
+
+/**
+ * @brief Print count, average and maximum of every zone to stdout.
+ */
+void profilerReport();
+
+/**
+ * @brief Write all recorded zones as Chrome trace-event JSON.
+ *
+ * @param filepath Path to output file.
+ *
+ * @return False if the file couldn't be written.
+ */
+bool profilerExportChromeTrace(const std::string& filepath);
+
+/**
+ * @brief Write a string as the contents of a JSON string literal: quotes, backslashes and control characters are
+ * escaped, the surrounding quotes are not written. Shared by the trace export and the benchmark report.
+ *
+ * @param out Output stream.
+ * @param text Text to write.
+ */
+void jsonWriteEscaped(std::ostream& out, const std::string& text);
+
+struct ProfileCpuScope
+{
+    const char* name;
+    uint64_t start;
+
+    explicit ProfileCpuScope(const char* zone) : name(zone), start(profilerEnabled() ? profilerNow() : 0) {}
+    ~ProfileCpuScope() { if(start != 0) { profilerRecord(name, start, profilerNow()); } }
+};
+
+struct ProfileGpuScope
+{
+    bool active;
+
+    explicit ProfileGpuScope(const char* zone) : active(profilerEnabled() && profilerGpuBegin(zone)) {}
+    ~ProfileGpuScope() { if(active) { profilerGpuEnd(); } }
+};
+
+#ifdef MYGL_PROFILER
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_CPU(name) ProfileCpuScope PROFILE_CONCAT(profileCpuScope, __LINE__)(name)
+#define PROFILE_GPU(name) ProfileGpuScope PROFILE_CONCAT(profileGpuScope, __LINE__)(name)
+#else
+#define PROFILE_CPU(name) ((void) 0)
+#define PROFILE_GPU(name) ((void) 0)
+#endif
@@ -0,0 +1,393 @@
+#include "recorder.h"
+#include "glstate.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace detail
+{
+/* size of the memory mapped window of the output file, it is moved along as frames are written */
+const size_t kRecordWindowBytes = 128u << 20;
+
+/* flip to top row first and convert to planar I420, chroma is averaged over 2x2 blocks */
+void recordConvertYuv420(const unsigned char* rgba, int width, int height, unsigned char* out)
+{
+    int chromaWidth = (width + 1) / 2;
+    int chromaHeight = (height + 1) / 2;
+    unsigned char* planeY = out;
+    unsigned char* planeU = out + size_t(width) * height;
+    unsigned char* planeV = planeU + size_t(chromaWidth) * chromaHeight;
+
+    auto row = [&](int y) { return rgba + size_t(height - 1 - y) * width * 4; };
+    for(int y = 0; y < height; y++)
+    {
+        const unsigned char* src = row(y);
+        unsigned char* dst = planeY + size_t(y) * width;
+        for(int x = 0; x < width; x++, src += 4)
+        {
+            dst[x] = (unsigned char)(16 + ((66 * src[0] + 129 * src[1] + 25 * src[2] + 128) >> 8));
+        }
+    }
+    for(int cy = 0; cy < chromaHeight; cy++)
+    {
+        const unsigned char* row0 = row(2 * cy);
+        const unsigned char* row1 = row(std::min(2 * cy + 1, height - 1));
+        for(int cx = 0; cx < chromaWidth; cx++)
+        {
+            int x0 = 2 * cx * 4;
+            int x1 = std::min(2 * cx + 1, width - 1) * 4;
+            int r = (row0[x0 + 0] + row0[x1 + 0] + row1[x0 + 0] + row1[x1 + 0] + 2) >> 2;
+            int g = (row0[x0 + 1] + row0[x1 + 1] + row1[x0 + 1] + row1[x1 + 1] + 2) >> 2;
+            int b = (row0[x0 + 2] + row0[x1 + 2] + row1[x0 + 2] + row1[x1 + 2] + 2) >> 2;
+            size_t i = size_t(cy) * chromaWidth + cx;
+            planeU[i] = (unsigned char)(128 + ((-38 * r - 74 * g + 112 * b + 128) >> 8));
+            planeV[i] = (unsigned char)(128 + ((112 * r - 94 * g - 18 * b + 128) >> 8));
+        }
+    }
+}
+
+void recordFail(Recorder& recorder, const char* what)
+{
+    if(!recorder.failed)
+    {
+        std::cerr << "[Recorder] " << what << " " << recorder.path << ", " << std::strerror(errno) << std::endl;
+    }
+    recorder.failed = true;
+}
+
+/* memory of the output the next frame is assembled in */
+unsigned char* recordFrameBegin(Recorder& recorder)
+{
+#ifndef _WIN32
+    if(recorder.output == RecordOutput::Mmap)
+    {
+        size_t end = recorder.bytesWritten + recorder.frameBytes;
+        if(recorder.window == nullptr || end > recorder.windowOffset + recorder.windowSize)
+        {
+            if(recorder.window != nullptr)
+            {
+                munmap(recorder.window, recorder.windowSize);
+                recorder.window = nullptr;
+            }
+
+            /* grow the file and map the next window, mmap offsets have to be page aligned */
+            size_t page = size_t(sysconf(_SC_PAGESIZE));
+            size_t offset = recorder.bytesWritten / page * page;
+            size_t windowEnd = std::max(end, offset + kRecordWindowBytes);
+            if(ftruncate(recorder.fd, off_t(windowEnd)) != 0)
+            {
+                recordFail(recorder, "Could not grow");
+                return nullptr;
+            }
+            void* window = mmap(nullptr, windowEnd - offset, PROT_READ | PROT_WRITE, MAP_SHARED, recorder.fd, off_t(offset));
+            if(window == MAP_FAILED)
+            {
+                recordFail(recorder, "Could not map");
+                return nullptr;
+            }
+            recorder.window = static_cast<unsigned char*>(window);
+            recorder.windowOffset = offset;
+            recorder.windowSize = windowEnd - offset;
+        }
+        return recorder.window + (recorder.bytesWritten - recorder.windowOffset);
+    }
+#endif
+    return recorder.scratch.data();
+}
+
+void recordFrameEnd(Recorder& recorder)
+{
+    if(recorder.output != RecordOutput::Mmap)
+    {
+        if(std::fwrite(recorder.scratch.data(), 1, recorder.frameBytes, recorder.file) != recorder.frameBytes)
+        {
+            recordFail(recorder, "Could not write to");
+            return;
+        }
+    }
+    recorder.bytesWritten += recorder.frameBytes;
+    recorder.written++;
+}
+
+void recordWrite(Recorder& recorder, const unsigned char* pixels)
+{
+    auto start = std::chrono::steady_clock::now();
+    unsigned char* frame = recordFrameBegin(recorder);
+    if(frame == nullptr) { return; }
+
+    if(recorder.format == RecordFormat::YUV420)
+    {
+        recordConvertYuv420(pixels, recorder.width, recorder.height, frame);
+    }
+    else
+    {
+        size_t stride = size_t(recorder.width) * 4;
+        for(int y = 0; y < recorder.height; y++)
+        {
+            std::memcpy(frame + y * stride, pixels + (recorder.height - 1 - y) * stride, stride);
+        }
+    }
+    recordFrameEnd(recorder);
+    recorder.writeMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void recordWriterLoop(Recorder& recorder)
+{
+    profilerSetThreadName("recorder");
+    std::unique_lock<std::mutex> lock(recorder.mutex);
+    while(true)
+    {
+        recorder.changed.wait(lock, [&] { return !recorder.queue.empty() || recorder.quit; });
+        if(recorder.queue.empty()) { return; }
+
+        RecordSlot& slot = recorder.slots[recorder.queue.front()];
+        recorder.queue.pop_front();
+        lock.unlock();
+        if(!recorder.failed)
+        {
+            PROFILE_CPU("record write");
+            recordWrite(recorder, slot.pixels);
+        }
+        slot.state.store(RecordSlot::Written, std::memory_order_release);
+        lock.lock();
+    }
+}
+
+/* map the oldest finished readback and pass it to the writer, the buffer stays mapped until it was written */
+void recordMap(Recorder& recorder)
+{
+    int index = int(recorder.mapped % recorder.slots.size());
+    RecordSlot& slot = recorder.slots[index];
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+
+    glStateBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    slot.pixels = static_cast<const unsigned char*>(
+        glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, GLsizeiptr(recorder.width) * recorder.height * 4, GL_MAP_READ_BIT));
+    glStateBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    recorder.mapped++;
+
+    if(slot.pixels == nullptr)
+    {
+        std::cerr << "[Recorder] Could not map pixel buffer, frame lost" << std::endl;
+        slot.state.store(RecordSlot::Written, std::memory_order_relaxed);
+        return;
+    }
+    slot.state.store(RecordSlot::Mapped, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(recorder.mutex);
+        recorder.queue.push_back(index);
+    }
+    recorder.changed.notify_one();
+}
+
+/* unmap written frames in order and make their slots available again */
+void recordRecycle(Recorder& recorder)
+{
+    while(recorder.head < recorder.mapped)
+    {
+        RecordSlot& slot = recorder.slots[recorder.head % recorder.slots.size()];
+        if(slot.state.load(std::memory_order_acquire) != RecordSlot::Written) { break; }
+
+        if(slot.pixels != nullptr)
+        {
+            glStateBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            glStateBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            slot.pixels = nullptr;
+        }
+        slot.state.store(RecordSlot::Free, std::memory_order_relaxed);
+        recorder.head++;
+    }
+}
+}
+
+bool recorderStart(Recorder& recorder, const std::string& path, RecordFormat format, bool mmap, int slots, int width,
+                   int height)
+{
+    if(slots < 1)
+    {
+        std::cerr << "[Recorder] At least one pixel buffer is needed, got " << slots << std::endl;
+        return false;
+    }
+    recorder.path = path;
+    recorder.format = format;
+    recorder.output = path == "-" ? RecordOutput::Stdout : mmap ? RecordOutput::Mmap : RecordOutput::File;
+    recorder.width = width;
+    recorder.height = height;
+    recorder.frameBytes = format == RecordFormat::YUV420
+                        ? size_t(width) * height + 2 * size_t((width + 1) / 2) * ((height + 1) / 2)
+                        : size_t(width) * height * 4;
+#ifdef _WIN32
+    if(recorder.output == RecordOutput::Mmap)
+    {
+        std::cerr << "[Recorder] Memory mapped output is not supported on Windows, using buffered writes" << std::endl;
+        recorder.output = RecordOutput::File;
+    }
+#endif
+
+    /* open the output */
+    if(recorder.output == RecordOutput::Stdout)
+    {
+        recorder.file = stdout;
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#else
+        /* a closed pipe becomes a write error instead of terminating the program */
+        std::signal(SIGPIPE, SIG_IGN);
+#endif
+    }
+    else if(recorder.output == RecordOutput::File)
+    {
+        recorder.file = std::fopen(path.c_str(), "wb");
+    }
+#ifndef _WIN32
+    else
+    {
+        recorder.fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    }
+#endif
+    if(recorder.file == nullptr && recorder.fd < 0)
+    {
+        std::cerr << "[Recorder] Could not open " << path << std::endl;
+        return false;
+    }
+    if(recorder.output != RecordOutput::Mmap)
+    {
+        recorder.scratch.resize(recorder.frameBytes);
+    }
+
+    recorder.slots = std::vector<RecordSlot>(slots);
+    for(RecordSlot& slot : recorder.slots)
+    {
+        glGenBuffers(1, &slot.pbo);
+        glStateBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, GLsizeiptr(width) * height * 4, nullptr, GL_STREAM_READ);
+    }
+    glStateBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glCheckError();
+
+    recorder.start = std::chrono::steady_clock::now();
+    recorder.quit = false;
+    recorder.thread = std::thread(detail::recordWriterLoop, std::ref(recorder));
+    return true;
+}
+
+void recorderCapture(Recorder& recorder)
+{
+    PROFILE_CPU("record capture");
+    recorder.captured++;
+    if(recorder.tail - recorder.head == recorder.slots.size())
+    {
+        recorder.dropped++;
+        return;
+    }
+
+    /* with a pack buffer bound glReadPixels only queues the copy and returns */
+    RecordSlot& slot = recorder.slots[recorder.tail % recorder.slots.size()];
+    GLint readFramebuffer = 0;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFramebuffer);
+    glReadBuffer(readFramebuffer != 0 ? GL_COLOR_ATTACHMENT0 : GL_BACK);
+    glStateBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    glReadPixels(0, 0, recorder.width, recorder.height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glStateBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.state.store(RecordSlot::Reading, std::memory_order_relaxed);
+    recorder.tail++;
+}
+
+void recorderUpdate(Recorder& recorder)
+{
+    /* frames are mapped in order, so the writer sees them in order */
+    while(recorder.mapped < recorder.tail)
+    {
+        RecordSlot& slot = recorder.slots[recorder.mapped % recorder.slots.size()];
+        GLenum state = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if(state != GL_ALREADY_SIGNALED && state != GL_CONDITION_SATISFIED) { break; }
+        detail::recordMap(recorder);
+    }
+    detail::recordRecycle(recorder);
+}
+
+void recorderStop(Recorder& recorder)
+{
+    if(!recorder.thread.joinable()) { return; }
+
+    /* finish the readbacks in flight and let the writer drain its queue */
+    while(recorder.mapped < recorder.tail)
+    {
+        RecordSlot& slot = recorder.slots[recorder.mapped % recorder.slots.size()];
+        glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        detail::recordMap(recorder);
+    }
+    {
+        std::lock_guard<std::mutex> lock(recorder.mutex);
+        recorder.quit = true;
+    }
+    recorder.changed.notify_one();
+    recorder.thread.join();
+    detail::recordRecycle(recorder);
+
+    for(RecordSlot& slot : recorder.slots)
+    {
+        glDeleteBuffers(1, &slot.pbo);
+    }
+    size_t slotCount = recorder.slots.size();
+    recorder.slots.clear();
+
+    /* close the output, a memory mapped file is cut to the written size */
+#ifndef _WIN32
+    if(recorder.fd >= 0)
+    {
+        if(recorder.window != nullptr)
+        {
+            munmap(recorder.window, recorder.windowSize);
+            recorder.window = nullptr;
+        }
+        if(ftruncate(recorder.fd, off_t(recorder.bytesWritten)) != 0)
+        {
+            detail::recordFail(recorder, "Could not truncate");
+        }
+        close(recorder.fd);
+        recorder.fd = -1;
+    }
+#endif
+    if(recorder.file != nullptr)
+    {
+        if(std::fflush(recorder.file) != 0)
+        {
+            detail::recordFail(recorder, "Could not write to");
+        }
+        if(recorder.file != stdout)
+        {
+            std::fclose(recorder.file);
+        }
+        recorder.file = nullptr;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - recorder.start).count();
+    double megabytes = recorder.bytesWritten / (1024.0 * 1024.0);
+    std::cout << "[Recorder] " << (recorder.output == RecordOutput::Stdout ? "stdout" : recorder.path) << ": "
+              << recorder.written << " frames " << recorder.width << "x" << recorder.height << " "
+              << (recorder.format == RecordFormat::YUV420 ? "yuv420p" : "rgba") << ", " << megabytes << " MB ("
+              << megabytes / std::max(seconds, 1e-9) << " MB/s), writer "
+              << recorder.writeMs / std::max<uint64_t>(recorder.written, 1) << " ms/frame" << std::endl;
+    if(recorder.dropped > 0)
+    {
+        std::cout << "[Recorder] Dropped " << recorder.dropped << " of " << recorder.captured << " frames, all "
+                  << slotCount << " readbacks were busy (the GPU or the writer is too slow, use more buffers)" << std::endl;
+    }
+}
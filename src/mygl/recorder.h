@@ -0,0 +1,141 @@
+#pragma once
+
+#include "base.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class RecordFormat
+{
+    RGBA,           // 4 bytes per pixel
+    YUV420,         // planar I420 (BT.601, limited range), 1.5 bytes per pixel
+};
+
+enum class RecordOutput
+{
+    File,           // buffered writes
+    Mmap,           // frames are written straight into a memory mapped window of the file
+    Stdout,         // raw stream for an external encoder
+};
+
+/* one frame of the ring, owned by the GL thread while Free/Reading and by the writer thread while Mapped */
+struct RecordSlot
+{
+    enum State { Free, Reading, Mapped, Written };
+
+    GLuint pbo = 0;
+    GLsync fence = nullptr;
+    const unsigned char* pixels = nullptr;      // mapped pixel buffer, bottom row first
+    std::atomic<int> state{Free};
+};
+
+/**
+ * Continuous capture of the rendered frames to a raw video stream. Each frame is read back into the next pixel buffer
+ * object of a ring, mapped once its fence signaled and handed to a writer thread that flips it, converts it to the
+ * requested format and writes it out, without copying it on the GL thread. If the oldest frame of the ring is still
+ * being read back or written, the new frame is dropped instead of stalling the frame loop.
+ *
+ * Frames are written top row first without any header, e.g. play them back with
+ *   ffplay -f rawvideo -pixel_format rgba -video_size 1920x1080 -framerate 60 recording.rgba
+ * or encode them while recording with
+ *   assignment_01 --record - --record-format yuv420 | ffmpeg -f rawvideo -pix_fmt yuv420p -s 1920x1080 -i - out.mp4
+ */
+struct Recorder
+{
+    std::string path;
+    RecordFormat format = RecordFormat::RGBA;
+    RecordOutput output = RecordOutput::File;
+    int width = 0;
+    int height = 0;
+    size_t frameBytes = 0;
+
+    /* ring of readbacks, frames [head, tail) are in use, mapped counts the ones handed to the writer */
+    std::vector<RecordSlot> slots;
+    uint64_t head = 0;
+    uint64_t mapped = 0;
+    uint64_t tail = 0;
+
+    /* writer thread, queue holds slot indices in frame order and is guarded by the mutex */
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<int> queue;
+    bool quit = false;
+
+    /* destination, only touched by the writer thread */
+    FILE* file = nullptr;
+    int fd = -1;
+    unsigned char* window = nullptr;            // mapped part of the file for RecordOutput::Mmap
+    size_t windowOffset = 0;
+    size_t windowSize = 0;
+    std::vector<unsigned char> scratch;         // frame being assembled for buffered outputs
+    size_t bytesWritten = 0;
+    bool failed = false;
+
+    /* statistics */
+    std::chrono::steady_clock::time_point start;
+    uint64_t captured = 0;
+    uint64_t dropped = 0;
+    uint64_t written = 0;                       // written and writeMs belong to the writer thread until it was joined
+    double writeMs = 0.0;
+};
+
+/**
+ * @brief Open the output and start recording. Requires a current OpenGL context. The frame size is fixed, stop the
+ * recording when the framebuffer is resized.
+ *
+ * @param recorder Recorder to start.
+ * @param path Output file, "-" streams to stdout.
+ * @param format Pixel format of the written frames.
+ * @param mmap Write through a memory mapping of the file instead of buffered writes (ignored for stdout).
+ * @param slots Number of pixel buffer objects (at least 1), frames in flight before frames are dropped.
+ * @param width Width of the recorded frames.
+ * @param height Height of the recorded frames.
+ *
+ * @return False if the output could not be opened or slots is less than 1.
+ *
+ * usage:
+ *
+ *   Recorder recorder;
+ *   recorderStart(recorder, "flythrough.yuv", RecordFormat::YUV420, false, 4, 1920, 1080);
+ *   while(...)
+ *   {
+ *       draw();
+ *       recorderCapture(recorder);         // before the swap
+ *       glfwSwapBuffers(window);
+ *       recorderUpdate(recorder);
+ *   }
+ *   recorderStop(recorder);
+ *
+ */
+bool recorderStart(Recorder& recorder, const std::string& path, RecordFormat format, bool mmap, int slots, int width,
+                   int height);
+
+/**
+ * @brief Queue the readback of the current frame. Reads from the bound read framebuffer if one is bound, from the back
+ * buffer of the window otherwise.
+ *
+ * @param recorder Started recorder.
+ */
+void recorderCapture(Recorder& recorder);
+
+/**
+ * @brief Hand finished readbacks to the writer and recycle written ones, never waits. Call once per frame.
+ *
+ * @param recorder Started recorder.
+ */
+void recorderUpdate(Recorder& recorder);
+
+/**
+ * @brief Write all outstanding frames, close the output and print the statistics.
+ *
+ * @param recorder Recorder to stop.
+ */
+void recorderStop(Recorder& recorder);
@@ -0,0 +1,220 @@
+#include "renderqueue.h"
+#include "glstate.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace detail
+{
+    /* 12 bit hash of the color, packets with equal colors end up next to each other */
+    uint64_t colorBits(const Vector4D& color)
+    {
+        uint32_t words[4];
+        std::memcpy(words, &color.x, sizeof(words));
+        uint32_t hash = 2166136261u;
+        for(uint32_t word : words)
+        {
+            hash = (hash ^ word) * 16777619u;
+        }
+        return (hash ^ (hash >> 12) ^ (hash >> 24)) & 0xFFF;
+    }
+
+    /* handles of a program from the cache of the queue, the name lookups only happen the first time it is drawn */
+    const RenderProgramUniforms& programUniforms(RenderQueue& queue, const ShaderProgram& program)
+    {
+        for(const RenderProgramUniforms& uniforms : queue._uniforms)
+        {
+            if(uniforms.program == &program && uniforms.id == program.id)
+            {
+                return uniforms;
+            }
+        }
+
+        auto resolve = [&](const char* name) {
+            return shaderHasUniform(program, name) ? shaderUniformHandle(program, name) : ShaderUniformHandle();
+        };
+        RenderProgramUniforms uniforms;
+        uniforms.program = &program;
+        uniforms.id = program.id;
+        uniforms.model = resolve("uModel");
+        uniforms.color = resolve("uColor");
+        uniforms.layer = resolve("uLayer");
+
+        /* a program deleted and recreated at the same address replaces its old entry */
+        auto stale = std::find_if(queue._uniforms.begin(), queue._uniforms.end(),
+                                  [&](const RenderProgramUniforms& entry) { return entry.program == &program; });
+        if(stale != queue._uniforms.end())
+        {
+            *stale = uniforms;
+            return *stale;
+        }
+        queue._uniforms.push_back(uniforms);
+        return queue._uniforms.back();
+    }
+
+    uint64_t depthBits(float depth, float range)
+    {
+        float normalized = std::clamp(depth / range, 0.0f, 1.0f);
+        return static_cast<uint64_t>(normalized * 0xFFFFFF) & 0xFFFFFF;
+    }
+
+    /* LSD radix sort of (key, index) pairs, 8 bits per pass, passes where all keys share the byte are skipped */
+    void radixSort(std::vector<uint64_t>& keys, std::vector<uint32_t>& order, std::vector<uint64_t>& keysTmp, std::vector<uint32_t>& orderTmp)
+    {
+        std::size_t n = keys.size();
+        keysTmp.resize(n);
+        orderTmp.resize(n);
+
+        for(unsigned int shift = 0; shift < 64; shift += 8)
+        {
+            std::size_t count[256] = {};
+            for(std::size_t i = 0; i < n; i++)
+            {
+                count[(keys[i] >> shift) & 0xFF]++;
+            }
+            if(count[(keys[0] >> shift) & 0xFF] == n)
+            {
+                continue;
+            }
+
+            std::size_t offset = 0;
+            for(std::size_t& c : count)
+            {
+                std::size_t current = c;
+                c = offset;
+                offset += current;
+            }
+            for(std::size_t i = 0; i < n; i++)
+            {
+                std::size_t dst = count[(keys[i] >> shift) & 0xFF]++;
+                keysTmp[dst] = keys[i];
+                orderTmp[dst] = order[i];
+            }
+            keys.swap(keysTmp);
+            order.swap(orderTmp);
+        }
+    }
+}
+
+uint64_t renderQueueKey(const RenderQueue& queue, const DrawPacket& packet)
+{
+    uint64_t program = packet.program->id & 0xFF;
+    uint64_t vao = packet.vao & 0xFFF;
+    uint64_t texture = packet.texture & 0x7F;
+    uint64_t color = detail::colorBits(packet.color);
+    uint64_t depth = detail::depthBits(packet.depth, queue.depthRange);
+
+    if(!packet.transparent)
+    {
+        /* 0 | program:8 | vao:12 | texture:7 | color:12 | depth:24 (front-to-back) */
+        return (program << 55) | (vao << 43) | (texture << 36) | (color << 24) | depth;
+    }
+    /* 1 | inverted depth:24 (back-to-front) | program:8 | vao:12 | texture:7 | color:12 */
+    return (uint64_t(1) << 63) | ((0xFFFFFF - depth) << 39) | (program << 31) | (vao << 19) | (texture << 12) | color;
+}
+
+void renderQueueBegin(RenderQueue& queue, float depthRange)
+{
+    queue.packets.clear();
+    queue.depthRange = depthRange;
+}
+
+void renderQueuePush(RenderQueue& queue, const DrawPacket& packet)
+{
+    queue.packets.push_back(packet);
+}
+
+void renderQueueSubmit(RenderQueue& queue)
+{
+    queue.stats = RenderStats();
+    std::size_t n = queue.packets.size();
+    if(n == 0)
+    {
+        return;
+    }
+
+    queue._keys.resize(n);
+    queue._order.resize(n);
+    for(std::size_t i = 0; i < n; i++)
+    {
+        queue._keys[i] = renderQueueKey(queue, queue.packets[i]);
+        queue._order[i] = static_cast<uint32_t>(i);
+    }
+    detail::radixSort(queue._keys, queue._order, queue._keysTmp, queue._orderTmp);
+
+    const ShaderProgram* program = nullptr;
+    const RenderProgramUniforms* uniforms = nullptr;
+    GLuint vao = 0;
+    GLuint texture = 0;
+    bool blending = false;
+    const Vector4D* color = nullptr;
+    float layer = -1.0f;
+
+    for(uint32_t index : queue._order)
+    {
+        const DrawPacket& packet = queue.packets[index];
+
+        if(packet.transparent && !blending)
+        {
+            glStateEnable(GL_BLEND, true);
+            glStateBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            glStateDepthMask(GL_FALSE);
+            blending = true;
+        }
+
+        if(packet.program != program)
+        {
+            program = packet.program;
+            glStateUseProgram(program->id);
+            uniforms = &detail::programUniforms(queue, *program);
+            color = nullptr;
+            layer = -1.0f;
+            queue.stats.programChanges++;
+        }
+
+        if(packet.vao != vao)
+        {
+            vao = packet.vao;
+            glStateBindVertexArray(vao);
+            queue.stats.vaoChanges++;
+        }
+
+        if(packet.texture != 0 && packet.texture != texture)
+        {
+            texture = packet.texture;
+            glStateBindTexture(0, GL_TEXTURE_2D_ARRAY, texture);
+            queue.stats.textureChanges++;
+        }
+
+        if(uniforms->layer.location >= 0 && packet.layer != layer)
+        {
+            layer = packet.layer;
+            shaderUniform(uniforms->layer, layer);
+            queue.stats.uniformChanges++;
+        }
+
+        if(uniforms->color.location >= 0 && (!color || std::memcmp(color, &packet.color, sizeof(Vector4D)) != 0))
+        {
+            color = &packet.color;
+            shaderUniform(uniforms->color, packet.color);
+            queue.stats.uniformChanges++;
+        }
+        if(uniforms->model.location >= 0)
+        {
+            shaderUniform(uniforms->model, packet.model);
+            queue.stats.uniformChanges++;
+        }
+
+        if(packet.instanceCount > 0)
+            glDrawElementsInstanced(GL_TRIANGLES, packet.indexCount, GL_UNSIGNED_INT, nullptr, packet.instanceCount);
+        else
+            glDrawElements(GL_TRIANGLES, packet.indexCount, GL_UNSIGNED_INT, nullptr);
+        queue.stats.draws++;
+    }
+
+    if(blending)
+    {
+        glStateDepthMask(GL_TRUE);
+        glStateEnable(GL_BLEND, false);
+    }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "shader.h"
+
+#include <cstdint>
+#include <vector>
+
+/* everything needed to issue one indexed draw with the default uniforms uModel and uColor */
+struct DrawPacket
+{
+    const ShaderProgram* program = nullptr;
+    GLuint vao = 0;
+    GLsizei indexCount = 0;
+    GLsizei instanceCount = 0;  // > 0 for an instanced draw, the per-instance data lives in the vertex array
+    GLuint texture = 0;         // bound to GL_TEXTURE_2D_ARRAY of unit 0 if not 0
+    float layer = 0.0f;         // uLayer of textured programs without a per-instance layer
+    Matrix4D model;
+    Vector4D color;
+    float depth = 0.0f;         // view space distance to the camera
+    bool transparent = false;
+};
+
+/* state changes issued by the last renderQueueSubmit */
+struct RenderStats
+{
+    unsigned int draws = 0;
+    unsigned int programChanges = 0;
+    unsigned int vaoChanges = 0;
+    unsigned int textureChanges = 0;
+    unsigned int uniformChanges = 0;
+};
+
+/* uniforms of the draw packets resolved for one program, location -1 if the program doesn't use them */
+struct RenderProgramUniforms
+{
+    const ShaderProgram* program = nullptr;
+    GLuint id = 0;                      // the program object the handles belong to
+    ShaderUniformHandle model;
+    ShaderUniformHandle color;
+    ShaderUniformHandle layer;
+};
+
+/**
+ * Collects draw packets for a frame and submits them sorted by a packed 64 bit key. Opaque packets come first, grouped
+ * by program, vertex array, texture and color and then front-to-back within a group; transparent packets follow back-to-front
+ * with blending enabled. During submission binds and uniform updates that wouldn't change anything are skipped.
+ */
+struct RenderQueue
+{
+    std::vector<DrawPacket> packets;
+    float depthRange = 500.0f;          // depths are quantized in [0, depthRange], usually the far plane
+
+    std::vector<uint64_t> _keys;
+    std::vector<uint32_t> _order;
+    std::vector<uint64_t> _keysTmp;
+    std::vector<uint32_t> _orderTmp;
+    std::vector<RenderProgramUniforms> _uniforms;   // resolved on first use, a few programs per frame
+
+    RenderStats stats;
+};
+
+/**
+ * @brief Starts a new frame: drops all packets of the previous one.
+ *
+ * @param queue Render queue.
+ * @param depthRange Maximum expected depth (usually the far plane of the camera).
+ */
+void renderQueueBegin(RenderQueue& queue, float depthRange);
+
+/**
+ * @brief Adds a packet to the queue.
+ *
+ * @param queue Render queue.
+ * @param packet Draw packet.
+ */
+void renderQueuePush(RenderQueue& queue, const DrawPacket& packet);
+
+/**
+ * @brief Sorts all packets and issues the draw calls. The uniforms uModel, uColor and uLayer are set if the program of
+ * the packet has them, their handles are resolved once per program and kept in the queue. Afterwards queue.stats
+ * holds the number of draws and state changes.
+ *
+ * @param queue Render queue.
+ *
+ * usage:
+ *
+ *   renderQueueBegin(queue, camera.farPlane);
+ *   for each object: renderQueuePush(queue, {&program, mesh.vao, mesh.size_ibo, model, color, depth});
+ *   renderQueueSubmit(queue);
+ *
+ */
+void renderQueueSubmit(RenderQueue& queue);
+
+/**
+ * @brief Sort key of a packet, exposed for debugging.
+ */
+uint64_t renderQueueKey(const RenderQueue& queue, const DrawPacket& packet);
@@ -0,0 +1,210 @@
+#include "screenshot.h"
+#include "glstate.h"
+#include "profiler.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include <stb_image/stb_image_write.h>
+
+namespace detail
+{
+double screenshotMs(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+void screenshotAppend(void* context, void* data, int size)
+{
+    auto* png = static_cast<std::vector<unsigned char>*>(context);
+    png->insert(png->end(), static_cast<unsigned char*>(data), static_cast<unsigned char*>(data) + size);
+}
+
+void screenshotEncode(const ScreenshotImage& image)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    /* glReadPixels returns the bottom row first, start at the last row with a negative stride instead of using the
+     * global stbi flip flag, which is not thread-safe */
+    int stride = image.width * 4;
+    const unsigned char* top = image.pixels.data() + size_t(image.height - 1) * stride;
+    std::vector<unsigned char> png;
+    png.reserve(image.pixels.size() / 2);
+    int ok = stbi_write_png_to_func(screenshotAppend, &png, image.width, image.height, 4, top, -stride);
+
+    std::ofstream file(image.path, std::ios::binary);
+    if(ok && file)
+    {
+        file.write(reinterpret_cast<const char*>(png.data()), png.size());
+    }
+    auto end = std::chrono::steady_clock::now();
+    if(!ok || !file)
+    {
+        std::cerr << "[Screenshot] Could not write " << image.path << std::endl;
+        return;
+    }
+
+    std::cout << "[Screenshot] " << image.path << " " << image.width << "x" << image.height << ": readback "
+              << image.readbackMs << " ms (" << image.frames << " frames), encode " << screenshotMs(start, end)
+              << " ms, total " << screenshotMs(image.requested, end) << " ms, " << image.pixels.size() << " raw bytes, "
+              << png.size() << " PNG bytes" << std::endl;
+}
+
+void screenshotEncoderLoop(ScreenshotQueue& queue)
+{
+    profilerSetThreadName("screenshot");
+    std::unique_lock<std::mutex> lock(queue.mutex);
+    while(true)
+    {
+        queue.changed.wait(lock, [&] { return !queue.pending.empty() || queue.quit; });
+        if(queue.pending.empty()) { return; }
+
+        ScreenshotImage image = std::move(queue.pending.front());
+        queue.pending.pop_front();
+        lock.unlock();
+        {
+            PROFILE_CPU("encode");
+            screenshotEncode(image);
+        }
+        lock.lock();
+    }
+}
+
+/* copy the finished readback out of the pixel buffer object and pass it to the encoder */
+void screenshotFinish(ScreenshotQueue& queue, ScreenshotSlot& slot)
+{
+    PROFILE_CPU("screenshot map");
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+
+    ScreenshotImage image;
+    image.path = std::move(slot.path);
+    image.width = slot.width;
+    image.height = slot.height;
+    image.requested = slot.requested;
+    image.readbackMs = screenshotMs(slot.requested, std::chrono::steady_clock::now());
+    image.frames = slot.frames;
+    image.pixels.resize(size_t(slot.width) * slot.height * 4);
+
+    glStateBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, image.pixels.size(), GL_MAP_READ_BIT);
+    if(mapped)
+    {
+        std::memcpy(image.pixels.data(), mapped, image.pixels.size());
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glStateBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if(!mapped)
+    {
+        std::cerr << "[Screenshot] Could not map pixel buffer for " << image.path << std::endl;
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.pending.push_back(std::move(image));
+    }
+    queue.changed.notify_one();
+}
+}
+
+void screenshotQueueStart(ScreenshotQueue& queue)
+{
+    for(ScreenshotSlot& slot : queue.slots)
+    {
+        glGenBuffers(1, &slot.pbo);
+    }
+    queue.quit = false;
+    queue.thread = std::thread(detail::screenshotEncoderLoop, std::ref(queue));
+}
+
+bool screenshotRequest(ScreenshotQueue& queue, const std::string& filepath)
+{
+    ScreenshotSlot* slot = nullptr;
+    for(ScreenshotSlot& candidate : queue.slots)
+    {
+        if(candidate.fence == nullptr)
+        {
+            slot = &candidate;
+            break;
+        }
+    }
+    if(slot == nullptr)
+    {
+        std::cerr << "[Screenshot] All " << ScreenshotQueue::kSlots << " readbacks busy, dropped " << filepath << std::endl;
+        return false;
+    }
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    slot->width = viewport[2];
+    slot->height = viewport[3];
+    slot->path = filepath;
+    slot->requested = std::chrono::steady_clock::now();
+    slot->frames = 0;
+
+    /* with a pack buffer bound glReadPixels only queues the copy and returns */
+    glStateBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+    glBufferData(GL_PIXEL_PACK_BUFFER, GLsizeiptr(slot->width) * slot->height * 4, nullptr, GL_STREAM_READ);
+    GLint readFramebuffer = 0;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFramebuffer);
+    glReadBuffer(readFramebuffer != 0 ? GL_COLOR_ATTACHMENT0 : GL_FRONT);
+    glReadPixels(0, 0, slot->width, slot->height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glStateBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glCheckError();
+    return true;
+}
+
+void screenshotUpdate(ScreenshotQueue& queue)
+{
+    for(ScreenshotSlot& slot : queue.slots)
+    {
+        if(slot.fence == nullptr) { continue; }
+
+        /* zero timeout only polls, the flush makes sure the fence reaches the GPU */
+        GLenum state = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if(state == GL_ALREADY_SIGNALED || state == GL_CONDITION_SATISFIED)
+        {
+            detail::screenshotFinish(queue, slot);
+        }
+        else
+        {
+            slot.frames++;
+        }
+    }
+}
+
+bool screenshotPending(const ScreenshotQueue& queue)
+{
+    for(const ScreenshotSlot& slot : queue.slots)
+    {
+        if(slot.fence != nullptr) { return true; }
+    }
+    return false;
+}
+
+void screenshotQueueStop(ScreenshotQueue& queue)
+{
+    for(ScreenshotSlot& slot : queue.slots)
+    {
+        if(slot.fence != nullptr)
+        {
+            glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            detail::screenshotFinish(queue, slot);
+        }
+        glDeleteBuffers(1, &slot.pbo);
+        slot.pbo = 0;
+    }
+
+    if(queue.thread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.quit = true;
+        }
+        queue.changed.notify_one();
+        queue.thread.join();
+    }
+}
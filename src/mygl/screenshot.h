@@ -0,0 +1,104 @@
+#pragma once
+
+#include "base.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* readback in flight: glReadPixels wrote into the pixel buffer object, the fence tells when the copy is done */
+struct ScreenshotSlot
+{
+    GLuint pbo = 0;
+    GLsync fence = nullptr;
+    int width = 0;
+    int height = 0;
+    std::string path;
+    std::chrono::steady_clock::time_point requested;
+    int frames = 0;                 // frames the readback was polled before it completed
+};
+
+/* pixels copied out of a pixel buffer object, waiting for the encoder thread */
+struct ScreenshotImage
+{
+    std::string path;
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> pixels;      // RGBA, bottom row first as returned by glReadPixels
+    std::chrono::steady_clock::time_point requested;
+    double readbackMs = 0.0;
+    int frames = 0;
+};
+
+/**
+ * Asynchronous screenshots. A request only queues glReadPixels into a pixel buffer object and a fence, the buffer is
+ * mapped a frame or two later once the fence signaled and the PNG is encoded and written on a dedicated thread, so
+ * neither the readback nor the encoding stall the frame loop. Every finished capture reports its latency and size.
+ */
+struct ScreenshotQueue
+{
+    static const int kSlots = 3;
+    ScreenshotSlot slots[kSlots];
+
+    /* encoder thread, pending is guarded by the mutex */
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<ScreenshotImage> pending;
+    bool quit = false;
+};
+
+/**
+ * @brief Create the pixel buffer objects and start the encoder thread. Requires a current OpenGL context.
+ *
+ * @param queue Queue to start.
+ *
+ * usage:
+ *
+ *   ScreenshotQueue screenshots;
+ *   screenshotQueueStart(screenshots);
+ *   ...
+ *   screenshotRequest(screenshots, "screenshot.png");      // after drawing, before or after the swap
+ *   ...
+ *   screenshotUpdate(screenshots);                         // once per frame
+ *   ...
+ *   screenshotQueueStop(screenshots);                      // writes all outstanding screenshots
+ *
+ */
+void screenshotQueueStart(ScreenshotQueue& queue);
+
+/**
+ * @brief Capture the current viewport. Reads from the bound read framebuffer if one is bound, from the front buffer of
+ * the window otherwise, like screenshotToPNG. Returns immediately, the image is written later.
+ *
+ * @param queue Started queue.
+ * @param filepath Path to output image.
+ *
+ * @return False if all pixel buffer objects are busy and the request was dropped.
+ */
+bool screenshotRequest(ScreenshotQueue& queue, const std::string& filepath);
+
+/**
+ * @brief Hand completed readbacks to the encoder thread, never waits for the GPU. Call once per frame.
+ *
+ * @param queue Started queue.
+ */
+void screenshotUpdate(ScreenshotQueue& queue);
+
+/**
+ * @brief True while a readback waits for its fence, i.e. screenshotUpdate has to be called again.
+ *
+ * @param queue Started queue.
+ */
+bool screenshotPending(const ScreenshotQueue& queue);
+
+/**
+ * @brief Finish all outstanding readbacks, wait until the encoder wrote them and delete the pixel buffer objects.
+ *
+ * @param queue Queue to stop.
+ */
+void screenshotQueueStop(ScreenshotQueue& queue);
@@ -1,5 +1,11 @@
 #include "shader.h"
+#include "glstate.h"
+#include "shadercache.h"
+#include "uniformbuffer.h"
 
+#include <algorithm>
+#include <cassert>
+#include <chrono>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -9,10 +15,14 @@ namespace detail
 {
     void compile(GLuint handle, const char* source, const int size)
     {
-        GLint compileResult = 0;
-
         glShaderSource(handle, 1, &source, &size);
         glCompileShader(handle);
+    }
+
+    void checkCompile(GLuint handle)
+    {
+        GLint compileResult = 0;
+
         glGetShaderiv(handle, GL_COMPILE_STATUS, &compileResult);
 
         if(compileResult == GL_FALSE)
@@ -31,10 +41,8 @@ namespace detail
         }
     }
 
-    void link(GLuint handle)
+    void checkLink(GLuint handle)
     {
-        glLinkProgram(handle);
-
         GLint result;
         glGetProgramiv(handle, GL_LINK_STATUS, &result);
 
@@ -57,31 +65,180 @@ namespace detail
             throw std::runtime_error((std::string("[Shader] ERROR link shaderprogram: \n") + programLog));
         }
     }
+
+    void reflect(ShaderProgram& program)
+    {
+        GLint count = 0;
+        GLint maxLength = 0;
+        glGetProgramiv(program.id, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(program.id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+        program.uniforms.clear();
+        program.uniforms.reserve(static_cast<std::size_t>(count));
+
+        std::string name(static_cast<std::size_t>(std::max(maxLength, 1)), '\0');
+        for(GLuint i = 0; i < static_cast<GLuint>(count); i++)
+        {
+            GLsizei length = 0;
+            ShaderUniformInfo info;
+            glGetActiveUniform(program.id, i, maxLength, &length, &info.size, &info.type, &name[0]);
+            info.name.assign(name.data(), static_cast<std::size_t>(length));
+
+            /* arrays are reported as "name[0]", store them under their plain name */
+            if(info.name.size() > 3 && info.name.compare(info.name.size() - 3, 3, "[0]") == 0)
+            {
+                info.name.resize(info.name.size() - 3);
+            }
+
+            /* members of uniform blocks have no location and are not set via glUniform* */
+            info.location = glGetUniformLocation(program.id, info.name.c_str());
+            if(info.location < 0)
+            {
+                continue;
+            }
+            program.uniforms.push_back(std::move(info));
+        }
+
+        std::sort(program.uniforms.begin(), program.uniforms.end(),
+                  [](const ShaderUniformInfo& a, const ShaderUniformInfo& b) { return a.name < b.name; });
+    }
+
+    void bindUniformBlocks(const ShaderProgram& program)
+    {
+        GLint count = 0;
+        glGetProgramiv(program.id, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+
+        for(GLuint i = 0; i < static_cast<GLuint>(count); i++)
+        {
+            GLchar name[128];
+            glGetActiveUniformBlockName(program.id, i, sizeof(name), nullptr, name);
+
+            int binding = uniformBlockBinding(name);
+            if(binding < 0)
+            {
+                std::cerr << "[Shader] Unknown uniform block " << name << ", left unbound" << std::endl;
+                continue;
+            }
+            glUniformBlockBinding(program.id, i, static_cast<GLuint>(binding));
+        }
+    }
+
+    const ShaderUniformInfo* findUniform(const ShaderProgram& program, const std::string& name)
+    {
+        auto it = std::lower_bound(program.uniforms.begin(), program.uniforms.end(), name,
+                                   [](const ShaderUniformInfo& info, const std::string& key) { return info.name < key; });
+        if(it == program.uniforms.end() || it->name != name)
+        {
+            return nullptr;
+        }
+        return &(*it);
+    }
 }
 
-ShaderProgram shaderCreate(const std::string &vertexSource, const std::string &fragmentSource)
+ShaderProgram shaderCreateAsync(const std::string &vertexSource, const std::string &fragmentSource, ShaderCache* cache, const std::string& cacheEntry)
 {
-    ShaderProgram program{glCreateProgram(), glCreateShader(GL_VERTEX_SHADER), glCreateShader(GL_FRAGMENT_SHADER)};
+    ShaderProgram program;
+    program.id = glCreateProgram();
 
-    if(!program._vertexID || !program._fragmentID || !program.id)
+    if(!program.id)
     {
         std::cerr << "[Shader] Couldn't create shader program!" << std::endl;
         std::cerr.flush();
         throw std::runtime_error("[Shader] Couldn't create shader program!");
     }
 
+    /* try the binary cache first, a hit skips compiling and linking entirely */
+    if(cache)
+    {
+        program._cache = cache;
+        program._cacheEntry = cacheEntry;
+        program._sourceHash = shaderCacheHash(fragmentSource, shaderCacheHash(vertexSource));
+        if(shaderCacheLoad(*cache, cacheEntry, program._sourceHash, program.id))
+        {
+            detail::reflect(program);
+            detail::bindUniformBlocks(program);
+            return program;
+        }
+    }
+
+    program._vertexID = glCreateShader(GL_VERTEX_SHADER);
+    program._fragmentID = glCreateShader(GL_FRAGMENT_SHADER);
+    if(!program._vertexID || !program._fragmentID)
+    {
+        std::cerr << "[Shader] Couldn't create shader program!" << std::endl;
+        std::cerr.flush();
+        throw std::runtime_error("[Shader] Couldn't create shader program!");
+    }
+
+    program._pending = true;
+    program._startTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    /* only issue compile and link here, errors are queried in shaderFinish so the driver can work in the background */
     detail::compile(program._vertexID, vertexSource.c_str(), vertexSource.size());
     glAttachShader(program.id, program._vertexID);
 
     detail::compile(program._fragmentID, fragmentSource.c_str(), fragmentSource.size());
     glAttachShader(program.id, program._fragmentID);
 
-    detail::link(program.id);
+    if(cache && cache->supported)
+    {
+        glProgramParameteri(program.id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    glLinkProgram(program.id);
 
     return program;
 }
 
-ShaderProgram shaderLoad(const std::string &vertexPath, const std::string &fragmentPath)
+bool shaderReady(const ShaderProgram &program)
+{
+    if(!program._pending)
+    {
+        return true;
+    }
+
+    /* without parallel compile support any status query blocks, so report ready and let shaderFinish wait */
+    if(!GLAD_GL_KHR_parallel_shader_compile && !GLAD_GL_ARB_parallel_shader_compile)
+    {
+        return true;
+    }
+
+    GLint done = GL_FALSE;
+    glGetProgramiv(program.id, GL_COMPLETION_STATUS_KHR, &done);
+    return done == GL_TRUE;
+}
+
+void shaderFinish(ShaderProgram &program)
+{
+    if(!program._pending)
+    {
+        return;
+    }
+    program._pending = false;
+
+    detail::checkCompile(program._vertexID);
+    detail::checkCompile(program._fragmentID);
+    detail::checkLink(program.id);
+
+    double now = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    program._compileMs = now - program._startTime;
+    if(program._cache)
+    {
+        shaderCacheStore(*program._cache, program._cacheEntry, program._sourceHash, program.id, program._compileMs);
+    }
+
+    detail::reflect(program);
+    detail::bindUniformBlocks(program);
+}
+
+ShaderProgram shaderCreate(const std::string &vertexSource, const std::string &fragmentSource, ShaderCache* cache, const std::string& cacheEntry)
+{
+    ShaderProgram program = shaderCreateAsync(vertexSource, fragmentSource, cache, cacheEntry);
+    shaderFinish(program);
+    return program;
+}
+
+ShaderProgram shaderLoad(const std::string &vertexPath, const std::string &fragmentPath, ShaderCache* cache)
 {
     std::ifstream vertexFile(vertexPath);
     std::ifstream fragmentFile(fragmentPath);
@@ -106,39 +263,119 @@ ShaderProgram shaderLoad(const std::string &vertexPath, const std::string &fragm
     std::stringstream fragmentSourceBuffer;
     fragmentSourceBuffer << fragmentFile.rdbuf();
 
-    return shaderCreate(vertexSourceBuffer.str(), fragmentSourceBuffer.str());
+    return shaderCreate(vertexSourceBuffer.str(), fragmentSourceBuffer.str(), cache, vertexPath + "|" + fragmentPath);
 }
 
 void shaderDelete(const ShaderProgram &program)
 {
-    glDetachShader(program.id, program._vertexID);
-    glDetachShader(program.id, program._fragmentID);
-    glDeleteShader(program._vertexID);
-    glDeleteShader(program._fragmentID);
+    glStateForgetProgram(program.id);
+
+    /* programs loaded from the binary cache have no shader objects */
+    if(program._vertexID)
+    {
+        glDetachShader(program.id, program._vertexID);
+        glDeleteShader(program._vertexID);
+    }
+    if(program._fragmentID)
+    {
+        glDetachShader(program.id, program._fragmentID);
+        glDeleteShader(program._fragmentID);
+    }
 
     glDeleteProgram(program.id);
 }
 
+bool shaderHasUniform(const ShaderProgram &shader, const std::string &name)
+{
+    return detail::findUniform(shader, name) != nullptr;
+}
+
+ShaderUniformHandle shaderUniformHandle(const ShaderProgram &shader, const std::string &name)
+{
+    const ShaderUniformInfo* info = detail::findUniform(shader, name);
+    if(!info)
+    {
+        std::cerr << "[Shader] Couldn't find uniform " << name << std::endl;
+        std::cerr.flush();
+        throw std::runtime_error("[Shader] Couldn't find uniform " + name);
+    }
+    return {info->location, info->type, info->size};
+}
+
+void shaderUniform(const ShaderUniformHandle &handle, const Matrix4D &value)
+{
+    assert(handle.type == GL_FLOAT_MAT4);
+    glUniformMatrix4fv(handle.location, 1, GL_FALSE, value.ptr());
+}
+
+void shaderUniform(const ShaderUniformHandle &handle, const Vector4D &value)
+{
+    assert(handle.type == GL_FLOAT_VEC4);
+    glUniform4f(handle.location, value.x, value.y, value.z, value.w);
+}
+
+void shaderUniform(const ShaderUniformHandle &handle, const Vector3D &value)
+{
+    assert(handle.type == GL_FLOAT_VEC3);
+    glUniform3f(handle.location, value.x, value.y, value.z);
+}
+
+void shaderUniform(const ShaderUniformHandle &handle, float value)
+{
+    assert(handle.type == GL_FLOAT);
+    glUniform1f(handle.location, value);
+}
+
+void shaderUniform(const ShaderUniformHandle &handle, int value)
+{
+    assert(handle.type != GL_FLOAT && handle.type != GL_FLOAT_MAT4);
+    glUniform1i(handle.location, value);
+}
+
+void shaderUniform(const ShaderUniformHandle &handle, const Matrix4D *values, int count)
+{
+    assert(handle.type == GL_FLOAT_MAT4 && count <= handle.size);
+    glUniformMatrix4fv(handle.location, count, GL_FALSE, values->ptr());
+}
+
+void shaderUniform(const ShaderUniformHandle &handle, const Vector4D *values, int count)
+{
+    assert(handle.type == GL_FLOAT_VEC4 && count <= handle.size);
+    glUniform4fv(handle.location, count, &values->x);
+}
+
+void shaderUniform(const ShaderUniformHandle &handle, const Vector3D *values, int count)
+{
+    assert(handle.type == GL_FLOAT_VEC3 && count <= handle.size);
+    glUniform3fv(handle.location, count, &values->x);
+}
+
+void shaderUniform(const ShaderUniformHandle &handle, const float *values, int count)
+{
+    assert(handle.type == GL_FLOAT && count <= handle.size);
+    glUniform1fv(handle.location, count, values);
+}
+
 void shaderUniform(ShaderProgram &shader, const std::string &name, const Matrix4D &value)
 {
-    GLint index = glGetUniformLocation(shader.id, name.c_str());
-    if(index < 0)
+    const ShaderUniformInfo* info = detail::findUniform(shader, name);
+    if(!info)
     {
         std::cerr << "[Shader] Couldn't set value for uniform " << name << std::endl;
         std::cerr.flush();
         throw std::runtime_error("[Shader] Couldn't set value for uniform " + name);
     }
-    glUniformMatrix4fv(index, 1, GL_FALSE, value.ptr());
+    glUniformMatrix4fv(info->location, 1, GL_FALSE, value.ptr());
 }
 
 void shaderUniform(ShaderProgram &shader, const std::string &name, int value)
 {
-    GLint index = glGetUniformLocation(shader.id, name.c_str());
-    if(index < 0)
+    const ShaderUniformInfo* info = detail::findUniform(shader, name);
+    if(!info)
     {
         std::cerr << "[Shader] Couldn't set value for uniform " << name << std::endl;
         std::cerr.flush();
         throw std::runtime_error("[Shader] Couldn't set value for uniform " + name);
     }
-    glUniform1i(index, value);
+    glUniform1i(info->location, value);
 }
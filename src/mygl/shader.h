@@ -2,11 +2,44 @@
 
 #include "base.h"
 
+#include <cstdint>
+#include <vector>
+
+struct ShaderCache;
+
+/* one active uniform of a linked program, as reported by glGetActiveUniform */
+struct ShaderUniformInfo
+{
+    std::string name;
+    GLint location = -1;
+    GLenum type = 0;
+    GLint size = 0;
+};
+
+/* pre-resolved uniform, set without any string lookup (see shaderUniformHandle) */
+struct ShaderUniformHandle
+{
+    GLint location = -1;
+    GLenum type = 0;
+    GLint size = 0;
+};
+
 struct ShaderProgram
 {
     GLuint id = 0;
     GLuint _vertexID = 0;
     GLuint _fragmentID = 0;
+
+    /* active uniforms sorted by name, filled by shaderCreate after linking */
+    std::vector<ShaderUniformInfo> uniforms;
+
+    /* state of a compile/link started by shaderCreateAsync, completed by shaderFinish */
+    bool _pending = false;
+    double _startTime = 0.0;
+    double _compileMs = 0.0;
+    ShaderCache* _cache = nullptr;
+    std::string _cacheEntry;
+    uint64_t _sourceHash = 0;
 };
 
 /**
@@ -14,20 +47,57 @@ struct ShaderProgram
  *
  * @param vertexPath Path to vertex shader file.
  * @param fragmentPath Path to fragment shader file.
+ * @param cache Optional program binary cache (see shadercache.h), the entry is identified by the two paths.
  *
  * @return Shader program.
  */
-ShaderProgram shaderLoad(const std::string& vertexPath, const std::string& fragmentPath);
+ShaderProgram shaderLoad(const std::string& vertexPath, const std::string& fragmentPath, ShaderCache* cache = nullptr);
 
 /**
- * @brief Function to compile and link vertex and fragement source strings to create shader program.
+ * @brief Function to compile and link vertex and fragement source strings to create shader program. After linking, the
+ * active uniforms are reflected and known uniform blocks are bound to their fixed binding points (see uniformbuffer.h).
  *
  * @param vertexSource Source string holding vertex shader code.
  * @param fragmentSource Source string holding fragment shader code.
+ * @param cache Optional program binary cache (see shadercache.h). On a hit the program is loaded via glProgramBinary
+ * and has no shader objects, on a miss the linked binary is stored.
+ * @param cacheEntry Identity of the program in the cache (e.g. file paths and defines).
  *
  * @return Shader program.
  */
-ShaderProgram shaderCreate(const std::string& vertexSource, const std::string& fragmentSource);
+ShaderProgram shaderCreate(const std::string& vertexSource, const std::string& fragmentSource, ShaderCache* cache = nullptr, const std::string& cacheEntry = "");
+
+/**
+ * @brief Function to start compiling and linking vertex and fragment source strings without waiting for the driver.
+ * With GL_KHR_parallel_shader_compile the work runs on driver threads, poll with shaderReady and complete the program
+ * with shaderFinish before using it. Compile and link errors are only reported by shaderFinish.
+ *
+ * @param vertexSource Source string holding vertex shader code.
+ * @param fragmentSource Source string holding fragment shader code.
+ * @param cache Optional program binary cache (see shadercache.h), a hit returns an already finished program.
+ * @param cacheEntry Identity of the program in the cache (e.g. file paths and defines).
+ *
+ * @return Shader program, possibly still being compiled.
+ */
+ShaderProgram shaderCreateAsync(const std::string& vertexSource, const std::string& fragmentSource, ShaderCache* cache = nullptr, const std::string& cacheEntry = "");
+
+/**
+ * @brief Function to check without blocking whether a program started by shaderCreateAsync has finished compiling and
+ * linking. Always true if the driver doesn't support parallel compilation.
+ *
+ * @param program Shader program.
+ *
+ * @return True if shaderFinish won't block.
+ */
+bool shaderReady(const ShaderProgram& program);
+
+/**
+ * @brief Function to complete a program started by shaderCreateAsync: checks compile and link status, stores the
+ * binary in the cache and reflects the uniforms. Blocks until the driver is done. Does nothing for finished programs.
+ *
+ * @param program Shader program.
+ */
+void shaderFinish(ShaderProgram& program);
 
 /**
  * @brief Cleanup and delete all shaders of a shader program and the program itself. Has to be called for each shader program after it is not used anymore.
@@ -37,7 +107,60 @@ ShaderProgram shaderCreate(const std::string& vertexSource, const std::string& f
 void shaderDelete(const ShaderProgram& program);
 
 /**
- * @brief Function to set uniform in shader program.
+ * @brief Function to resolve a uniform of a shader program once, so it can be set later without a lookup.
+ * The handle is only valid for the program it was resolved from.
+ *
+ * @param shader Shader program.
+ * @param name Uniform name (for arrays without the "[0]" suffix).
+ *
+ * @return Handle of the uniform.
+ *
+ * usage:
+ *
+ *   ShaderUniformHandle uModel = shaderUniformHandle(myShader, "uModel");
+ *   glUseProgram(myShader.id);
+ *   shaderUniform(uModel, modelMatrix);
+ *
+ */
+ShaderUniformHandle shaderUniformHandle(const ShaderProgram& shader, const std::string& name);
+
+/**
+ * @brief Function to check whether a shader program has an active uniform, e.g. one that only some variants use.
+ *
+ * @param shader Shader program.
+ * @param name Uniform name (for arrays without the "[0]" suffix).
+ *
+ * @return True if the uniform is active.
+ */
+bool shaderHasUniform(const ShaderProgram& shader, const std::string& name);
+
+/**
+ * @brief Function to set a uniform of the currently used shader program via a pre-resolved handle.
+ *
+ * @param handle Uniform handle (see shaderUniformHandle).
+ * @param value Value to which the uniform should be set.
+ */
+void shaderUniform(const ShaderUniformHandle& handle, const Matrix4D& value);
+void shaderUniform(const ShaderUniformHandle& handle, const Vector4D& value);
+void shaderUniform(const ShaderUniformHandle& handle, const Vector3D& value);
+void shaderUniform(const ShaderUniformHandle& handle, float value);
+void shaderUniform(const ShaderUniformHandle& handle, int value);
+
+/**
+ * @brief Function to set a uniform array of the currently used shader program via a pre-resolved handle.
+ *
+ * @param handle Uniform handle (see shaderUniformHandle).
+ * @param values Pointer to the first of count values.
+ * @param count Number of array elements to set.
+ */
+void shaderUniform(const ShaderUniformHandle& handle, const Matrix4D* values, int count);
+void shaderUniform(const ShaderUniformHandle& handle, const Vector4D* values, int count);
+void shaderUniform(const ShaderUniformHandle& handle, const Vector3D* values, int count);
+void shaderUniform(const ShaderUniformHandle& handle, const float* values, int count);
+
+/**
+ * @brief Function to set uniform in shader program. Slow path, looks up the uniform by name on every call; prefer
+ * resolving a handle once with shaderUniformHandle.
  *
  * @param shader Shader program.
  * @param name Uniform naem.
@@ -46,7 +169,8 @@ void shaderDelete(const ShaderProgram& program);
 void shaderUniform(ShaderProgram& shader, const std::string& name, const Matrix4D& value);
 
 /**
- * @brief Function to set uniform in shader program.
+ * @brief Function to set uniform in shader program. Slow path, looks up the uniform by name on every call; prefer
+ * resolving a handle once with shaderUniformHandle.
  *
  * @param shader Shader program.
  * @param name Uniform naem.
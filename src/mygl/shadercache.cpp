@@ -0,0 +1,186 @@
+#include "shadercache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace detail
+{
+    const uint32_t cacheMagic = 0x53474c4d;   // "MLGS"
+    const uint32_t cacheVersion = 1;
+
+    struct CacheHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t sourceHash;
+        uint64_t driverHash;
+        uint32_t binaryFormat;
+        uint32_t binaryLength;
+        double compileMs;
+    };
+
+    std::string entryPath(const ShaderCache& cache, const std::string& entry)
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(shaderCacheHash(entry)));
+        return (std::filesystem::path(cache.directory) / name).string();
+    }
+
+    std::string glString(GLenum name)
+    {
+        const GLubyte* value = glGetString(name);
+        return value ? reinterpret_cast<const char*>(value) : "";
+    }
+}
+
+ShaderCache shaderCacheCreate(const std::string& directory)
+{
+    ShaderCache cache;
+    cache.directory = directory;
+
+    GLint formats = 0;
+    if(GLAD_GL_ARB_get_program_binary && glProgramBinary && glGetProgramBinary)
+    {
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    }
+    cache.supported = formats > 0;
+    if(!cache.supported)
+    {
+        std::cerr << "[ShaderCache] Driver offers no program binary formats, cache disabled" << std::endl;
+        return cache;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if(error)
+    {
+        std::cerr << "[ShaderCache] Couldn't create cache directory " << directory << ": " << error.message() << std::endl;
+        cache.supported = false;
+        return cache;
+    }
+
+    uint64_t hash = shaderCacheHash(detail::glString(GL_VENDOR));
+    hash = shaderCacheHash(detail::glString(GL_RENDERER), hash);
+    hash = shaderCacheHash(detail::glString(GL_VERSION), hash);
+    hash = shaderCacheHash(detail::glString(GL_SHADING_LANGUAGE_VERSION), hash);
+    cache.driverHash = hash;
+
+    return cache;
+}
+
+uint64_t shaderCacheHash(const std::string& data, uint64_t seed)
+{
+    uint64_t hash = seed;
+    for(unsigned char c : data)
+    {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+bool shaderCacheLoad(ShaderCache& cache, const std::string& entry, uint64_t sourceHash, GLuint program)
+{
+    if(!cache.supported)
+    {
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::string path = detail::entryPath(cache, entry);
+
+    std::ifstream file(path, std::ios::binary);
+    if(!file.is_open())
+    {
+        cache.misses++;
+        return false;
+    }
+
+    detail::CacheHeader header{};
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+    bool valid = file.good() && header.magic == detail::cacheMagic && header.version == detail::cacheVersion
+                 && header.sourceHash == sourceHash && header.driverHash == cache.driverHash;
+
+    std::vector<char> binary;
+    if(valid)
+    {
+        binary.resize(header.binaryLength);
+        file.read(binary.data(), header.binaryLength);
+        valid = file.good();
+    }
+    file.close();
+
+    if(valid)
+    {
+        glProgramBinary(program, header.binaryFormat, binary.data(), static_cast<GLsizei>(binary.size()));
+
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        valid = linked == GL_TRUE;
+    }
+
+    if(!valid)
+    {
+        /* sources, driver or file format changed since the binary was stored */
+        std::filesystem::remove(path);
+        cache.stale++;
+        cache.misses++;
+        return false;
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    cache.hits++;
+    cache.loadMs += ms;
+    cache.savedMs += std::max(0.0, header.compileMs - ms);
+    return true;
+}
+
+void shaderCacheStore(ShaderCache& cache, const std::string& entry, uint64_t sourceHash, GLuint program, double compileMs)
+{
+    cache.compileMs += compileMs;
+    if(!cache.supported)
+    {
+        return;
+    }
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if(length <= 0)
+    {
+        return;
+    }
+
+    std::vector<char> binary(static_cast<std::size_t>(length));
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+
+    detail::CacheHeader header{detail::cacheMagic, detail::cacheVersion, sourceHash, cache.driverHash,
+                               format, static_cast<uint32_t>(length), compileMs};
+
+    std::string path = detail::entryPath(cache, entry);
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if(!file.is_open())
+    {
+        std::cerr << "[ShaderCache] Couldn't write " << path << std::endl;
+        return;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(binary.data(), length);
+}
+
+void shaderCacheReport(const ShaderCache& cache)
+{
+    if(!cache.supported)
+    {
+        return;
+    }
+    std::cout << "[ShaderCache] " << cache.hits << " hit(s), " << cache.misses << " miss(es) (" << cache.stale << " stale)"
+              << ", loaded in " << cache.loadMs << " ms, compiled in " << cache.compileMs << " ms"
+              << ", saved ~" << cache.savedMs << " ms" << std::endl;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "base.h"
+
+#include <cstdint>
+
+/**
+ * On-disk cache of linked program binaries (GL_ARB_get_program_binary). Every entry is one file named after the
+ * program identity (shader paths and defines). Its header stores a hash of the final shader sources and of the driver
+ * (vendor, renderer, version), so entries whose sources or driver changed are detected as stale, dropped and
+ * overwritten by the freshly compiled program.
+ */
+struct ShaderCache
+{
+    std::string directory;
+    uint64_t driverHash = 0;
+    bool supported = false;     // driver exposes at least one program binary format
+
+    unsigned int hits = 0;
+    unsigned int misses = 0;
+    unsigned int stale = 0;
+    double loadMs = 0.0;        // time spent loading binaries
+    double compileMs = 0.0;     // time spent compiling and linking on misses
+    double savedMs = 0.0;       // compile time avoided by hits (recorded compile time minus load time)
+};
+
+/**
+ * @brief Creates a program binary cache for the current OpenGL context.
+ *
+ * @param directory Directory the binaries are stored in, created if it doesn't exist.
+ *
+ * @return Initialized cache (disabled if the driver offers no binary formats).
+ */
+ShaderCache shaderCacheCreate(const std::string& directory);
+
+/**
+ * @brief 64 bit FNV-1a hash used for cache keys.
+ *
+ * @param data Data to hash.
+ * @param seed Hash to continue from, allows hashing several strings in a row.
+ *
+ * @return Hash value.
+ */
+uint64_t shaderCacheHash(const std::string& data, uint64_t seed = 14695981039346656037ull);
+
+/**
+ * @brief Tries to load a cached binary into a program object. Stale or rejected entries are removed.
+ *
+ * @param cache Shader cache.
+ * @param entry Identity of the program (e.g. shader paths and defines).
+ * @param sourceHash Hash of the final shader sources.
+ * @param program Program object the binary is loaded into.
+ *
+ * @return True if the program was loaded and linked successfully from the cache.
+ */
+bool shaderCacheLoad(ShaderCache& cache, const std::string& entry, uint64_t sourceHash, GLuint program);
+
+/**
+ * @brief Stores the binary of a freshly linked program. The program has to be linked with
+ * GL_PROGRAM_BINARY_RETRIEVABLE_HINT set.
+ *
+ * @param cache Shader cache.
+ * @param entry Identity of the program (e.g. shader paths and defines).
+ * @param sourceHash Hash of the final shader sources.
+ * @param program Linked program object.
+ * @param compileMs Time it took to compile and link the program, used to report the time saved on later hits.
+ */
+void shaderCacheStore(ShaderCache& cache, const std::string& entry, uint64_t sourceHash, GLuint program, double compileMs);
+
+/**
+ * @brief Prints hits, misses and the time saved by the cache.
+ *
+ * @param cache Shader cache.
+ */
+void shaderCacheReport(const ShaderCache& cache);
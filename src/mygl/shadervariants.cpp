@@ -0,0 +1,245 @@
+#include "shadervariants.h"
+#include "shadercache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace detail
+{
+    double nowMs()
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    std::string readFile(const std::string& path)
+    {
+        std::ifstream file(path);
+        if(!file.is_open())
+        {
+            std::cerr << "[Shader] Couldn't open shader file at " << path << std::endl;
+            std::cerr.flush();
+            throw std::runtime_error("[Shader] Couldn't open shader file at " + path);
+        }
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        return buffer.str();
+    }
+
+    /* expands #include "file" directives (relative to the including file), every file is included at most once */
+    void resolveIncludes(const std::string& path, std::vector<std::string>& included, std::string& out)
+    {
+        if(std::find(included.begin(), included.end(), path) != included.end())
+        {
+            return;
+        }
+        included.push_back(path);
+
+        std::istringstream source(readFile(path));
+        std::filesystem::path directory = std::filesystem::path(path).parent_path();
+
+        std::string line;
+        while(std::getline(source, line))
+        {
+            std::size_t start = line.find_first_not_of(" \t");
+            if(start != std::string::npos && line.compare(start, 8, "#include") == 0)
+            {
+                std::size_t open = line.find('"', start + 8);
+                std::size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+                if(close == std::string::npos)
+                {
+                    throw std::runtime_error("[Shader] Malformed #include in " + path + ": " + line);
+                }
+                std::string includePath = (directory / line.substr(open + 1, close - open - 1)).lexically_normal().string();
+                resolveIncludes(includePath, included, out);
+                continue;
+            }
+            out += line;
+            out += '\n';
+        }
+    }
+
+    const std::string& resolvedSource(ShaderLibrary& library, const std::string& path)
+    {
+        auto it = library.sources.find(path);
+        if(it == library.sources.end())
+        {
+            std::vector<std::string> included;
+            std::string source;
+            resolveIncludes(path, included, source);
+            it = library.sources.emplace(path, std::move(source)).first;
+        }
+        return it->second;
+    }
+
+    /* inserts one #define per entry right after the #version line */
+    std::string injectDefines(const std::string& source, const std::vector<std::string>& defines)
+    {
+        std::string block;
+        for(const std::string& define : defines)
+        {
+            std::size_t assign = define.find('=');
+            block += "#define " + (assign == std::string::npos ? define : define.substr(0, assign) + " " + define.substr(assign + 1)) + "\n";
+        }
+
+        std::size_t version = source.find("#version");
+        std::size_t insert = version == std::string::npos ? 0 : source.find('\n', version);
+        insert = insert == std::string::npos ? source.size() : insert + 1;
+
+        std::string result = source;
+        result.insert(insert, block);
+        return result;
+    }
+
+    std::string variantKey(const std::string& vertexPath, const std::string& fragmentPath, const std::vector<std::string>& defines)
+    {
+        std::string key = vertexPath + "|" + fragmentPath;
+        for(const std::string& define : defines)
+        {
+            key += "|" + define;
+        }
+        return key;
+    }
+
+    void finishVariant(ShaderLibrary& library, ShaderVariant& variant)
+    {
+        bool wasPending = variant.program._pending;
+        shaderFinish(variant.program);
+        if(wasPending)
+        {
+            library.compileMs += variant.program._compileMs;
+        }
+    }
+
+    void finishBatch(ShaderLibrary& library)
+    {
+        if(library.pending.empty() && library._batchStart >= 0.0)
+        {
+            library.wallMs += nowMs() - library._batchStart;
+            library._batchStart = -1.0;
+        }
+    }
+}
+
+ShaderLibrary shaderLibraryCreate(ShaderCache* cache)
+{
+    ShaderLibrary library;
+    library.cache = cache;
+
+    /* let the driver pick the number of compiler threads */
+    if(GLAD_GL_KHR_parallel_shader_compile && glMaxShaderCompilerThreadsKHR)
+    {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        library.parallel = true;
+    }
+    else if(GLAD_GL_ARB_parallel_shader_compile && glMaxShaderCompilerThreadsARB)
+    {
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+        library.parallel = true;
+    }
+
+    return library;
+}
+
+std::string shaderVariantRequest(ShaderLibrary& library, const std::string& vertexPath, const std::string& fragmentPath,
+                                 std::vector<std::string> defines)
+{
+    std::sort(defines.begin(), defines.end());
+    defines.erase(std::unique(defines.begin(), defines.end()), defines.end());
+
+    std::string key = detail::variantKey(vertexPath, fragmentPath, defines);
+    if(library.variants.count(key))
+    {
+        return key;
+    }
+
+    if(library._batchStart < 0.0)
+    {
+        library._batchStart = detail::nowMs();
+    }
+
+    std::string vertexSource = detail::injectDefines(detail::resolvedSource(library, vertexPath), defines);
+    std::string fragmentSource = detail::injectDefines(detail::resolvedSource(library, fragmentPath), defines);
+
+    ShaderVariant variant{vertexPath, fragmentPath, defines,
+                          shaderCreateAsync(vertexSource, fragmentSource, library.cache, key)};
+    bool pending = variant.program._pending;
+    library.variants.emplace(key, std::move(variant));
+
+    if(pending)
+    {
+        library.pending.push_back(key);
+    }
+    detail::finishBatch(library);
+
+    return key;
+}
+
+ShaderProgram& shaderVariantGet(ShaderLibrary& library, const std::string& key)
+{
+    auto it = library.variants.find(key);
+    if(it == library.variants.end())
+    {
+        std::cerr << "[Shader] Unknown shader variant " << key << std::endl;
+        std::cerr.flush();
+        throw std::runtime_error("[Shader] Unknown shader variant " + key);
+    }
+
+    if(it->second.program._pending)
+    {
+        detail::finishVariant(library, it->second);
+        library.pending.erase(std::find(library.pending.begin(), library.pending.end(), key));
+        detail::finishBatch(library);
+    }
+    return it->second.program;
+}
+
+unsigned int shaderLibraryPoll(ShaderLibrary& library)
+{
+    auto done = std::remove_if(library.pending.begin(), library.pending.end(), [&library](const std::string& key)
+    {
+        ShaderVariant& variant = library.variants.at(key);
+        if(!shaderReady(variant.program))
+        {
+            return false;
+        }
+        detail::finishVariant(library, variant);
+        return true;
+    });
+    library.pending.erase(done, library.pending.end());
+    detail::finishBatch(library);
+
+    return static_cast<unsigned int>(library.pending.size());
+}
+
+void shaderLibraryWait(ShaderLibrary& library)
+{
+    for(const std::string& key : library.pending)
+    {
+        detail::finishVariant(library, library.variants.at(key));
+    }
+    library.pending.clear();
+    detail::finishBatch(library);
+}
+
+void shaderLibraryReport(const ShaderLibrary& library)
+{
+    std::cout << "[Shader] " << library.variants.size() << " variant(s), " << library.pending.size() << " pending"
+              << ", compile time " << library.compileMs << " ms (" << library.wallMs << " ms wall"
+              << (library.parallel ? ", parallel" : "") << ")" << std::endl;
+}
+
+void shaderLibraryDelete(ShaderLibrary& library)
+{
+    shaderLibraryWait(library);
+    for(auto& entry : library.variants)
+    {
+        shaderDelete(entry.second.program);
+    }
+    library.variants.clear();
+    library.sources.clear();
+}
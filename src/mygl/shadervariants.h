@@ -0,0 +1,106 @@
+#pragma once
+
+#include "shader.h"
+
+#include <unordered_map>
+#include <vector>
+
+struct ShaderCache;
+
+/* one permutation of a vertex/fragment shader pair */
+struct ShaderVariant
+{
+    std::string vertexPath;
+    std::string fragmentPath;
+    std::vector<std::string> defines;   // sorted, "NAME" or "NAME=VALUE"
+    ShaderProgram program;
+};
+
+/**
+ * Library of shader permutations. A vertex/fragment file pair plus a set of defines yields one cached program. Source
+ * files are read and their #include "file" directives resolved once, the defines are injected after the #version line.
+ * Requested variants are compiled in bulk in the background (GL_KHR_parallel_shader_compile) and completed by polling.
+ */
+struct ShaderLibrary
+{
+    ShaderCache* cache = nullptr;
+    bool parallel = false;
+
+    std::unordered_map<std::string, std::string> sources;       // resolved source by file path
+    std::unordered_map<std::string, ShaderVariant> variants;    // by variant key
+    std::vector<std::string> pending;                           // keys of variants still compiling
+
+    double compileMs = 0.0;     // summed compile and link time of all finished variants
+    double wallMs = 0.0;        // time from the first request of a batch until its last variant finished
+    double _batchStart = -1.0;
+};
+
+/**
+ * @brief Creates an empty shader library and enables parallel shader compilation if the driver supports it.
+ *
+ * @param cache Optional program binary cache used for all variants.
+ *
+ * @return Initialized shader library.
+ */
+ShaderLibrary shaderLibraryCreate(ShaderCache* cache = nullptr);
+
+/**
+ * @brief Requests a shader permutation. If it doesn't exist yet, its compilation is started without waiting.
+ *
+ * @param library Shader library.
+ * @param vertexPath Path to vertex shader file.
+ * @param fragmentPath Path to fragment shader file.
+ * @param defines Preprocessor defines, "NAME" or "NAME=VALUE" (order doesn't matter).
+ *
+ * @return Key identifying the variant in the library.
+ *
+ * usage:
+ *
+ *   std::string key = shaderVariantRequest(library, "shader/default.vert", "shader/default.frag", {"INSTANCED"});
+ *   ... more requests and other initialization ...
+ *   shaderLibraryWait(library);
+ *   ShaderProgram& program = shaderVariantGet(library, key);
+ *
+ */
+std::string shaderVariantRequest(ShaderLibrary& library, const std::string& vertexPath, const std::string& fragmentPath,
+                                 std::vector<std::string> defines = {});
+
+/**
+ * @brief Returns the program of a variant, blocks until it is finished if it is still compiling.
+ *
+ * @param library Shader library.
+ * @param key Variant key returned by shaderVariantRequest.
+ *
+ * @return Finished shader program, owned by the library.
+ */
+ShaderProgram& shaderVariantGet(ShaderLibrary& library, const std::string& key);
+
+/**
+ * @brief Finishes all variants whose compilation is done without blocking.
+ *
+ * @param library Shader library.
+ *
+ * @return Number of variants still compiling.
+ */
+unsigned int shaderLibraryPoll(ShaderLibrary& library);
+
+/**
+ * @brief Finishes all pending variants, blocking until the driver is done.
+ *
+ * @param library Shader library.
+ */
+void shaderLibraryWait(ShaderLibrary& library);
+
+/**
+ * @brief Prints the number of variants and the time spent compiling them.
+ *
+ * @param library Shader library.
+ */
+void shaderLibraryReport(const ShaderLibrary& library);
+
+/**
+ * @brief Deletes all programs of the library. Has to be called for each library after it is not used anymore.
+ *
+ * @param library Shader library to delete.
+ */
+void shaderLibraryDelete(ShaderLibrary& library);
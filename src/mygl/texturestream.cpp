@@ -0,0 +1,392 @@
+#include "texturestream.h"
+#include "glstate.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#include <stb_image/stb_image.h>
+#include <stb_image/stb_image_resize.h>
+
+namespace detail
+{
+/* bytes of a mipmap level of a layer */
+size_t textureLevelBytes(int layerSize, int level)
+{
+    size_t size = size_t(std::max(layerSize >> level, 1));
+    return size * size * 4;
+}
+
+/* bytes of all mipmap levels of a layer */
+size_t textureLayerBytes(int layerSize, int levels)
+{
+    size_t bytes = 0;
+    for(int level = 0; level < levels; level++)
+        bytes += textureLevelBytes(layerSize, level);
+    return bytes;
+}
+
+/* runs on a worker: decode to RGBA with the bottom row first as OpenGL expects it, resample to the layer size and
+ * compute the mipmaps, glGenerateMipmap would recompute every layer of the array */
+void textureDecodeTask(void* data)
+{
+    PROFILE_CPU("texture decode");
+    auto* decode = static_cast<TextureDecode*>(data);
+    auto start = std::chrono::steady_clock::now();
+    stbi_set_flip_vertically_on_load_thread(1);
+    int channels = 0;
+    unsigned char* pixels = stbi_load(decode->path.c_str(), &decode->width, &decode->height, &channels, 4);
+    if(pixels)
+    {
+        int size = decode->layerSize;
+        int levels = 1;
+        while((size >> levels) > 0)
+            levels++;
+        decode->levels.resize(textureLayerBytes(size, levels));
+
+        unsigned char* level = decode->levels.data();
+        if(decode->width == size && decode->height == size)
+            std::memcpy(level, pixels, textureLevelBytes(size, 0));
+        else
+            stbir_resize_uint8(pixels, decode->width, decode->height, 0, level, size, size, 0, 4);
+        for(int i = 1; i < levels; i++)
+        {
+            unsigned char* next = level + textureLevelBytes(size, i - 1);
+            int previousSize = std::max(size >> (i - 1), 1);
+            int nextSize = std::max(size >> i, 1);
+            stbir_resize_uint8(level, previousSize, previousSize, 0, next, nextSize, nextSize, 0, 4);
+            level = next;
+        }
+        stbi_image_free(pixels);
+    }
+    decode->decodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/* staging buffer -> layer of the array, the pixel copy runs asynchronously on the GPU side */
+void textureUpload(TextureStream& stream, const TextureDecode& decode, int layer)
+{
+    size_t size = decode.levels.size();
+    GLuint pbo = stream.staging[stream.nextStaging];
+    stream.nextStaging = (stream.nextStaging + 1) % TextureStream::kStagingBuffers;
+
+    /* orphan the previous storage, an upload still reading from it isn't waited for */
+    glStateBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    const unsigned char* source = nullptr;
+    if(mapped)
+    {
+        std::memcpy(mapped, decode.levels.data(), size);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+    else
+    {
+        /* upload from client memory instead */
+        glStateBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        source = decode.levels.data();
+    }
+
+    glStateBindTexture(0, GL_TEXTURE_2D_ARRAY, stream.array);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    size_t offset = 0;
+    for(int level = 0; level < stream.levels; level++)
+    {
+        GLsizei levelSize = std::max(stream.settings.layerSize >> level, 1);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, levelSize, levelSize, 1, GL_RGBA, GL_UNSIGNED_BYTE,
+                        source ? static_cast<const void*>(source + offset) : reinterpret_cast<const void*>(offset));
+        offset += textureLevelBytes(stream.settings.layerSize, level);
+    }
+    glStateBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+/* allocates the array, or reallocates it with twice the layers up to the budget and keeps the existing layers: the
+ * levels are read into a buffer object and written back after they were respecified, so the copy stays on the GPU.
+ * The name of the array doesn't change, draw packets that already reference it stay valid */
+bool textureGrow(TextureStream& stream)
+{
+    if(stream.layers >= stream.maxLayers)
+        return false;
+    int layers = std::min(stream.layers > 0 ? stream.layers * 2 : TextureStream::kInitialLayers, stream.maxLayers);
+
+    /* read all levels before the first one is respecified, so the array is never read with mixed layer counts */
+    GLuint copy = 0;
+    glStateBindTexture(0, GL_TEXTURE_2D_ARRAY, stream.array);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if(stream.layers > 0)
+    {
+        glGenBuffers(1, &copy);
+        glStateBindBuffer(GL_PIXEL_PACK_BUFFER, copy);
+        glBufferData(GL_PIXEL_PACK_BUFFER, textureLayerBytes(stream.settings.layerSize, stream.levels) * stream.layers,
+                     nullptr, GL_STREAM_COPY);
+        size_t offset = 0;
+        for(int level = 0; level < stream.levels; level++)
+        {
+            glGetTexImage(GL_TEXTURE_2D_ARRAY, level, GL_RGBA, GL_UNSIGNED_BYTE, reinterpret_cast<void*>(offset));
+            offset += textureLevelBytes(stream.settings.layerSize, level) * stream.layers;
+        }
+        glStateBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    /* no unpack buffer while respecifying, the null pointer would be an offset into it */
+    glStateBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    for(int level = 0; level < stream.levels; level++)
+    {
+        GLsizei levelSize = std::max(stream.settings.layerSize >> level, 1);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, levelSize, levelSize, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                     nullptr);
+    }
+
+    if(copy != 0)
+    {
+        glStateBindBuffer(GL_PIXEL_UNPACK_BUFFER, copy);
+        size_t offset = 0;
+        for(int level = 0; level < stream.levels; level++)
+        {
+            GLsizei levelSize = std::max(stream.settings.layerSize >> level, 1);
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, levelSize, levelSize, stream.layers, GL_RGBA,
+                            GL_UNSIGNED_BYTE, reinterpret_cast<const void*>(offset));
+            offset += textureLevelBytes(stream.settings.layerSize, level) * stream.layers;
+        }
+        glStateBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glStateForgetBuffer(copy);
+        glDeleteBuffers(1, &copy);
+    }
+
+    for(int layer = layers - 1; layer >= std::max(stream.layers, 1); layer--)
+        stream.freeLayers.push_back(layer);
+    if(stream.layers > 0)
+        stream.stats.growths++;
+    stream.layers = layers;
+    return true;
+}
+
+/* free the layer of the least recently used texture, false if all of them are still in use */
+bool textureEvict(TextureStream& stream)
+{
+    std::lock_guard<std::mutex> lock(stream.mutex);
+    StreamedTexture* oldest = nullptr;
+    for(StreamedTexture& texture : stream.textures)
+    {
+        /* textures of the frame being drawn and the one being simulated are still referenced by draw packets */
+        if(texture.state == TextureState::Resident && texture.lastUsed + 1 < stream.frame
+           && (!oldest || texture.lastUsed < oldest->lastUsed))
+            oldest = &texture;
+    }
+    if(!oldest)
+        return false;
+
+    stream.freeLayers.push_back(oldest->layer);
+    oldest->layer = 0;
+    oldest->state = TextureState::Unloaded;
+    stream.stats.residentLayers--;
+    stream.stats.evictions++;
+    return true;
+}
+}
+
+void textureStreamCreate(TextureStream& stream, const TextureStreamSettings& settings)
+{
+    stream.settings = settings;
+    GLint maxSize = 2048;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+    int size = 1;
+    while(size < settings.layerSize && size < maxSize)
+        size *= 2;
+    stream.settings.layerSize = size;
+    stream.levels = 1;
+    while((size >> stream.levels) > 0)
+        stream.levels++;
+
+    /* as many layers as fit into the budget, at least the placeholder and one texture; the array starts small and
+     * grows when it is full */
+    GLint maxLayers = 256;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+    size_t layerBytes = detail::textureLayerBytes(size, stream.levels);
+    stream.maxLayers = int(std::clamp<size_t>(settings.budgetBytes / layerBytes, 2, size_t(maxLayers)));
+
+    glGenTextures(1, &stream.array);
+    stream.layers = 0;
+    detail::textureGrow(stream);
+    glStateBindTexture(0, GL_TEXTURE_2D_ARRAY, stream.array);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+    /* layer 0 is the white placeholder */
+    std::vector<unsigned char> white(detail::textureLevelBytes(size, 0), 255);
+    for(int level = 0; level < stream.levels; level++)
+    {
+        GLsizei levelSize = std::max(size >> level, 1);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, levelSize, levelSize, 1, GL_RGBA, GL_UNSIGNED_BYTE,
+                        white.data());
+    }
+    glGenBuffers(TextureStream::kStagingBuffers, stream.staging);
+}
+
+int textureStreamAdd(TextureStream& stream, const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(stream.mutex);
+    for(size_t i = 0; i < stream.textures.size(); i++)
+    {
+        if(stream.textures[i].path == path)
+            return int(i);
+    }
+    StreamedTexture texture;
+    texture.path = path;
+    stream.textures.push_back(texture);
+    return int(stream.textures.size()) - 1;
+}
+
+int textureStreamUse(TextureStream& stream, int texture)
+{
+    std::lock_guard<std::mutex> lock(stream.mutex);
+    if(texture < 0 || size_t(texture) >= stream.textures.size())
+        return 0;
+
+    StreamedTexture& entry = stream.textures[texture];
+    entry.lastUsed = stream.frame;
+    if(entry.state == TextureState::Unloaded)
+    {
+        entry.state = TextureState::Queued;
+        stream.queued.push_back(texture);
+    }
+    return entry.layer;
+}
+
+void textureStreamUpdate(TextureStream& stream)
+{
+    PROFILE_CPU("texture streaming");
+
+    /* finished decodes wait for the upload budget */
+    for(size_t i = 0; i < stream.decoding.size();)
+    {
+        TextureDecode& decode = *stream.decoding[i];
+        if(!jobDone(decode.counter))
+        {
+            i++;
+            continue;
+        }
+        stream.stats.decodeMs += decode.decodeMs;
+        if(decode.levels.empty())
+        {
+            std::cerr << "[Textures] Could not load " << decode.path << std::endl;
+            std::lock_guard<std::mutex> lock(stream.mutex);
+            stream.textures[decode.texture].state = TextureState::Failed;
+            stream.stats.failures++;
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lock(stream.mutex);
+            stream.textures[decode.texture].state = TextureState::Uploading;
+            stream.decoded.push_back(std::move(stream.decoding[i]));
+        }
+        stream.decoding.erase(stream.decoding.begin() + i);
+    }
+
+    /* start decodes outside of the lock, without workers the job runs right away */
+    std::vector<TextureDecode*> started;
+    {
+        std::lock_guard<std::mutex> lock(stream.mutex);
+        while(!stream.queued.empty() && int(stream.decoding.size()) < stream.settings.decodesInFlight)
+        {
+            auto decode = std::make_unique<TextureDecode>();
+            decode->texture = stream.queued.front();
+            decode->path = stream.textures[decode->texture].path;
+            decode->layerSize = stream.settings.layerSize;
+            stream.textures[decode->texture].state = TextureState::Decoding;
+            stream.queued.pop_front();
+            started.push_back(decode.get());
+            stream.decoding.push_back(std::move(decode));
+        }
+    }
+    for(TextureDecode* decode : started)
+        jobRun(decode->counter, detail::textureDecodeTask, decode);
+
+    /* upload within the per-frame budget, at least one texture so large ones don't starve */
+    size_t uploaded = 0;
+    auto start = std::chrono::steady_clock::now();
+    while(!stream.decoded.empty())
+    {
+        TextureDecode& decode = *stream.decoded.front();
+        size_t size = decode.levels.size();
+        if(uploaded > 0 && uploaded + size > stream.settings.uploadBytesPerFrame)
+            break;
+        if(stream.freeLayers.empty() && !detail::textureGrow(stream) && !detail::textureEvict(stream))
+        {
+            if(!stream.overBudget)
+                std::cerr << "[Textures] The textures in use need more than the " << stream.maxLayers - 1
+                          << " layers of the budget, waiting for a free layer" << std::endl;
+            stream.overBudget = true;
+            break;
+        }
+
+        int layer = stream.freeLayers.back();
+        stream.freeLayers.pop_back();
+        detail::textureUpload(stream, decode, layer);
+        uploaded += size;
+        {
+            std::lock_guard<std::mutex> lock(stream.mutex);
+            StreamedTexture& texture = stream.textures[decode.texture];
+            texture.layer = layer;
+            texture.width = decode.width;
+            texture.height = decode.height;
+            texture.state = TextureState::Resident;
+        }
+        stream.stats.uploads++;
+        stream.stats.uploadedBytes += size;
+        stream.stats.residentLayers++;
+        stream.stats.peakResidentLayers = std::max(stream.stats.peakResidentLayers, stream.stats.residentLayers);
+        stream.decoded.erase(stream.decoded.begin());
+    }
+    if(uploaded > 0)
+        stream.stats.uploadMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::lock_guard<std::mutex> lock(stream.mutex);
+    stream.frame++;
+}
+
+bool textureStreamPending(TextureStream& stream)
+{
+    std::lock_guard<std::mutex> lock(stream.mutex);
+    return !stream.queued.empty() || !stream.decoding.empty() || !stream.decoded.empty();
+}
+
+void textureStreamDelete(TextureStream& stream)
+{
+    for(auto& decode : stream.decoding)
+        jobWait(decode->counter);
+    stream.decoding.clear();
+    stream.decoded.clear();
+    stream.freeLayers.clear();
+
+    std::lock_guard<std::mutex> lock(stream.mutex);
+    stream.textures.clear();
+    stream.queued.clear();
+    if(stream.array != 0)
+    {
+        glStateForgetTexture(stream.array);
+        glDeleteTextures(1, &stream.array);
+        for(GLuint buffer : stream.staging)
+            glStateForgetBuffer(buffer);
+        glDeleteBuffers(TextureStream::kStagingBuffers, stream.staging);
+    }
+    stream.array = 0;
+}
+
+void textureStreamReport(const TextureStream& stream)
+{
+    const TextureStreamStats& stats = stream.stats;
+    if(stats.uploads == 0 && stats.failures == 0)
+        return;
+    size_t layerBytes = detail::textureLayerBytes(stream.settings.layerSize, stream.levels);
+    std::cout << "[Textures] " << stats.uploads << " uploads (" << stats.uploadedBytes / 1024 << " KiB), "
+              << stats.failures << " failed, " << stats.evictions << " evictions, " << stats.residentLayers
+              << " resident (peak " << stats.peakResidentLayers << ") of " << stream.layers - 1 << " layers of "
+              << stream.settings.layerSize << "x" << stream.settings.layerSize << " (" << layerBytes * stream.layers / 1024
+              << " KiB, grown " << stats.growths << " times, budget " << stream.maxLayers - 1 << " layers), decode "
+              << stats.decodeMs << " ms, upload " << stats.uploadMs << " ms" << std::endl;
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include "base.h"
+#include "core/jobs.h"
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum class TextureState { Unloaded, Queued, Decoding, Uploading, Resident, Failed };
+
+/* limits of a texture stream */
+struct TextureStreamSettings
+{
+    size_t budgetBytes = 64u << 20;             // GPU memory the texture array may grow to, including the mipmaps
+    size_t uploadBytesPerFrame = 4u << 20;      // bytes copied into staging buffers per frame, at least one texture
+    int decodesInFlight = 4;                    // images decoded on the job system at the same time
+    int layerSize = 512;                        // width and height of every layer, rounded up to a power of two
+};
+
+/* one image file, loaded on first use and evicted when it wasn't used for a while */
+struct StreamedTexture
+{
+    std::string path;
+    TextureState state = TextureState::Unloaded;
+    int layer = 0;              // layer of the texture array, 0 (the placeholder) unless resident
+    int width = 0;              // size of the file, the layer is resampled to the layer size
+    int height = 0;
+    uint64_t lastUsed = 0;      // frame of the last textureStreamUse
+};
+
+/* decoding job, the job only touches its own request */
+struct TextureDecode
+{
+    int texture = -1;
+    std::string path;
+    int layerSize = 0;
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> levels;  // RGBA mipmap chain of the layer, bottom row first, empty if decoding failed
+    double decodeMs = 0.0;
+    JobCounter counter;
+};
+
+/* per-stream counters since the creation */
+struct TextureStreamStats
+{
+    unsigned int uploads = 0;
+    unsigned int evictions = 0;
+    unsigned int failures = 0;
+    unsigned int growths = 0;   // reallocations of the array with more layers
+    size_t uploadedBytes = 0;
+    int residentLayers = 0;
+    int peakResidentLayers = 0;
+    double decodeMs = 0.0;      // summed over all decodes including the resampling and the mipmaps
+    double uploadMs = 0.0;      // time spent in the copy to the staging buffers and the texture calls
+};
+
+/**
+ * Textures streamed in the background and packed into the layers of one GL_TEXTURE_2D_ARRAY, so all textured draws
+ * share a single binding and only differ in the layer index (a uniform, or an instance attribute for instanced draws);
+ * textures don't break batches. Every image is resampled to the layer size. The array starts with a few layers and
+ * doubles them when it is full, up to as many layers as fit into the memory budget; the existing layers are copied
+ * across on the GPU and the name of the array stays the same.
+ *
+ * Using a texture that isn't resident returns layer 0, a white placeholder (so the object shows its tint color), and
+ * queues the file: it is decoded with stb_image on the job system, which also resamples it and computes the mipmaps,
+ * then copied into a pixel buffer object on the OpenGL thread within a per-frame byte budget and uploaded from there,
+ * so glTexSubImage3D doesn't copy from client memory. When no layer is free and the array is at the budget, the least
+ * recently used texture is evicted and streamed again on its next use.
+ *
+ * textureStreamUse may be called from the simulation thread while the OpenGL thread runs textureStreamUpdate (the
+ * table is guarded by a mutex); textures used in the current or the previous frame are never evicted, so a returned
+ * layer stays valid until the frame it was requested for has been drawn.
+ */
+struct TextureStream
+{
+    TextureStreamSettings settings;
+    GLuint array = 0;
+    int layers = 0;                             // allocated layers including the placeholder
+    int maxLayers = 0;                          // layers that fit into the budget
+    static const int kInitialLayers = 8;
+    int levels = 0;                             // mipmap levels per layer
+
+    static const int kStagingBuffers = 3;       // consecutive uploads use different buffers
+    GLuint staging[kStagingBuffers] = {};
+    int nextStaging = 0;
+
+    /* only used on the OpenGL thread */
+    std::vector<std::unique_ptr<TextureDecode>> decoding;
+    std::vector<std::unique_ptr<TextureDecode>> decoded;   // waiting for the upload budget or a free layer
+    std::vector<int> freeLayers;
+    bool overBudget = false;                    // warned that the textures in use don't fit the array
+    TextureStreamStats stats;
+
+    std::mutex mutex;                           // guards everything below
+    std::vector<StreamedTexture> textures;
+    std::deque<int> queued;                     // used but not decoding yet
+    uint64_t frame = 1;
+};
+
+/**
+ * @brief Allocates the texture array and the staging buffers. Requires a current OpenGL context.
+ *
+ * @param stream Stream to initialize.
+ * @param settings Memory and upload budgets, layer size.
+ *
+ * usage:
+ *
+ *   TextureStream textures;
+ *   textureStreamCreate(textures, settings);
+ *   int planks = textureStreamAdd(textures, "scenes/textures/planks.png");
+ *   ...
+ *   packet.texture = textures.array;
+ *   packet.layer = textureStreamUse(textures, planks);     // placeholder until the texture is resident
+ *   ...
+ *   textureStreamUpdate(textures);                         // once per frame on the OpenGL thread
+ *   ...
+ *   textureStreamDelete(textures);
+ *
+ */
+void textureStreamCreate(TextureStream& stream, const TextureStreamSettings& settings = TextureStreamSettings());
+
+/**
+ * @brief Registers an image file without loading it. Adding the same path twice returns the same handle.
+ *
+ * @return Handle of the texture.
+ */
+int textureStreamAdd(TextureStream& stream, const std::string& path);
+
+/**
+ * @brief Marks a texture as used in the current frame and queues it for streaming if it isn't resident.
+ *
+ * @param stream Texture stream.
+ * @param texture Handle returned by textureStreamAdd.
+ *
+ * @return Layer of the texture in the array if it is resident, 0 (the placeholder) otherwise.
+ */
+int textureStreamUse(TextureStream& stream, int texture);
+
+/**
+ * @brief Starts decodes, uploads decoded images within the per-frame budget and evicts textures when the array is
+ * full. Call once per frame on the OpenGL thread, it never waits for the decoding.
+ */
+void textureStreamUpdate(TextureStream& stream);
+
+/**
+ * @brief True while textures are queued, decoding or waiting for their upload, i.e. the next frames will change.
+ */
+bool textureStreamPending(TextureStream& stream);
+
+/**
+ * @brief Waits for the running decodes and deletes the array and the buffers.
+ */
+void textureStreamDelete(TextureStream& stream);
+
+/**
+ * @brief Prints the upload, eviction and memory counters, nothing if no texture was ever used.
+ */
+void textureStreamReport(const TextureStream& stream);
@@ -0,0 +1,65 @@
+#include "uniformbuffer.h"
+#include "glstate.h"
+
+#include <cassert>
+#include <cstring>
+
+int uniformBlockBinding(const std::string& name)
+{
+    if(name == "FrameData")
+    {
+        return eUniformBlockIdx::FrameData;
+    }
+    return -1;
+}
+
+UniformBuffer uniformBufferCreate(GLuint binding, unsigned int size, unsigned int slots)
+{
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+
+    UniformBuffer ubo;
+    ubo.binding = binding;
+    ubo.size = size;
+    ubo.stride = (size + alignment - 1) / alignment * alignment;
+    ubo.slots = slots > 0 ? slots : 1;
+
+    glGenBuffers(1, &ubo.id);
+    glStateBindBuffer(GL_UNIFORM_BUFFER, ubo.id);
+    glBufferData(GL_UNIFORM_BUFFER, ubo.stride * ubo.slots, nullptr, GL_STREAM_DRAW);
+    glStateBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glCheckError();
+
+    return ubo;
+}
+
+void uniformBufferUpdate(UniformBuffer& ubo, const void* data, unsigned int size)
+{
+    assert(size <= ubo.size);
+
+    GLintptr offset = ubo.head * ubo.stride;
+    GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+    /* first slot of a new round: orphan the storage instead of waiting for pending reads of the old one */
+    access |= (ubo.head == 0) ? GL_MAP_INVALIDATE_BUFFER_BIT : GL_MAP_INVALIDATE_RANGE_BIT;
+
+    glStateBindBuffer(GL_UNIFORM_BUFFER, ubo.id);
+    void* dst = glMapBufferRange(GL_UNIFORM_BUFFER, offset, ubo.stride, access);
+    if(dst)
+    {
+        std::memcpy(dst, data, size);
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+    }
+    else
+    {
+        glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+    }
+    glBindBufferRange(GL_UNIFORM_BUFFER, ubo.binding, ubo.id, offset, ubo.size);
+
+    ubo.head = (ubo.head + 1) % ubo.slots;
+}
+
+void uniformBufferDelete(const UniformBuffer& ubo)
+{
+    glStateForgetBuffer(ubo.id);
+    glDeleteBuffers(1, &ubo.id);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "base.h"
+
+/* fixed binding points of the uniform blocks shared by all shader programs */
+enum eUniformBlockIdx { FrameData = 0 };
+
+/* per-frame constants, layout matches the std140 block "FrameData" in the shaders */
+struct FrameUniforms
+{
+    Matrix4D view;
+    Matrix4D proj;
+    Matrix4D viewProj;
+    Vector4D cameraPos;     // xyz: camera position in world space
+    Vector4D time;          // x: seconds since start, y: frame delta
+};
+static_assert(sizeof(FrameUniforms) == 3 * 64 + 2 * 16, "FrameUniforms has to match the std140 layout of FrameData");
+
+struct UniformBuffer
+{
+    GLuint id = 0;
+    GLuint binding = 0;
+
+    unsigned int size = 0;          // size of one block in bytes
+    unsigned int stride = 0;        // size of one ring slot, aligned to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+    unsigned int slots = 0;         // number of ring slots
+    unsigned int head = 0;          // next slot to write
+};
+
+/**
+ * @brief Returns the fixed binding point of a uniform block used by the shaders.
+ *
+ * @param name Name of the uniform block.
+ *
+ * @return Binding point (see eUniformBlockIdx) or -1 if the block is unknown.
+ */
+int uniformBlockBinding(const std::string& name);
+
+/**
+ * @brief Creates a uniform buffer holding a ring of blocks. Each update writes the next slot unsynchronized, the whole
+ * buffer is orphaned when the ring wraps around, so the CPU never waits for the GPU still reading an older slot.
+ *
+ * @param binding Binding point the buffer is bound to (see eUniformBlockIdx).
+ * @param size Size of one block in bytes.
+ * @param slots Number of blocks in the ring (roughly the number of frames in flight).
+ *
+ * @return Initialized uniform buffer.
+ *
+ * usage:
+ *
+ *   UniformBuffer frameBuffer = uniformBufferCreate(eUniformBlockIdx::FrameData, sizeof(FrameUniforms));
+ *   uniformBufferUpdate(frameBuffer, &frameUniforms, sizeof(FrameUniforms));   // once per frame
+ *
+ */
+UniformBuffer uniformBufferCreate(GLuint binding, unsigned int size, unsigned int slots = 3);
+
+/**
+ * @brief Writes a block into the next ring slot and binds that slot to the binding point of the buffer.
+ *
+ * @param ubo Uniform buffer.
+ * @param data Block data (std140 layout).
+ * @param size Size of the data in bytes, at most the block size of the buffer.
+ */
+void uniformBufferUpdate(UniformBuffer& ubo, const void* data, unsigned int size);
+
+/**
+ * @brief Cleanup and delete the OpenGL buffer of a uniform buffer. Has to be called for each uniform buffer after it is
+ * not used anymore.
+ *
+ * @param ubo Uniform buffer to delete.
+ */
+void uniformBufferDelete(const UniformBuffer& ubo);
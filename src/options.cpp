@@ -0,0 +1,272 @@
+#include "options.h"
+
+#include <cstdio>
+#include <iostream>
+
+namespace detail
+{
+void printUsage(const char* program)
+{
+    std::cout << "usage: " << program << " [options]\n"
+              << "  --headless          render offscreen (EGL or invisible window), no window is shown\n"
+              << "  --size WxH          framebuffer size in pixels (default 1280x720)\n"
+              << "  --frames N          exit after N frames (default: run until closed, 1 when headless,\n"
+              << "                      600 measured frames after the warmup for --benchmark)\n"
+              << "  --output FILE       write the last frame to FILE as PNG\n"
+              << "  --profile FILE      record CPU/GPU zones and write them to FILE as Chrome trace JSON\n"
+              << "  --jobs N            worker threads of the job system (default: hardware threads - 1)\n"
+              << "  --bench-jobs        run the job system micro-benchmarks (up to --jobs workers) and exit\n"
+              << "  --bench-bvh         benchmark build, refit and queries of the BVH with 10k to 1M boxes and exit\n"
+              << "  --bench-pick        measure the time of picking boats under random cursor positions and exit\n"
+              << "  --pipelined         simulate the next frame on a second thread while the current one is drawn\n"
+              << "  --still-water       don't animate the water surface\n"
+              << "  --scene FILE        scene in text or compiled form (default scenes/default.scene)\n"
+              << "  --compile-scene OUT write the scene in compiled (binary) form to OUT and exit\n"
+              << "  --grid-res N        water grid with N x N cells (default: as in the scene)\n"
+              << "  --boats N           number of boats of the grids of a text scene (default: as in the scene)\n"
+              << "  --fleet N           add N instanced boats, culled and updated in parallel (at most 100000)\n"
+              << "  --texture-budget MB GPU memory the streamed textures may grow to before evicting (default 64)\n"
+              << "  --upload-budget KB  texture data uploaded per frame (default 4096)\n"
+              << "  --texture-size N    width and height of the texture array layers, images are resampled (default 512)\n"
+              << "  --bench-fleet       measure the per frame cost of fleets up to --fleet boats (default 100000)\n"
+              << "  --benchmark         run a scripted path with a fixed time step and vsync off, report frame times\n"
+              << "  --path FILE         benchmark keyframes (default: built-in path)\n"
+              << "  --warmup N          benchmark frames before measuring (default 60)\n"
+              << "  --report FILE       write the benchmark report JSON to FILE (default: stdout)\n"
+              << "  --record FILE       write every frame as raw video to FILE, - streams to stdout\n"
+              << "  --record-format F   rgba or yuv420 (planar I420) (default rgba)\n"
+              << "  --record-mmap       write the recording through a memory mapping of the file\n"
+              << "  --record-buffers N  frames read back in flight before frames are dropped (at least 1, default 4)\n"
+              << "  --present MODE      vsync, adaptive (late frames tear) or uncapped (default vsync,\n"
+              << "                      uncapped for --benchmark)\n"
+              << "  --fps N             limit the frame rate to N with a sleep+spin limiter (default: off)\n"
+              << "  --pacing            print a histogram of the frame intervals on exit\n"
+              << "  --on-demand         only redraw when the scene changed, idle without CPU/GPU use otherwise\n"
+              << "  --water-rate N      animate the water N times per second in on-demand mode (default: frozen)\n"
+              << "  --dynres            scale the render resolution to keep the GPU time within a budget\n"
+              << "  --dynres-target MS  GPU time budget per frame (default 16)\n"
+              << "  --dynres-min S      lower bound of the scale per axis (default 0.5)\n"
+              << "  --dynres-max S      upper bound of the scale per axis (default 1.0)\n"
+              << "  --dynres-hysteresis F  relative GPU time deviation before the scale changes (default 0.1)\n"
+              << "  --dynres-interval N frames averaged per adjustment (default 8)\n"
+              << "  --help              show this message" << std::endl;
+}
+
+bool parseInt(const std::string& text, int& value)
+{
+    char tail;
+    return std::sscanf(text.c_str(), "%d%c", &value, &tail) == 1;
+}
+
+bool parseDouble(const std::string& text, double& value)
+{
+    char tail;
+    return std::sscanf(text.c_str(), "%lf%c", &value, &tail) == 1;
+}
+
+bool parseSize(const std::string& text, int& width, int& height)
+{
+    char tail;
+    return std::sscanf(text.c_str(), "%dx%d%c", &width, &height, &tail) == 2 && width > 0 && height > 0;
+}
+}
+
+bool optionsParse(int argc, char** argv, Options& options)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if(arg == "--help" || arg == "-h")
+        {
+            detail::printUsage(argv[0]);
+            return false;
+        }
+        else if(arg == "--headless")
+        {
+            options.headless = true;
+        }
+        else if(arg == "--size" && hasValue)
+        {
+            if(!detail::parseSize(argv[++i], options.width, options.height))
+            {
+                std::cerr << "[Options] Invalid size '" << argv[i] << "', expected WxH" << std::endl;
+                return false;
+            }
+        }
+        else if(arg == "--frames" && hasValue)
+        {
+            if(!detail::parseInt(argv[++i], options.frames) || options.frames < 0)
+            {
+                std::cerr << "[Options] Invalid frame count '" << argv[i] << "'" << std::endl;
+                return false;
+            }
+        }
+        else if(arg == "--output" && hasValue)
+        {
+            options.output = argv[++i];
+        }
+        else if(arg == "--scene" && hasValue)
+        {
+            options.scene = argv[++i];
+        }
+        else if(arg == "--compile-scene" && hasValue)
+        {
+            options.compileScene = argv[++i];
+        }
+        else if((arg == "--grid-res" || arg == "--boats" || arg == "--warmup" || arg == "--record-buffers"
+                 || arg == "--fleet" || arg == "--fps" || arg == "--water-rate" || arg == "--dynres-interval"
+                 || arg == "--texture-budget" || arg == "--upload-budget" || arg == "--texture-size") && hasValue)
+        {
+            int& value = arg == "--grid-res" ? options.gridResolution : arg == "--boats" ? options.boats
+                       : arg == "--warmup" ? options.warmup : arg == "--fps" ? options.fps
+                       : arg == "--fleet" ? options.fleet : arg == "--water-rate" ? options.waterRate
+                       : arg == "--dynres-interval" ? options.dynresInterval
+                       : arg == "--texture-budget" ? options.textureBudget
+                       : arg == "--texture-size" ? options.textureSize
+                       : arg == "--upload-budget" ? options.uploadBudget : options.recordBuffers;
+            /* a ring needs at least one buffer, everything else may be 0 */
+            int minimum = arg == "--record-buffers" ? 1 : 0;
+            if(!detail::parseInt(argv[++i], value) || value < minimum)
+            {
+                std::cerr << "[Options] Invalid value '" << argv[i] << "' for " << arg << " (at least " << minimum << ")"
+                          << std::endl;
+                return false;
+            }
+        }
+        else if(arg == "--jobs" && hasValue)
+        {
+            if(!detail::parseInt(argv[++i], options.jobs) || options.jobs < 0)
+            {
+                std::cerr << "[Options] Invalid worker count '" << argv[i] << "'" << std::endl;
+                return false;
+            }
+        }
+        else if(arg == "--bench-jobs")
+        {
+            options.benchJobs = true;
+        }
+        else if(arg == "--bench-bvh")
+        {
+            options.benchBvh = true;
+        }
+        else if(arg == "--bench-pick")
+        {
+            options.benchPick = true;
+        }
+        else if(arg == "--bench-fleet")
+        {
+            options.benchFleet = true;
+        }
+        else if(arg == "--pipelined")
+        {
+            options.pipelined = true;
+        }
+        else if(arg == "--still-water")
+        {
+            options.stillWater = true;
+        }
+        else if(arg == "--benchmark")
+        {
+            options.benchmark = true;
+        }
+        else if(arg == "--path" && hasValue)
+        {
+            options.benchmarkPath = argv[++i];
+        }
+        else if(arg == "--report" && hasValue)
+        {
+            options.report = argv[++i];
+        }
+        else if(arg == "--profile" && hasValue)
+        {
+            options.profile = argv[++i];
+        }
+        else if(arg == "--record" && hasValue)
+        {
+            options.record = argv[++i];
+        }
+        else if(arg == "--record-format" && hasValue)
+        {
+            options.recordFormat = argv[++i];
+            if(options.recordFormat != "rgba" && options.recordFormat != "yuv420")
+            {
+                std::cerr << "[Options] Invalid record format '" << argv[i] << "', expected rgba or yuv420" << std::endl;
+                return false;
+            }
+        }
+        else if(arg == "--record-mmap")
+        {
+            options.recordMmap = true;
+        }
+        else if(arg == "--present" && hasValue)
+        {
+            options.present = argv[++i];
+            if(options.present != "vsync" && options.present != "adaptive" && options.present != "uncapped")
+            {
+                std::cerr << "[Options] Invalid present mode '" << argv[i] << "', expected vsync, adaptive or uncapped"
+                          << std::endl;
+                return false;
+            }
+        }
+        else if(arg == "--pacing")
+        {
+            options.pacing = true;
+        }
+        else if(arg == "--on-demand")
+        {
+            options.onDemand = true;
+        }
+        else if(arg == "--dynres")
+        {
+            options.dynamicResolution = true;
+        }
+        else if((arg == "--dynres-target" || arg == "--dynres-min" || arg == "--dynres-max"
+                 || arg == "--dynres-hysteresis") && hasValue)
+        {
+            double& value = arg == "--dynres-target" ? options.dynresTargetMs : arg == "--dynres-min" ? options.dynresMin
+                          : arg == "--dynres-max" ? options.dynresMax : options.dynresHysteresis;
+            if(!detail::parseDouble(argv[++i], value) || value < 0.0)
+            {
+                std::cerr << "[Options] Invalid value '" << argv[i] << "' for " << arg << std::endl;
+                return false;
+            }
+            options.dynamicResolution = true;
+        }
+        else
+        {
+            std::cerr << "[Options] Unknown or incomplete argument '" << arg << "'" << std::endl;
+            detail::printUsage(argv[0]);
+            return false;
+        }
+    }
+
+    /* headless runs and benchmarks have to terminate on their own */
+    if(options.benchmark && options.frames == 0)
+        options.frames = 600;
+    if(options.headless && options.frames == 0)
+        options.frames = 1;
+
+    if(options.fleet > 100000)
+    {
+        std::cerr << "[Options] --fleet is limited to 100000 boats" << std::endl;
+        options.fleet = 100000;
+    }
+    if(options.benchFleet && options.fleet == 0)
+        options.fleet = 100000;
+
+    /* on-demand redraws are driven by window events; a frame simulated ahead would show input one redraw late */
+    if(options.onDemand && (options.headless || options.benchmark))
+    {
+        std::cerr << "[Options] --on-demand needs an interactive window, ignored" << std::endl;
+        options.onDemand = false;
+    }
+    if(options.onDemand && options.pipelined)
+    {
+        std::cerr << "[Options] --on-demand draws the frame of the latest input, --pipelined ignored" << std::endl;
+        options.pipelined = false;
+    }
+
+    return true;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <string>
+
+/* command line options of assignment_01 */
+struct Options
+{
+    bool headless = false;      // render offscreen into a framebuffer, no window is opened
+    int width = 1280;
+    int height = 720;
+    int frames = 0;             // number of frames to render before exiting (after the warmup when benchmarking), 0 runs until the window is closed
+    std::string output;         // PNG written after the last frame, empty for none
+    std::string profile;        // Chrome trace written on exit, empty disables the profiler
+
+    /* worker threads of the job system, -1 uses one per additional hardware thread */
+    int jobs = -1;
+    /* run the job system micro-benchmarks and exit */
+    bool benchJobs = false;
+    /* run the bounding volume hierarchy benchmarks and exit */
+    bool benchBvh = false;
+
+    /* simulate the next frame on a second thread while the current one is drawn */
+    bool pipelined = false;
+    /* don't animate the water surface */
+    bool stillWater = false;
+
+    /* scene file in text or compiled form */
+    std::string scene = "scenes/default.scene";
+    std::string compileScene;   // write the loaded scene in compiled form to this file and exit, empty to run
+
+    /* scene size, overrides the scene file */
+    int gridResolution = 0;     // cells per side of the water grid, 0 uses the scene's grid
+    int boats = 0;              // boats of every grid of the scene, 0 keeps the count of the scene
+    int fleet = 0;              // boats of the instanced fleet (at most 100000), 0 disables it
+
+    /* texture streaming */
+    int textureBudget = 64;     // MiB of resident textures before the least recently used ones are evicted
+    int uploadBudget = 4096;    // KiB of texture data uploaded per frame
+    int textureSize = 512;      // width and height of the texture array layers, rounded up to a power of two
+
+    /* measure the per frame cost of the fleet for growing sizes up to --fleet (default 100000) and exit */
+    bool benchFleet = false;
+    /* measure the time of picking the boat under random points of the window and exit */
+    bool benchPick = false;
+
+    /* benchmark mode: scripted path, fixed time step, vsync off, JSON report */
+    bool benchmark = false;
+    std::string benchmarkPath;  // keyframe file, empty uses the built-in path
+    int warmup = 60;            // frames rendered before measuring starts
+    std::string report;         // JSON report file, empty prints it to stdout
+
+    /* raw video recording of every frame */
+    std::string record;         // output file, "-" streams to stdout, empty disables recording
+    std::string recordFormat = "rgba";  // rgba or yuv420
+    bool recordMmap = false;    // write through a memory mapping of the file
+    int recordBuffers = 4;      // readbacks in flight before frames are dropped
+
+    /* frame pacing */
+    std::string present;        // vsync, adaptive or uncapped, empty uses vsync (uncapped when benchmarking)
+    int fps = 0;                // frame limiter target, 0 disables the limiter
+    bool pacing = false;        // print the frame interval histogram on exit
+
+    /* only redraw when input, an animation or a timer changed the scene, sleeps in between */
+    bool onDemand = false;
+    int waterRate = 0;          // water updates per second in on-demand mode, 0 freezes the water
+
+    /* dynamic resolution: render at a scale that keeps the GPU time within the budget and upscale */
+    bool dynamicResolution = false;
+    double dynresTargetMs = 16.0;
+    double dynresMin = 0.5;
+    double dynresMax = 1.0;
+    double dynresHysteresis = 0.1;
+    int dynresInterval = 8;     // frames averaged per adjustment
+};
+
+/**
+ * @brief Parse the command line. Prints the usage on --help or on invalid arguments.
+ *
+ * @param argc Argument count as passed to main.
+ * @param argv Arguments as passed to main.
+ * @param options Parsed options, untouched values keep their defaults.
+ *
+ * @return False if the program should exit (help requested or invalid arguments).
+ *
+ * usage:
+ *
+ *   assignment_01 --headless --size 1920x1080 --frames 120 --output frame.png --profile trace.json
+ *
+ */
+bool optionsParse(int argc, char** argv, Options& options);
@@ -0,0 +1,116 @@
+#include "pipeline.h"
+#include "mygl/profiler.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace detail
+{
+double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void simulationLoop(FramePipeline& pipeline)
+{
+    profilerSetThreadName("simulation");
+    int back = 1;
+    while(true)
+    {
+        auto start = std::chrono::steady_clock::now();
+        {
+            PROFILE_CPU("produce");
+            pipeline.produce(pipeline.snapshots[back]);
+        }
+        pipeline.produceMs += millisecondsSince(start);
+
+        /* publish once the renderer released the older snapshot, it becomes the back buffer */
+        auto waitStart = std::chrono::steady_clock::now();
+        std::unique_lock<std::mutex> lock(pipeline.mutex);
+        pipeline.changed.wait(lock, [&] { return !pipeline.full || pipeline.quit; });
+        pipeline.produceWaitMs += millisecondsSince(waitStart);
+        if(pipeline.quit)
+            return;
+
+        pipeline.front = back;
+        pipeline.full = true;
+        back = 1 - back;
+        lock.unlock();
+        pipeline.changed.notify_all();
+    }
+}
+}
+
+void pipelineStart(FramePipeline& pipeline, std::function<void(RenderSnapshot&)> produce, bool threaded)
+{
+    pipeline.produce = std::move(produce);
+    pipeline.threaded = threaded;
+    pipeline.front = 0;
+    pipeline.full = false;
+    pipeline.quit = false;
+
+    if(threaded)
+        pipeline.thread = std::thread(detail::simulationLoop, std::ref(pipeline));
+}
+
+RenderSnapshot& pipelineAcquire(FramePipeline& pipeline)
+{
+    auto start = std::chrono::steady_clock::now();
+    if(!pipeline.threaded)
+    {
+        pipeline.produce(pipeline.snapshots[0]);
+        pipeline.produceMs += detail::millisecondsSince(start);
+        pipeline._acquired = std::chrono::steady_clock::now();
+        return pipeline.snapshots[0];
+    }
+
+    PROFILE_CPU("acquire");
+    std::unique_lock<std::mutex> lock(pipeline.mutex);
+    pipeline.changed.wait(lock, [&] { return pipeline.full; });
+    pipeline.consumeWaitMs += detail::millisecondsSince(start);
+    pipeline._acquired = std::chrono::steady_clock::now();
+    return pipeline.snapshots[pipeline.front];
+}
+
+void pipelineRelease(FramePipeline& pipeline)
+{
+    pipeline.consumeMs += detail::millisecondsSince(pipeline._acquired);
+    pipeline.frames++;
+    if(!pipeline.threaded)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(pipeline.mutex);
+        pipeline.full = false;
+    }
+    pipeline.changed.notify_all();
+}
+
+void pipelineStop(FramePipeline& pipeline)
+{
+    if(!pipeline.thread.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(pipeline.mutex);
+        pipeline.quit = true;
+    }
+    pipeline.changed.notify_all();
+    pipeline.thread.join();
+}
+
+void pipelineReport(const FramePipeline& pipeline, double wallMs)
+{
+    double frames = std::max<uint64_t>(pipeline.frames, 1);
+    double simulation = pipeline.produceMs / frames;
+    double render = pipeline.consumeMs / frames;
+    double wall = wallMs / frames;
+
+    /* simulation time the renderer didn't wait for ran in parallel to rendering, sequentially all of it is waited for */
+    double hidden = pipeline.threaded ? std::max(0.0, simulation - pipeline.consumeWaitMs / frames) : 0.0;
+    std::cout << "[Pipeline] " << (pipeline.threaded ? "threaded" : "sequential") << ", " << pipeline.frames
+              << " frames: simulation " << simulation << " ms, render " << render << " ms, frame " << wall
+              << " ms, waits sim/render " << pipeline.produceWaitMs / frames << "/" << pipeline.consumeWaitMs / frames
+              << " ms, overlap " << hidden << " ms (" << 100.0 * hidden / std::max(simulation, 1e-9)
+              << "% of the simulation hidden)" << std::endl;
+}
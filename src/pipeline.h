@@ -0,0 +1,113 @@
+#pragma once
+
+#include "mygl/base.h"
+#include "mygl/mesh.h"
+#include "mygl/renderqueue.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* everything the GL thread needs to draw one frame, written by the simulation and read-only for the renderer */
+struct RenderSnapshot
+{
+    uint64_t frame = 0;
+
+    /* camera */
+    Matrix4D view;
+    Matrix4D projection;
+    Matrix4D viewProjection;
+    Vector4D cameraPos;
+
+    float elapsedTime = 0.0f;
+    float frameDelta = 0.0f;
+
+    /* draw packets with world matrices, sorted and submitted by the renderer */
+    RenderQueue queue;
+
+    /* root matrices and livery layers of the visible boats of the fleet, uploaded by the renderer before the submit */
+    std::vector<Matrix4D> fleetInstances;
+    std::vector<float> fleetLayers;
+    GLsizei fleetVisible = 0;
+
+    /* water vertices, only valid if they changed since the last snapshot */
+    std::vector<Vertex> waterVertices;
+    bool waterChanged = false;
+};
+
+/**
+ * Two stage frame pipeline. The simulation fills a snapshot while the renderer draws the previous one, snapshots are
+ * double-buffered and handed over as a whole. The simulation waits until the renderer is done with the older
+ * snapshot before it publishes the next one, so it runs at most one frame ahead (one frame of latency).
+ * Without a thread the snapshot is produced in pipelineAcquire, which gives the sequential update/draw loop.
+ */
+struct FramePipeline
+{
+    RenderSnapshot snapshots[2];
+    std::function<void(RenderSnapshot&)> produce;
+
+    bool threaded = false;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable changed;
+    int front = 0;              // snapshot handed to the renderer
+    bool full = false;          // front holds a snapshot that is not released yet
+    bool quit = false;
+
+    /* statistics in milliseconds, produce/wait of the producer are written by the simulation thread */
+    uint64_t frames = 0;
+    double produceMs = 0.0;
+    double produceWaitMs = 0.0;
+    double consumeMs = 0.0;
+    double consumeWaitMs = 0.0;
+    std::chrono::steady_clock::time_point _acquired;
+};
+
+/**
+ * @brief Start the pipeline.
+ *
+ * @param pipeline Pipeline to start.
+ * @param produce Fills a snapshot for the next frame (simulation step), called on the simulation thread if threaded.
+ * @param threaded Run produce on a separate thread, overlapping the simulation of frame N+1 with drawing frame N.
+ *
+ * usage:
+ *
+ *   pipelineStart(pipeline, [](RenderSnapshot& snapshot) { sceneUpdate(dt); sceneSnapshot(snapshot); }, true);
+ *   while(running)
+ *   {
+ *       RenderSnapshot& snapshot = pipelineAcquire(pipeline);
+ *       sceneDraw(snapshot);
+ *       pipelineRelease(pipeline);
+ *   }
+ *   pipelineStop(pipeline);
+ *
+ */
+void pipelineStart(FramePipeline& pipeline, std::function<void(RenderSnapshot&)> produce, bool threaded);
+
+/**
+ * @brief Get the next snapshot, waits for the simulation if it isn't ready yet. The snapshot stays valid until
+ * pipelineRelease.
+ */
+RenderSnapshot& pipelineAcquire(FramePipeline& pipeline);
+
+/**
+ * @brief Hand the acquired snapshot back to the simulation.
+ */
+void pipelineRelease(FramePipeline& pipeline);
+
+/**
+ * @brief Stop and join the simulation thread. The snapshot in flight is discarded.
+ */
+void pipelineStop(FramePipeline& pipeline);
+
+/**
+ * @brief Print the average simulation and render time per frame, the time both stages waited for each other and how
+ * much of the simulation ran in parallel to rendering (simulation time the renderer did not wait for).
+ *
+ * @param pipeline Pipeline to report.
+ * @param wallMs Wall time of all frames.
+ */
+void pipelineReport(const FramePipeline& pipeline, double wallMs);
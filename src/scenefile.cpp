@@ -0,0 +1,690 @@
+#include "scenefile.h"
+#include "mygl/geometry.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace detail
+{
+const char kSceneMagic[8] = {'V', 'C', 'S', 'C', 'E', 'N', 'E', '\0'};
+const uint32_t kSceneVersion = 2;
+const uint32_t kSceneByteOrder = 0x01020304u;
+
+/* arrays of the binary form, in file order */
+enum SceneSection
+{
+    Meshes, Textures, Prefabs, Parts, NodeParent, NodeTranslation, NodeRotation, NodeScale, EntityNode, EntityMesh,
+    EntityColor, EntityBounds, EntityTexture, SectionCount
+};
+
+struct SceneFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;             // detects files written on a machine with the other byte order
+    SceneCamera camera;
+    SceneWater water;
+    int32_t controlledNode;
+    uint32_t meshCount;
+    uint32_t textureCount;
+    uint32_t prefabCount;
+    uint32_t partCount;
+    uint32_t nodeCount;
+    uint32_t entityCount;
+    uint64_t offset[SectionCount];  // byte offset of every array, 16 byte aligned
+};
+
+/* mesh names and texture files are stored with a fixed size */
+struct SceneMeshName
+{
+    char name[32];
+};
+
+struct SceneTexturePath
+{
+    char path[256];
+};
+
+static_assert(std::is_trivially_copyable<SceneFileHeader>::value && std::is_trivially_copyable<ScenePart>::value
+              && std::is_trivially_copyable<Matrix3D>::value && std::is_trivially_copyable<Bounds>::value,
+              "the binary scene stores these types as they are in memory");
+
+[[noreturn]] void sceneFail(const std::string& message)
+{
+    std::cerr << "[Scene] " << message << std::endl;
+    std::cerr.flush();
+    throw std::runtime_error("[Scene] " + message);
+}
+
+/* read-only view of a whole file: memory mapped where possible, read into memory otherwise */
+struct SceneFileView
+{
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+    std::vector<unsigned char> buffer;
+#ifndef _WIN32
+    void* mapping = nullptr;
+#endif
+};
+
+bool sceneOpenView(const std::string& filepath, SceneFileView& view)
+{
+#ifndef _WIN32
+    int fd = open(filepath.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+    struct stat info;
+    if(fstat(fd, &info) != 0)
+    {
+        close(fd);
+        return false;
+    }
+    view.size = size_t(info.st_size);
+    if(view.size > 0)
+    {
+        view.mapping = mmap(nullptr, view.size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(view.mapping == MAP_FAILED)
+        {
+            view.mapping = nullptr;
+            close(fd);
+            return false;
+        }
+        view.data = static_cast<const unsigned char*>(view.mapping);
+    }
+    close(fd);
+    return true;
+#else
+    std::ifstream file(filepath, std::ios::binary);
+    if(!file)
+        return false;
+    view.buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    view.data = view.buffer.data();
+    view.size = view.buffer.size();
+    return true;
+#endif
+}
+
+void sceneCloseView(SceneFileView& view)
+{
+#ifndef _WIN32
+    if(view.mapping != nullptr)
+        munmap(view.mapping, view.size);
+    view.mapping = nullptr;
+#endif
+    view.data = nullptr;
+    view.size = 0;
+}
+
+/* copies a section into a vector after checking it lies inside of the file */
+template <typename T, typename Stored = T>
+void sceneCopySection(const SceneFileView& view, const SceneFileHeader& header, SceneSection section, uint32_t count,
+                      std::vector<T>& out, const std::string& filepath)
+{
+    static_assert(sizeof(T) == sizeof(Stored), "sections are copied as they are");
+    uint64_t offset = header.offset[section];
+    if(offset % 16 != 0 || offset > view.size || uint64_t(count) * sizeof(T) > view.size - offset)
+        sceneFail("Truncated or corrupt scene " + filepath);
+    out.resize(count);
+    if(count > 0)
+        std::memcpy(static_cast<void*>(out.data()), view.data + offset, count * sizeof(T));
+}
+
+SceneDescription sceneLoadBinary(const SceneFileView& view, const std::string& filepath)
+{
+    SceneFileHeader header;
+    std::memcpy(&header, view.data, sizeof(header));
+    if(header.version != kSceneVersion || header.byteOrder != kSceneByteOrder)
+        sceneFail("Scene " + filepath + " was compiled with another version or byte order, compile it again");
+
+    SceneDescription scene;
+    scene.camera = header.camera;
+    scene.water = header.water;
+    scene.controlledNode = header.controlledNode;
+
+    std::vector<SceneMeshName> names;
+    sceneCopySection(view, header, Meshes, header.meshCount, names, filepath);
+    for(const SceneMeshName& name : names)
+        scene.meshes.push_back(std::string(name.name, strnlen(name.name, sizeof(name.name))));
+    std::vector<SceneTexturePath> paths;
+    sceneCopySection(view, header, Textures, header.textureCount, paths, filepath);
+    for(const SceneTexturePath& path : paths)
+        scene.textures.push_back(std::string(path.path, strnlen(path.path, sizeof(path.path))));
+    sceneCopySection(view, header, Prefabs, header.prefabCount, scene.prefabs, filepath);
+    sceneCopySection(view, header, Parts, header.partCount, scene.parts, filepath);
+    sceneCopySection(view, header, NodeParent, header.nodeCount, scene.nodeParent, filepath);
+    sceneCopySection(view, header, NodeTranslation, header.nodeCount, scene.nodeTranslation, filepath);
+    sceneCopySection(view, header, NodeRotation, header.nodeCount, scene.nodeRotation, filepath);
+    sceneCopySection(view, header, NodeScale, header.nodeCount, scene.nodeScale, filepath);
+    sceneCopySection(view, header, EntityNode, header.entityCount, scene.entityNode, filepath);
+    sceneCopySection(view, header, EntityMesh, header.entityCount, scene.entityMesh, filepath);
+    sceneCopySection(view, header, EntityColor, header.entityCount, scene.entityColor, filepath);
+    sceneCopySection(view, header, EntityBounds, header.entityCount, scene.entityBounds, filepath);
+    sceneCopySection(view, header, EntityTexture, header.entityCount, scene.entityTexture, filepath);
+
+    /* the indices are used without further checks later on */
+    bool valid = header.controlledNode < int32_t(header.nodeCount);
+    for(uint32_t i = 0; i < header.nodeCount; i++)
+        valid &= scene.nodeParent[i] < int32_t(i);
+    for(uint32_t i = 0; i < header.entityCount; i++)
+        valid &= scene.entityNode[i] >= 0 && uint32_t(scene.entityNode[i]) < header.nodeCount && scene.entityMesh[i] >= 0
+                 && uint32_t(scene.entityMesh[i]) < header.meshCount && scene.entityTexture[i] >= -1
+                 && scene.entityTexture[i] < int32_t(header.textureCount);
+    for(const ScenePart& part : scene.parts)
+        valid &= part.mesh >= 0 && uint32_t(part.mesh) < header.meshCount && part.texture >= -1
+                 && part.texture < int32_t(header.textureCount);
+    for(const ScenePrefab& prefab : scene.prefabs)
+        valid &= uint64_t(prefab.firstPart) + prefab.partCount <= header.partCount;
+    if(!valid)
+        sceneFail("Invalid references in scene " + filepath);
+    return scene;
+}
+
+/* parser state of the text form */
+struct SceneParser
+{
+    SceneDescription scene;
+    std::map<std::string, int> nodes;
+    std::map<std::string, int> textures;
+    std::vector<Bounds> meshBounds;
+    int gridCount = 0;
+    std::string filepath;
+    int line = 0;
+};
+
+[[noreturn]] void sceneSyntaxError(const SceneParser& parser, const std::string& message)
+{
+    sceneFail(parser.filepath + ":" + std::to_string(parser.line) + ": " + message);
+}
+
+void sceneReadFloats(SceneParser& parser, std::istringstream& stream, float* values, int count, const std::string& key)
+{
+    for(int i = 0; i < count; i++)
+    {
+        if(!(stream >> values[i]))
+            sceneSyntaxError(parser, "'" + key + "' expects " + std::to_string(count) + " numbers");
+    }
+}
+
+Vector3D sceneReadVector3(SceneParser& parser, std::istringstream& stream, const std::string& key)
+{
+    float v[3];
+    sceneReadFloats(parser, stream, v, 3, key);
+    return {v[0], v[1], v[2]};
+}
+
+Vector4D sceneReadVector4(SceneParser& parser, std::istringstream& stream, const std::string& key)
+{
+    float v[4];
+    sceneReadFloats(parser, stream, v, 4, key);
+    return {v[0], v[1], v[2], v[3]};
+}
+
+/* degrees about x, then y, then z */
+Matrix3D sceneReadRotation(SceneParser& parser, std::istringstream& stream, const std::string& key)
+{
+    Vector3D angles = sceneReadVector3(parser, stream, key);
+    return Matrix3D::rotationZ(float(to_radians(angles.z))) * Matrix3D::rotationY(float(to_radians(angles.y)))
+           * Matrix3D::rotationX(float(to_radians(angles.x)));
+}
+
+int sceneFindMesh(SceneParser& parser, const std::string& name)
+{
+    auto it = std::find(parser.scene.meshes.begin(), parser.scene.meshes.end(), name);
+    if(it == parser.scene.meshes.end())
+        sceneSyntaxError(parser, "Unknown mesh '" + name + "', declare it with 'mesh " + name + "'");
+    return int(it - parser.scene.meshes.begin());
+}
+
+int sceneFindTexture(SceneParser& parser, const std::string& name)
+{
+    auto it = parser.textures.find(name);
+    if(it == parser.textures.end())
+        sceneSyntaxError(parser, "Unknown texture '" + name + "', declare it with 'texture " + name + " FILE'");
+    return it->second;
+}
+
+int sceneFindNode(SceneParser& parser, const std::string& name)
+{
+    auto it = parser.nodes.find(name);
+    if(it == parser.nodes.end())
+        sceneSyntaxError(parser, "Unknown node '" + name + "'");
+    return it->second;
+}
+
+int sceneAddNode(SceneDescription& scene, int parent, const Vector3D& translation, const Matrix3D& rotation,
+                 const Vector3D& scale)
+{
+    scene.nodeParent.push_back(parent);
+    scene.nodeTranslation.push_back(translation);
+    scene.nodeRotation.push_back(rotation);
+    scene.nodeScale.push_back(scale);
+    return int(scene.nodeParent.size()) - 1;
+}
+
+void sceneAddEntity(SceneParser& parser, int node, int mesh, const Vector4D& color, int texture)
+{
+    parser.scene.entityNode.push_back(node);
+    parser.scene.entityMesh.push_back(mesh);
+    parser.scene.entityColor.push_back(color);
+    parser.scene.entityBounds.push_back(parser.meshBounds[mesh]);
+    parser.scene.entityTexture.push_back(texture);
+}
+
+/* root node plus one node and entity per part */
+int sceneInstantiate(SceneParser& parser, const ScenePrefab& prefab, int parent, const Vector3D& translation,
+                     const Matrix3D& rotation, const Vector3D& scale)
+{
+    SceneDescription& scene = parser.scene;
+    int root = sceneAddNode(scene, parent, translation, rotation, scale);
+    for(uint32_t i = prefab.firstPart; i < prefab.firstPart + prefab.partCount; i++)
+    {
+        const ScenePart& part = scene.parts[i];
+        int node = sceneAddNode(scene, root, part.translation, part.rotation, part.scale);
+        sceneAddEntity(parser, node, part.mesh, part.color, part.texture);
+    }
+    if(scene.controlledNode < 0)
+        scene.controlledNode = root;
+    return root;
+}
+
+/* optional transform keys of node, instance and part statements, returns false for an unknown key */
+bool sceneReadTransform(SceneParser& parser, std::istringstream& stream, const std::string& key, Vector3D& translation,
+                        Matrix3D& rotation, Vector3D& scale)
+{
+    if(key == "translate")
+        translation = sceneReadVector3(parser, stream, key);
+    else if(key == "rotate")
+        rotation = sceneReadRotation(parser, stream, key);
+    else if(key == "scale")
+        scale = sceneReadVector3(parser, stream, key);
+    else
+        return false;
+    return true;
+}
+
+void sceneParseLine(SceneParser& parser, std::istringstream& stream, const std::string& keyword, bool& inPrefab)
+{
+    SceneDescription& scene = parser.scene;
+    std::string key;
+    if(keyword == "end")
+    {
+        if(!inPrefab)
+            sceneSyntaxError(parser, "'end' without 'prefab'");
+        inPrefab = false;
+    }
+    else if(keyword == "part")
+    {
+        if(!inPrefab)
+            sceneSyntaxError(parser, "'part' outside of a prefab");
+        std::string mesh;
+        stream >> mesh;
+        ScenePart part;
+        part.mesh = sceneFindMesh(parser, mesh);
+        while(stream >> key)
+        {
+            std::string value;
+            if(key == "color")
+                part.color = sceneReadVector4(parser, stream, key);
+            else if(key == "texture" && stream >> value)
+                part.texture = sceneFindTexture(parser, value);
+            else if(!sceneReadTransform(parser, stream, key, part.translation, part.rotation, part.scale))
+                sceneSyntaxError(parser, "Unknown key '" + key + "' of part");
+        }
+        scene.parts.push_back(part);
+        scene.prefabs.back().partCount++;
+    }
+    else if(inPrefab)
+    {
+        sceneSyntaxError(parser, "Missing 'end' of prefab " + std::string(scene.prefabs.back().name));
+    }
+    else if(keyword == "camera")
+    {
+        while(stream >> key)
+        {
+            if(key == "position")
+                scene.camera.position = sceneReadVector3(parser, stream, key);
+            else if(key == "lookat")
+                scene.camera.lookAt = sceneReadVector3(parser, stream, key);
+            else if(key == "fov")
+                sceneReadFloats(parser, stream, &scene.camera.fov, 1, key);
+            else if(key == "near")
+                sceneReadFloats(parser, stream, &scene.camera.nearPlane, 1, key);
+            else if(key == "far")
+                sceneReadFloats(parser, stream, &scene.camera.farPlane, 1, key);
+            else
+                sceneSyntaxError(parser, "Unknown key '" + key + "' of camera");
+        }
+    }
+    else if(keyword == "water")
+    {
+        while(stream >> key)
+        {
+            if(key == "color")
+                scene.water.color = sceneReadVector4(parser, stream, key);
+            else if(key == "grid" && stream >> scene.water.gridResolution && scene.water.gridResolution >= 0)
+                continue;
+            else
+                sceneSyntaxError(parser, "Unknown or invalid key '" + key + "' of water");
+        }
+    }
+    else if(keyword == "mesh")
+    {
+        std::string name;
+        Bounds bounds;
+        if(!(stream >> name) || !sceneMeshBounds(name, bounds))
+            sceneSyntaxError(parser, "Unknown built-in mesh '" + name + "'");
+        if(std::find(scene.meshes.begin(), scene.meshes.end(), name) == scene.meshes.end())
+        {
+            scene.meshes.push_back(name);
+            parser.meshBounds.push_back(bounds);
+        }
+    }
+    else if(keyword == "texture")
+    {
+        std::string name, file;
+        if(!(stream >> name >> file) || file.size() >= 256 || parser.textures.count(name) > 0)
+            sceneSyntaxError(parser, "Invalid or duplicate texture '" + name + "'");
+        parser.textures[name] = int(scene.textures.size());
+        scene.textures.push_back(file);
+    }
+    else if(keyword == "prefab")
+    {
+        std::string name;
+        if(!(stream >> name) || name.size() >= sizeof(ScenePrefab::name) || scenePrefabFind(scene, name) >= 0)
+            sceneSyntaxError(parser, "Invalid or duplicate prefab name '" + name + "'");
+        ScenePrefab prefab;
+        std::memcpy(prefab.name, name.c_str(), name.size());
+        prefab.firstPart = uint32_t(scene.parts.size());
+        scene.prefabs.push_back(prefab);
+        inPrefab = true;
+    }
+    else if(keyword == "node" || keyword == "instance")
+    {
+        std::string name;
+        int prefab = -1;
+        if(keyword == "node")
+        {
+            stream >> name;
+        }
+        else
+        {
+            std::string prefabName;
+            stream >> prefabName;
+            prefab = scenePrefabFind(scene, prefabName);
+            if(prefab < 0)
+                sceneSyntaxError(parser, "Unknown prefab '" + prefabName + "'");
+        }
+
+        int parent = -1;
+        Vector3D translation, scale(1.0f, 1.0f, 1.0f);
+        Matrix3D rotation = Matrix3D::identity();
+        while(stream >> key)
+        {
+            std::string value;
+            if(key == "parent" && stream >> value)
+                parent = sceneFindNode(parser, value);
+            else if(key == "name" && prefab >= 0 && stream >> value)
+                name = value;
+            else if(!sceneReadTransform(parser, stream, key, translation, rotation, scale))
+                sceneSyntaxError(parser, "Unknown key '" + key + "' of " + keyword);
+        }
+
+        int node = prefab >= 0 ? sceneInstantiate(parser, scene.prefabs[prefab], parent, translation, rotation, scale)
+                               : sceneAddNode(scene, parent, translation, rotation, scale);
+        if(!name.empty())
+        {
+            if(parser.nodes.count(name) > 0)
+                sceneSyntaxError(parser, "Duplicate node name '" + name + "'");
+            parser.nodes[name] = node;
+        }
+    }
+    else if(keyword == "entity")
+    {
+        std::string node, mesh;
+        stream >> node >> mesh;
+        int nodeIndex = sceneFindNode(parser, node);
+        int meshIndex = sceneFindMesh(parser, mesh);
+        Vector4D color(1.0f, 1.0f, 1.0f, 1.0f);
+        int texture = -1;
+        while(stream >> key)
+        {
+            std::string value;
+            if(key == "color")
+                color = sceneReadVector4(parser, stream, key);
+            else if(key == "texture" && stream >> value)
+                texture = sceneFindTexture(parser, value);
+            else
+                sceneSyntaxError(parser, "Unknown key '" + key + "' of entity");
+        }
+        sceneAddEntity(parser, nodeIndex, meshIndex, color, texture);
+    }
+    else if(keyword == "grid")
+    {
+        std::string prefabName;
+        stream >> prefabName;
+        int prefab = scenePrefabFind(scene, prefabName);
+        if(prefab < 0)
+            sceneSyntaxError(parser, "Unknown prefab '" + prefabName + "'");
+
+        int count = 1;
+        float spacing = 12.0f;
+        int parent = -1;
+        while(stream >> key)
+        {
+            std::string value;
+            if(key == "count" && stream >> count && count >= 0)
+                continue;
+            else if(key == "spacing")
+                sceneReadFloats(parser, stream, &spacing, 1, key);
+            else if(key == "parent" && stream >> value)
+                parent = sceneFindNode(parser, value);
+            else
+                sceneSyntaxError(parser, "Unknown or invalid key '" + key + "' of grid");
+        }
+        if(parser.gridCount > 0)
+            count = parser.gridCount;
+
+        /* odd number of rows so one instance is in the center, instances are created nearest to the center first */
+        int side = int(std::ceil(std::sqrt(float(count))));
+        side += 1 - side % 2;
+        std::vector<Vector3D> positions;
+        for(int z = 0; z < side; z++)
+        {
+            for(int x = 0; x < side; x++)
+                positions.push_back({(x - side / 2) * spacing, 0.0f, (z - side / 2) * spacing});
+        }
+        std::stable_sort(positions.begin(), positions.end(), [](const Vector3D& a, const Vector3D& b) {
+            return a.x * a.x + a.z * a.z < b.x * b.x + b.z * b.z;
+        });
+
+        const ScenePrefab& instance = scene.prefabs[prefab];
+        size_t nodes = scene.nodeParent.size() + size_t(count) * (instance.partCount + 1);
+        scene.nodeParent.reserve(nodes);
+        scene.nodeTranslation.reserve(nodes);
+        scene.nodeRotation.reserve(nodes);
+        scene.nodeScale.reserve(nodes);
+        for(int i = 0; i < count; i++)
+            sceneInstantiate(parser, instance, parent, positions[i], Matrix3D::identity(), {1.0f, 1.0f, 1.0f});
+    }
+    else
+    {
+        sceneSyntaxError(parser, "Unknown statement '" + keyword + "'");
+    }
+}
+}
+
+SceneDescription sceneParseText(const std::string& filepath, int gridCount)
+{
+    std::ifstream file(filepath);
+    if(!file)
+        detail::sceneFail("Couldn't open scene " + filepath);
+
+    detail::SceneParser parser;
+    parser.filepath = filepath;
+    parser.gridCount = gridCount;
+    bool inPrefab = false;
+    std::string line;
+    while(std::getline(file, line))
+    {
+        parser.line++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream stream(line);
+        std::string keyword;
+        if(stream >> keyword)
+            detail::sceneParseLine(parser, stream, keyword, inPrefab);
+    }
+    if(inPrefab)
+        detail::sceneSyntaxError(parser, "Missing 'end' of prefab " + std::string(parser.scene.prefabs.back().name));
+    return parser.scene;
+}
+
+SceneDescription sceneLoad(const std::string& filepath, int gridCount)
+{
+    auto start = std::chrono::steady_clock::now();
+    detail::SceneFileView view;
+    if(!detail::sceneOpenView(filepath, view))
+        detail::sceneFail("Couldn't open scene " + filepath);
+
+    bool binary = view.size >= sizeof(detail::SceneFileHeader)
+                  && std::memcmp(view.data, detail::kSceneMagic, sizeof(detail::kSceneMagic)) == 0;
+    SceneDescription scene;
+    try
+    {
+        if(binary)
+        {
+            if(gridCount > 0)
+                std::cerr << "[Scene] " << filepath << " is compiled, the boat count can't be changed" << std::endl;
+            scene = detail::sceneLoadBinary(view, filepath);
+        }
+        else
+        {
+            detail::sceneCloseView(view);
+            scene = sceneParseText(filepath, gridCount);
+        }
+    }
+    catch(...)
+    {
+        detail::sceneCloseView(view);
+        throw;
+    }
+    detail::sceneCloseView(view);
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "[Scene] Loaded " << filepath << " (" << (binary ? "binary" : "text") << ") in " << ms << " ms: "
+              << scene.nodeParent.size() << " nodes, " << scene.entityNode.size() << " entities" << std::endl;
+    return scene;
+}
+
+bool sceneWriteBinary(const SceneDescription& scene, const std::string& filepath)
+{
+    detail::SceneFileHeader header = {};
+    std::memcpy(header.magic, detail::kSceneMagic, sizeof(header.magic));
+    header.version = detail::kSceneVersion;
+    header.byteOrder = detail::kSceneByteOrder;
+    header.camera = scene.camera;
+    header.water = scene.water;
+    header.controlledNode = scene.controlledNode;
+    header.meshCount = uint32_t(scene.meshes.size());
+    header.textureCount = uint32_t(scene.textures.size());
+    header.prefabCount = uint32_t(scene.prefabs.size());
+    header.partCount = uint32_t(scene.parts.size());
+    header.nodeCount = uint32_t(scene.nodeParent.size());
+    header.entityCount = uint32_t(scene.entityNode.size());
+
+    std::vector<detail::SceneMeshName> names(scene.meshes.size());
+    for(size_t i = 0; i < scene.meshes.size(); i++)
+    {
+        std::memset(names[i].name, 0, sizeof(names[i].name));
+        std::strncpy(names[i].name, scene.meshes[i].c_str(), sizeof(names[i].name) - 1);
+    }
+    std::vector<detail::SceneTexturePath> paths(scene.textures.size());
+    for(size_t i = 0; i < scene.textures.size(); i++)
+    {
+        std::memset(paths[i].path, 0, sizeof(paths[i].path));
+        std::strncpy(paths[i].path, scene.textures[i].c_str(), sizeof(paths[i].path) - 1);
+    }
+
+    struct Section { const void* data; size_t bytes; };
+    const Section sections[detail::SectionCount] = {
+        {names.data(), names.size() * sizeof(detail::SceneMeshName)},
+        {paths.data(), paths.size() * sizeof(detail::SceneTexturePath)},
+        {scene.prefabs.data(), scene.prefabs.size() * sizeof(ScenePrefab)},
+        {scene.parts.data(), scene.parts.size() * sizeof(ScenePart)},
+        {scene.nodeParent.data(), scene.nodeParent.size() * sizeof(int32_t)},
+        {scene.nodeTranslation.data(), scene.nodeTranslation.size() * sizeof(Vector3D)},
+        {scene.nodeRotation.data(), scene.nodeRotation.size() * sizeof(Matrix3D)},
+        {scene.nodeScale.data(), scene.nodeScale.size() * sizeof(Vector3D)},
+        {scene.entityNode.data(), scene.entityNode.size() * sizeof(int32_t)},
+        {scene.entityMesh.data(), scene.entityMesh.size() * sizeof(int32_t)},
+        {scene.entityColor.data(), scene.entityColor.size() * sizeof(Vector4D)},
+        {scene.entityBounds.data(), scene.entityBounds.size() * sizeof(Bounds)},
+        {scene.entityTexture.data(), scene.entityTexture.size() * sizeof(int32_t)},
+    };
+    uint64_t offset = (sizeof(header) + 15) / 16 * 16;
+    for(int i = 0; i < detail::SectionCount; i++)
+    {
+        header.offset[i] = offset;
+        offset = (offset + sections[i].bytes + 15) / 16 * 16;
+    }
+
+    std::ofstream file(filepath, std::ios::binary);
+    if(!file)
+    {
+        std::cerr << "[Scene] Couldn't write " << filepath << std::endl;
+        return false;
+    }
+    const char padding[16] = {};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(padding, std::streamsize(header.offset[0] - sizeof(header)));
+    for(int i = 0; i < detail::SectionCount; i++)
+    {
+        file.write(static_cast<const char*>(sections[i].data), std::streamsize(sections[i].bytes));
+        uint64_t end = i + 1 < detail::SectionCount ? header.offset[i + 1] : offset;
+        file.write(padding, std::streamsize(end - header.offset[i] - sections[i].bytes));
+    }
+    if(!file)
+    {
+        std::cerr << "[Scene] Couldn't write " << filepath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int scenePrefabFind(const SceneDescription& scene, const std::string& name)
+{
+    for(size_t i = 0; i < scene.prefabs.size(); i++)
+    {
+        if(name == scene.prefabs[i].name)
+            return int(i);
+    }
+    return -1;
+}
+
+bool sceneMeshBounds(const std::string& name, Bounds& bounds)
+{
+    if(name != "cube")
+        return false;
+
+    bounds = {cube::vertexPos[0], cube::vertexPos[0]};
+    for(const Vector3D& p : cube::vertexPos)
+    {
+        bounds.min = {std::min(bounds.min.x, p.x), std::min(bounds.min.y, p.y), std::min(bounds.min.z, p.z)};
+        bounds.max = {std::max(bounds.max.x, p.x), std::max(bounds.max.y, p.y), std::max(bounds.max.z, p.z)};
+    }
+    return true;
+}
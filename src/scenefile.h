@@ -0,0 +1,131 @@
+#pragma once
+
+#include "core/entities.h"
+#include "math/matrix3d.h"
+#include "math/vector4d.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct SceneCamera
+{
+    Vector3D position = {10.0f, 14.0f, 10.0f};
+    Vector3D lookAt = {0.0f, 4.0f, 0.0f};
+    float fov = 45.0f;              // vertical field of view in degrees
+    float nearPlane = 0.01f;
+    float farPlane = 500.0f;
+};
+
+struct SceneWater
+{
+    Vector4D color = {0.0f, 0.0f, 0.35f, 1.0f};
+    int32_t gridResolution = 0;     // cells per side, 0 uses the predefined grid
+};
+
+/* one mesh of a prefab, relative to the root node of an instance */
+struct ScenePart
+{
+    int32_t mesh = 0;
+    Vector3D translation;
+    Matrix3D rotation = Matrix3D::identity();
+    Vector3D scale = {1.0f, 1.0f, 1.0f};
+    Vector4D color = {1.0f, 1.0f, 1.0f, 1.0f};
+    int32_t texture = -1;
+};
+
+/* group of parts instantiated as a root node with one child node and entity per part */
+struct ScenePrefab
+{
+    char name[32] = {};
+    uint32_t firstPart = 0;
+    uint32_t partCount = 0;
+};
+
+/**
+ * Everything that describes a scene: camera, water, the mesh table (built-in geometry by name), the texture table
+ * (image files relative to the scene file), prefabs and the flattened hierarchy, i.e. transform nodes in creation
+ * order (parents before children) and entities referring to them. All arrays are plain data, which is what the
+ * binary form stores as is.
+ *
+ * The text form is line based, # starts a comment, numbers are separated by spaces:
+ *
+ *   camera position 10 14 10 lookat 0 4 0 fov 45 near 0.01 far 500
+ *   water color 0 0 0.35 1 grid 0
+ *   mesh cube                                         # built-in geometry: cube
+ *   texture planks textures/planks.png                # relative to the scene file
+ *   prefab boat                                       # parts until "end"
+ *     part cube translate 0 0 0 scale 3.5 0.9 1.25 color 0.5 0.102 0 1 texture planks
+ *   end
+ *   node pier translate 20 0 0 rotate 0 45 0          # plain node, rotate is in degrees about x, y, z
+ *   entity pier cube color 0.4 0.4 0.4 1 texture planks   # mesh on a node
+ *   instance boat name flagship parent pier translate 0 0 5
+ *   grid boat count 100 spacing 12                    # square grid around the origin, nearest first
+ *
+ * The first instance (or the center of the first grid) is the boat controlled by the keys.
+ */
+struct SceneDescription
+{
+    SceneCamera camera;
+    SceneWater water;
+
+    std::vector<std::string> meshes;
+    std::vector<std::string> textures;      // files as written in the scene
+    std::vector<ScenePrefab> prefabs;
+    std::vector<ScenePart> parts;
+
+    /* transform nodes */
+    std::vector<int32_t> nodeParent;
+    std::vector<Vector3D> nodeTranslation;
+    std::vector<Matrix3D> nodeRotation;
+    std::vector<Vector3D> nodeScale;
+
+    /* entities */
+    std::vector<int32_t> entityNode;
+    std::vector<int32_t> entityMesh;
+    std::vector<Vector4D> entityColor;
+    std::vector<Bounds> entityBounds;
+    std::vector<int32_t> entityTexture;     // -1 for none
+
+    int32_t controlledNode = -1;
+};
+
+/**
+ * @brief Loads a scene in text or binary form, the form is detected by the header of the file. Binary scenes are
+ * memory mapped and their arrays copied as a whole. Errors are fatal.
+ *
+ * @param filepath Scene file.
+ * @param gridCount Replaces the count of all grid statements if > 0 (text form only).
+ *
+ * @return Scene description.
+ *
+ * usage:
+ *
+ *   SceneDescription scene = sceneLoad("scenes/default.scene");
+ *   int firstNode = transformAppend(graph, scene.nodeParent.size(), scene.nodeParent.data(), ...);
+ *   sceneWriteBinary(scene, "default.sceneb");     // compiled form of the same scene
+ *
+ */
+SceneDescription sceneLoad(const std::string& filepath, int gridCount = 0);
+
+/**
+ * @brief Parses the text form.
+ */
+SceneDescription sceneParseText(const std::string& filepath, int gridCount = 0);
+
+/**
+ * @brief Writes the binary form.
+ *
+ * @return False if the file couldn't be written.
+ */
+bool sceneWriteBinary(const SceneDescription& scene, const std::string& filepath);
+
+/**
+ * @brief Index of a prefab by name, -1 if there is none.
+ */
+int scenePrefabFind(const SceneDescription& scene, const std::string& name);
+
+/**
+ * @brief Bounds of a built-in mesh, false if the name is unknown.
+ */
+bool sceneMeshBounds(const std::string& name, Bounds& bounds);
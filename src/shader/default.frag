@@ -2,9 +2,21 @@
 
 in vec4 tColor;
 in vec3 tFragPos;
+#ifdef TEXTURED
+in vec3 tLocalPos;
+flat in float tLayer;
+uniform sampler2DArray uTextures;   // layer 0 is white
+#endif
 out vec4 FragColor;
 
 void main(void)
 {
+#ifdef TEXTURED
+    /* box mapping: the face normal in mesh space picks the plane to project on, the meshes span [-1, 1] */
+    vec3 normal = abs(cross(dFdx(tLocalPos), dFdy(tLocalPos)));
+    vec2 uv = normal.x > normal.y && normal.x > normal.z ? tLocalPos.zy : normal.y > normal.z ? tLocalPos.xz : tLocalPos.xy;
+    FragColor = tColor * texture(uTextures, vec3(uv * 0.5 + 0.5, tLayer));
+#else
     FragColor = tColor;
+#endif
 }
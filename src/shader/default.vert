@@ -2,17 +2,44 @@
 
 layout(location = 0) in vec3 aPosition;
 layout(location = 1) in vec4 aColor;
+#ifdef INSTANCED
+layout(location = 2) in mat4 aInstance;
+#ifdef TEXTURED
+layout(location = 6) in float aLayer;
+#endif
+#endif
+
+#include "frame.glsl"
 
 uniform mat4 uModel;
-uniform mat4 uView;
-uniform mat4 uProj;
+uniform vec4 uColor;
 
 out vec4 tColor;
 out vec3 tFragPos;
+#ifdef TEXTURED
+out vec3 tLocalPos;
+flat out float tLayer;
+#ifndef INSTANCED
+uniform float uLayer;
+#endif
+#endif
 
 void main(void)
 {
-    gl_Position = uProj * uView * uModel * vec4(aPosition, 1.0);
-    tColor = aColor;
-    tFragPos = vec3(uModel * vec4(aPosition, 1.0));
+#ifdef INSTANCED
+    vec4 worldPos = aInstance * uModel * vec4(aPosition, 1.0);
+#else
+    vec4 worldPos = uModel * vec4(aPosition, 1.0);
+#endif
+    gl_Position = uViewProj * worldPos;
+    tColor = aColor * uColor;
+    tFragPos = vec3(worldPos);
+#ifdef TEXTURED
+    tLocalPos = aPosition;
+#ifdef INSTANCED
+    tLayer = aLayer;
+#else
+    tLayer = uLayer;
+#endif
+#endif
 }
@@ -0,0 +1,9 @@
+/* per-frame constants shared by all programs (see FrameUniforms in mygl/uniformbuffer.h) */
+layout(std140) uniform FrameData
+{
+    mat4 uView;
+    mat4 uProj;
+    mat4 uViewProj;
+    vec4 uCameraPos;
+    vec4 uTime;
+};
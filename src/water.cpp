@@ -1,21 +1,75 @@
 #include "water.h"
 #include "mygl/geometry.h"
+#include "core/jobs.h"
 
-Water waterCreate(const Vector4D& color)
+#include <cmath>
+
+namespace detail
+{
+/* regular grid with the extent of the predefined one (-20..20 in x and z), two triangles per cell */
+void regularGrid(unsigned int resolution, std::vector<Vector3D>& positions, std::vector<unsigned int>& indices)
+{
+    const float extent = 20.0f;
+    const unsigned int side = resolution + 1;
+
+    positions.resize(side * side);
+    for (unsigned z = 0; z < side; z++) {
+        for (unsigned x = 0; x < side; x++) {
+            positions[z * side + x] = { -extent + 2.0f * extent * x / resolution, 0.0f, extent - 2.0f * extent * z / resolution };
+        }
+    }
+
+    indices.resize(6 * resolution * resolution);
+    unsigned int* index = indices.data();
+    for (unsigned z = 0; z < resolution; z++) {
+        for (unsigned x = 0; x < resolution; x++) {
+            unsigned int v = z * side + x;
+            *index++ = v; *index++ = v + 1; *index++ = v + side + 1;
+            *index++ = v; *index++ = v + side + 1; *index++ = v + side;
+        }
+    }
+}
+}
+
+Water waterCreate(const Vector4D& color, unsigned int resolution)
 {
     Water water;
 
-    water.vertices.resize(grid::vertexPos.size());
+    std::vector<Vector3D> positions;
+    std::vector<unsigned int> indices;
+    if (resolution > 0) {
+        detail::regularGrid(resolution, positions, indices);
+    }
+    const std::vector<Vector3D>& vertexPos = resolution > 0 ? positions : grid::vertexPos;
+
+    water.vertices.resize(vertexPos.size());
     Vector4D colorAdjust(0.0, 0.0, 0.0, 0.0);
     for (unsigned i = 0; i < water.vertices.size(); i++) {
-        water.vertices[i] = { grid::vertexPos[i], color + colorAdjust };
+        water.vertices[i] = { vertexPos[i], color + colorAdjust };
         colorAdjust += Vector4D(0.01, 0.01, 0.05, 0.0);
         if (i % 6 == 0) {
             colorAdjust = { 0.0, 0.0, 0.0, 0.0 };
         }
     }
-    water.mesh = meshCreate(water.vertices, grid::indices, GL_DYNAMIC_DRAW, GL_STATIC_DRAW);
+    water.mesh = meshCreate(water.vertices, resolution > 0 ? indices : grid::indices, GL_DYNAMIC_DRAW, GL_STATIC_DRAW);
     return water;
 }
 
+void waterSimulate(Water& water, WaterSim& sim, float dt)
+{
+    sim.accumTime += dt;
+    const float time = sim.accumTime;
+    parallelFor(0, water.vertices.size(), 2048, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            Vertex& vertex = water.vertices[i];
+            float height = 0.0f;
+            for (const WaveParams& wave : sim.parameter) {
+                float d = wave.direction.x * vertex.pos.x + wave.direction.y * vertex.pos.z;
+                height += wave.amplitude * std::sin(wave.omega * d + wave.phi * time);
+            }
+            vertex.pos.y = height;
+        }
+    });
+}
+
 void waterDelete(Water& water) { meshDelete(water.mesh); }
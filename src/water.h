@@ -37,6 +37,8 @@ struct Water
  * a mesh (see function meshCreate(...)) is setup with these vertices.
  *
  * @param color Base color of water surface.
+ * @param resolution Number of grid cells along each side of a regular grid over the same area, 0 uses the predefined
+ * grid from geometry.h.
  *
  * @return Object containing the vector of vertices and an initialized mesh structure that can be drawn with OpenGL.
  *
@@ -47,7 +49,17 @@ struct Water
  *   glDrawElements(GL_TRIANGLES, myWater.size_ibo, GL_UNSIGNED_INT, nullptr);
  *
  */
-Water waterCreate(const Vector4D &color);
+Water waterCreate(const Vector4D &color, unsigned int resolution = 0);
+
+/**
+ * @brief Advance the wave simulation and update the heights of the water vertices (CPU only, upload them with
+ * meshUpdateVertices). The height is the sum of the waves A * sin(omega * dot(direction, (x, z)) + phi * t).
+ *
+ * @param water Water whose vertices are updated.
+ * @param sim Wave parameters and accumulated time.
+ * @param dt Time step in seconds.
+ */
+void waterSimulate(Water& water, WaterSim& sim, float dt);
 
 /**
  * @brief Cleanup and delete all OpenGL buffers of the water mesh. Has to be called for each water after it is not used anymore.